@@ -0,0 +1,87 @@
+#ifndef APP_ISR_H_
+#define APP_ISR_H_
+
+#include "sched.h"
+#include <stdint.h>
+
+/*
+ * Interrupt-only build (compile with -DPDT_ISR_ONLY, bare metal).
+ *
+ * After boot, thread mode never runs again: APP_ISR_Start sets
+ * SLEEPONEXIT and the core sleeps whenever the last active handler
+ * returns, without unstacking into an idle loop first. All work runs in
+ * handlers:
+ *
+ *   EXTI/I2C  top halves, unchanged
+ *   PendSV    deferred bottom halves, then the cooperative scheduler
+ *             until nothing is ready, supervisor and clock governor
+ *   SysTick   HAL tick; pends PendSV once the next scheduler deadline
+ *             is reached. Raised to PRIO_TICK_ISR so the tick keeps
+ *             counting while a task runs in PendSV.
+ *
+ * Work must reach the scheduler through DEFER_Post (which pends PendSV)
+ * or a timer; a bare SCHED_PostEvent from an ISR waits for the next
+ * deadline.
+ *
+ * Each wake is accounted from the first instrumented handler entry to
+ * the exit that returns to sleep (see ISRSTAT_Enter/Exit). Handlers
+ * without ISRSTAT calls are not seen.
+ */
+
+#ifdef PDT_ISR_ONLY
+
+#ifdef PDT_RTOS
+#error "PDT_ISR_ONLY and PDT_RTOS are exclusive"
+#endif
+
+#include "main.h"
+
+#define APP_ISR_OFF     0   // not started, nothing is accounted
+#define APP_ISR_ASLEEP  1
+#define APP_ISR_AWAKE   2
+
+typedef struct {
+    uint32_t wakes;
+    uint32_t active_max_ns;     // longest single wake
+    uint64_t active_ns;
+    uint32_t ns_q16;            // ns per core cycle (Q16) at the current clock
+    uint32_t start;             // cycle stamp of the current wake
+    uint32_t since_ms;
+    volatile uint8_t phase;
+} app_isr_wake_t;
+
+extern app_isr_wake_t app_isr_wake;
+
+/*Open a wake if the core was asleep*/
+static inline void APP_ISR_WakeEnter(uint32_t now) {
+    if (app_isr_wake.phase == APP_ISR_ASLEEP) {
+        app_isr_wake.phase = APP_ISR_AWAKE;
+        app_isr_wake.start = now;
+        app_isr_wake.wakes++;
+    }
+}
+
+/*Close the wake if this handler returns to sleep, not to another handler*/
+static inline void APP_ISR_WakeExit(uint32_t now) {
+    uint32_t icsr = SCB->ICSR;
+    if (app_isr_wake.phase != APP_ISR_AWAKE ||
+        !(icsr & SCB_ICSR_RETTOBASE_Msk) || (icsr & SCB_ICSR_VECTPENDING_Msk)) {
+        return;     // nested, or tail-chaining into another handler
+    }
+    uint32_t ns = (uint32_t)(((uint64_t)(now - app_isr_wake.start) * app_isr_wake.ns_q16) >> 16);
+    app_isr_wake.active_ns += ns;
+    if (ns > app_isr_wake.active_max_ns) {
+        app_isr_wake.active_max_ns = ns;
+    }
+    app_isr_wake.phase = APP_ISR_ASLEEP;
+}
+
+/*Exported functions*/
+void APP_ISR_Start(void);
+void APP_ISR_Run(void);
+void APP_ISR_Tick(void);
+void APP_ISR_Dump(sched_print_t print);
+
+#endif
+
+#endif
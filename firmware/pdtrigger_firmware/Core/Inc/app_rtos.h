@@ -0,0 +1,39 @@
+#ifndef APP_RTOS_H_
+#define APP_RTOS_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Preemptive build (compile with -DPDT_RTOS and the FreeRTOS kernel).
+ *
+ * driver    - highest priority; runs the cooperative scheduler (PD INTR,
+ *             button, PDO sequence, status) and sleeps until its next
+ *             deadline or an ISR event.
+ * telemetry - periodic jobs (subscribed topics, reports). A job may
+ *             retime itself with APP_RTOS_SetPeriod while it runs.
+ * ui        - drains the log queue into the USART2 TX ring, lowest
+ *             priority, so a slow UART dump can never delay a PD event.
+ *             Lines longer than a queue item are split over several; a
+ *             full queue makes the telemetry task wait for the UART, and
+ *             the driver task for a few ms at most.
+ */
+
+typedef struct {
+    sched_fn_t fn;
+    uint32_t period_ms;
+} app_rtos_job_t;
+
+typedef void (*app_rtos_print_t)(const char *fmt, ...);
+
+#ifdef PDT_RTOS
+void APP_RTOS_Start(const app_rtos_job_t *jobs, uint8_t n_jobs);
+bool APP_RTOS_Log(const char *buf, uint16_t len);
+void APP_RTOS_SetPeriod(sched_fn_t fn, uint32_t period_ms);
+void APP_RTOS_WakeFromISR(void);
+void APP_RTOS_Wake(void);
+void APP_RTOS_Dump(app_rtos_print_t print);
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef BLOG_H_
+#define BLOG_H_
+
+#include <stdint.h>
+
+/*
+ * Binary logging: the device sends a format ID and the raw arguments,
+ * the host formats (firmware/tools/blogdec.cpp).
+ *
+ * Each BLOG() site places its format string in .blog_fmt, which the
+ * linker script keeps in the ELF but never loads (INFO, address 0). The
+ * string's offset in that section, plus one, is its ID. A record is
+ *
+ *     varint id, then one varint per argument
+ *
+ * where arguments are taken as uint32_t; the decoder re-signs them from
+ * the conversion. Only integer conversions are allowed (d i u x X o c V,
+ * with flags, width and h/l modifiers). ID 0 carries plain text from
+ * BLOG_Text (varint length, bytes) for output that has no fixed format,
+ * such as the periodic report.
+ *
+ * Records are at most BLOG_RECORD_MAX bytes and go out whole or not at
+ * all, so the stream stays decodable when the TX ring drops.
+ */
+
+#define BLOG_MAX_ARGS       8
+#define BLOG_TEXT_CHUNK     56      // longer text is split across records
+#define BLOG_RECORD_MAX     (5 * (1 + BLOG_MAX_ARGS))
+
+#define BLOG(fmt, ...)                                                  \
+    do {                                                                \
+        static const char blog_fmt_[]                                   \
+            __attribute__((section(".blog_fmt"), used)) = fmt;          \
+        const uint32_t blog_args_[] = { 0, ##__VA_ARGS__ };             \
+        _Static_assert(sizeof(blog_args_) / sizeof(uint32_t) - 1        \
+                       <= BLOG_MAX_ARGS, "too many BLOG arguments");    \
+        BLOG_Emit(blog_fmt_, blog_args_ + 1,                            \
+                  sizeof(blog_args_) / sizeof(uint32_t) - 1);           \
+    } while (0)
+
+/*Exported functions*/
+void BLOG_Emit(const char *fmt, const uint32_t *args, uint8_t n);
+void BLOG_Text(const char *buf, uint16_t len);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef CLOCKGOV_H_
+#define CLOCKGOV_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Clock governor: runs the core from HSE (16 MHz) while idle and switches
+ * to the 84 MHz PLL while a burst (negotiation, telemetry dump) is active.
+ *
+ * The decision logic is hardware-free. The actual clock tree switch is
+ * done by the injected apply callback, which must also re-derive every
+ * clock-dependent peripheral setting (I2C3 timing, USART2 BRR, timebase).
+ */
+
+typedef enum {
+    CLK_LOW,            // HSE 16 MHz, VOS scale 3, no PLL
+    CLK_HIGH,           // PLL 84 MHz, VOS scale 2
+    CLK_STATES
+} clk_state_t;
+
+typedef enum {
+    BURST_NEGOTIATION,
+    BURST_TELEMETRY,
+    BURST_REASONS
+} burst_reason_t;
+
+#define CLOCKGOV_MIN_HIGH_MS    50      // dwell time to avoid thrashing
+
+typedef bool (*clockgov_apply_t)(clk_state_t state);
+
+typedef struct {
+    uint32_t switches;
+    uint32_t failures;
+    uint32_t bursts[BURST_REASONS];
+    uint32_t time_ms[CLK_STATES];
+} clockgov_stats_t;
+
+/*Exported functions*/
+void CLOCKGOV_Init(clockgov_apply_t apply, sched_clock_t clock, clk_state_t initial);
+void CLOCKGOV_Request(burst_reason_t reason, uint32_t hold_ms);
+void CLOCKGOV_Update(void);
+clk_state_t CLOCKGOV_State(void);
+clk_state_t CLOCKGOV_Decide(clk_state_t state, uint32_t now, uint32_t burst_until,
+                            uint32_t entered_high);
+const clockgov_stats_t *CLOCKGOV_Stats(void);
+void CLOCKGOV_Dump(sched_print_t print);
+
+#endif
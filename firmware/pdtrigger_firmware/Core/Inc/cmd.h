@@ -0,0 +1,85 @@
+#ifndef CMD_H_
+#define CMD_H_
+
+#include "sched.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Line-based command interface on USART2 RX.
+ *
+ * Reception runs HAL_UARTEx_ReceiveToIdle_DMA on a circular buffer: the
+ * RX event fires on line idle (and at half/full buffer), so a command
+ * typed or sent in one burst costs one interrupt. The callback only
+ * copies the new bytes into a ring and defers EVT_CMD to the scheduler.
+ * CMD_Poll, from task context, assembles lines, splits them into words
+ * in place and dispatches through the table given to CMD_Init; nothing
+ * is allocated. A reply is whatever the handler prints followed by
+ * "ok" or "err <reason>".
+ *
+ * Lines end with CR or LF (either or both); empty lines are ignored and
+ * an over-long line is discarded whole. With -DPDT_HOST the UART side is
+ * left out and tests push bytes through CMD_Feed.
+ *
+ * Pipelining: a line may start with a tag, "#<id> pdo 2". Everything the
+ * request prints then comes back as "#<id> | <text>" and it ends with
+ * "#<id> ok" or "#<id> err <reason>", so a host can have several
+ * requests in flight and match replies however they interleave. A
+ * handler whose work finishes later (a PDO change) returns CMD_Defer and
+ * answers through CMD_Complete; the lines after it run meanwhile, so
+ * replies can come back out of order. Untagged lines work as before.
+ * The host side is firmware/tools/rpc.hpp.
+ */
+
+#define CMD_RX_DMA      64      // circular DMA buffer
+#define CMD_RING_SIZE   128     // must be a power of two
+#define CMD_LINE_MAX    48
+#define CMD_ARGS_MAX    4       // words after the command name
+
+// Returns NULL on success, else the reason for "err <reason>", or CMD_Defer()
+typedef const char *(*cmd_fn_t)(uint8_t argc, char *argv[]);
+
+// A request whose reply is still owed
+typedef struct {
+    uint32_t id;
+    bool tagged;
+    bool live;
+} cmd_token_t;
+
+typedef struct {
+    const char *name;
+    cmd_fn_t fn;
+    uint8_t min_args;
+    uint8_t max_args;
+    const char *help;       // argument synopsis and a few words
+} cmd_t;
+
+typedef struct {
+    uint32_t bytes;         // received
+    uint32_t lines;         // dispatched
+    uint32_t rejected;      // unknown, bad arguments, too long
+    uint32_t overflows;     // bytes lost to a full ring
+    uint32_t uart_errors;   // reception restarted after a UART error
+    uint32_t deferred;      // answered later through CMD_Complete
+} cmd_stats_t;
+
+/*Exported functions*/
+void CMD_Init(const cmd_t *table, uint8_t count, sched_print_t reply);
+uint16_t CMD_Feed(const uint8_t *buf, uint16_t len);    // ISR-safe, one producer
+void CMD_Poll(void);
+bool CMD_ParseU32(const char *s, uint32_t *out);
+void CMD_Printf(const char *fmt, ...);
+void CMD_Vprintf(const cmd_token_t *token, const char *fmt, va_list args);
+const char *CMD_Defer(cmd_token_t *token);
+void CMD_Complete(cmd_token_t *token, const char *err);
+const cmd_stats_t *CMD_Stats(void);
+void CMD_Dump(sched_print_t print);
+#ifndef PDT_HOST
+#include "main.h"
+void CMD_RxStart(void);
+void CMD_RxStop(void);
+void CMD_RxError(UART_HandleTypeDef *huart);
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef CORO_H_
+#define CORO_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Stackless coroutines (protothread style) for multi-step sequences.
+ *
+ * A coroutine is a function taking a coro_t* and returning a coro_status_t,
+ * resumed from a scheduler task. The resume point is stored as a line
+ * number, so each sequence costs 8 bytes of RAM. Locals do NOT survive a
+ * wait: keep them static or in a caller-owned context struct. Do not use
+ * switch statements across a wait inside the coroutine body.
+ *
+ *     static coro_status_t seq(coro_t *co) {
+ *         CORO_BEGIN(co);
+ *         start_something();
+ *         CORO_AWAIT_EVENT_TIMEOUT(co, EVT_PD_INTR, 500);
+ *         if (CORO_TIMED_OUT(co)) CORO_EXIT(co);
+ *         CORO_SLEEP(co, 50);
+ *         CORO_END(co);
+ *     }
+ */
+
+typedef enum {
+    CORO_RUNNING,       // waiting, resume later
+    CORO_DONE,          // ran to the end (or CORO_EXIT)
+    CORO_CANCELLED      // stopped by CORO_Cancel
+} coro_status_t;
+
+typedef struct {
+    uint16_t line;      // resume point, 0 = not started
+    uint8_t flags;
+    uint32_t deadline;  // scheduler ticks, for timeouts and sleeps
+} coro_t;
+
+#define CORO_F_CANCEL   0x01
+#define CORO_F_TIMEOUT  0x02
+#define CORO_F_DONE     0x04
+
+#define CORO_LINE_DONE  0xFFFF
+
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#define CORO_FALLTHROUGH __attribute__((fallthrough))
+#else
+#define CORO_FALLTHROUGH ((void)0)
+#endif
+
+/*Restart a coroutine from the top*/
+static inline void CORO_Reset(coro_t *co) {
+    co->line = 0;
+    co->flags = 0;
+}
+
+/*Request cancellation; takes effect on the next resume*/
+static inline void CORO_Cancel(coro_t *co) {
+    co->flags |= CORO_F_CANCEL;
+}
+
+static inline bool CORO_IsDone(const coro_t *co) {
+    return co->line == CORO_LINE_DONE;
+}
+
+static inline bool coro_expired(const coro_t *co) {
+    return (int32_t)(SCHED_Now() - co->deadline) >= 0;
+}
+
+/*Ticks until the current wait's deadline, 0 if already due*/
+static inline uint32_t CORO_Remaining(const coro_t *co) {
+    int32_t left = (int32_t)(co->deadline - SCHED_Now());
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+#define CORO_BEGIN(co)                                                  \
+    if ((co)->flags & CORO_F_CANCEL) {                                  \
+        (co)->line = CORO_LINE_DONE;                                    \
+        (co)->flags = CORO_F_DONE;                                      \
+        return CORO_CANCELLED;                                          \
+    }                                                                   \
+    switch ((co)->line) {                                               \
+    case CORO_LINE_DONE: return CORO_DONE;                              \
+    case 0:
+
+#define CORO_END(co)                                                    \
+    }                                                                   \
+    (co)->line = CORO_LINE_DONE;                                        \
+    (co)->flags |= CORO_F_DONE;                                         \
+    return CORO_DONE
+
+#define CORO_EXIT(co)                                                   \
+    do {                                                                \
+        (co)->line = CORO_LINE_DONE;                                    \
+        (co)->flags |= CORO_F_DONE;                                     \
+        return CORO_DONE;                                               \
+    } while (0)
+
+#define CORO_YIELD(co)                                                  \
+    do {                                                                \
+        (co)->line = __LINE__;                                          \
+        return CORO_RUNNING;                                            \
+        case __LINE__:;                                                 \
+    } while (0)
+
+#define CORO_AWAIT(co, cond)                                            \
+    do {                                                                \
+        (co)->line = __LINE__;                                          \
+        CORO_FALLTHROUGH;                                               \
+        case __LINE__:                                                  \
+        if (!(cond)) return CORO_RUNNING;                               \
+    } while (0)
+
+/*Wait for 'cond' for at most 'ticks'; check CORO_TIMED_OUT afterwards*/
+#define CORO_AWAIT_TIMEOUT(co, cond, ticks)                             \
+    do {                                                                \
+        (co)->deadline = SCHED_Now() + (ticks);                         \
+        (co)->flags &= ~CORO_F_TIMEOUT;                                 \
+        (co)->line = __LINE__;                                          \
+        CORO_FALLTHROUGH;                                               \
+        case __LINE__:                                                  \
+        if (!(cond)) {                                                  \
+            if (!coro_expired(co)) return CORO_RUNNING;                 \
+            (co)->flags |= CORO_F_TIMEOUT;                              \
+        }                                                               \
+    } while (0)
+
+/*Wait until the scheduler wakes the running task with one of 'mask'*/
+#define CORO_AWAIT_EVENT(co, mask)                                      \
+    CORO_AWAIT(co, SCHED_Events() & (mask))
+
+#define CORO_AWAIT_EVENT_TIMEOUT(co, mask, ticks)                       \
+    CORO_AWAIT_TIMEOUT(co, SCHED_Events() & (mask), ticks)
+
+#define CORO_SLEEP(co, ticks)                                           \
+    do {                                                                \
+        (co)->deadline = SCHED_Now() + (ticks);                         \
+        (co)->line = __LINE__;                                          \
+        CORO_FALLTHROUGH;                                               \
+        case __LINE__:                                                  \
+        if (!coro_expired(co)) return CORO_RUNNING;                     \
+    } while (0)
+
+#define CORO_TIMED_OUT(co)  (((co)->flags & CORO_F_TIMEOUT) != 0)
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef CRIT_H_
+#define CRIT_H_
+
+#include "sched.h"
+#include "timebase.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Priority-ceiling critical sections on BASEPRI.
+ *
+ * CRIT_Enter(&c, PRIO_x) masks every interrupt at priority PRIO_x and
+ * below (numerically >= PRIO_x) and leaves the higher tiers running, so
+ * e.g. a section shared with logging never delays the PD INTR top half.
+ * Sections nest: BASEPRI only ever rises inside, and Exit restores the
+ * previous value. The ceiling must be 1..15; 0 would unmask everything.
+ *
+ * The time spent masked is recorded per ceiling, which gives the measured
+ * worst-case blocking of every ISR tier. Ceiling 0 stands for PRIMASK
+ * sections (everything masked), accounted with CRIT_Account.
+ *
+ *     crit_t c;
+ *     CRIT_Enter(&c, PRIO_BUTTON);
+ *     ...shared with the button ISR and everything below it...
+ *     CRIT_Exit(&c);
+ */
+
+#define CRIT_LEVELS     16
+
+typedef struct {
+    uint32_t prev;          // BASEPRI to restore
+    uint32_t start;
+    uint8_t ceiling;
+} crit_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;           // cycles, racy maximum across nesting levels
+} crit_stats_t;
+
+extern crit_stats_t crit_stats[CRIT_LEVELS];
+
+static inline void CRIT_Account(uint8_t ceiling, uint32_t cycles) {
+    crit_stats_t *s = &crit_stats[ceiling & (CRIT_LEVELS - 1)];
+    s->count++;
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+}
+
+#ifdef PDT_HOST
+static inline uint32_t crit_raise(uint8_t ceiling) { return 0; }
+static inline void crit_restore(uint32_t prev) { }
+#else
+static inline uint32_t crit_raise(uint8_t ceiling) {
+    uint32_t prev = __get_BASEPRI();
+    __set_BASEPRI_MAX((uint32_t)ceiling << (8U - __NVIC_PRIO_BITS));
+    __ISB();
+    return prev;
+}
+
+static inline void crit_restore(uint32_t prev) {
+    __set_BASEPRI(prev);
+}
+#endif
+
+static inline void CRIT_Enter(crit_t *c, uint8_t ceiling) {
+    c->prev = crit_raise(ceiling);
+    c->ceiling = ceiling;
+    c->start = TIMEBASE_Cycles();
+}
+
+static inline void CRIT_Exit(crit_t *c) {
+    // Account while still masked so same-tier ISRs cannot interleave
+    CRIT_Account(c->ceiling, TIMEBASE_Cycles() - c->start);
+    crit_restore(c->prev);
+}
+
+/*Exported functions*/
+void CRIT_ResetStats(void);
+uint32_t CRIT_Blocking(uint8_t prio);
+void CRIT_Dump(sched_print_t print);
+
+#endif
@@ -1,10 +1,36 @@
 #ifndef CYPD3177_H_
 #define CYPD3177_H_
 
-#include "main.h"
 #include <stdint.h>
 #include <stdbool.h>
 
+#ifdef PDT_HOST
+// The HAL names the driver uses; a host test supplies the two transfers
+// on top of a register model
+typedef enum {
+	HAL_OK,
+	HAL_ERROR,
+	HAL_BUSY,
+	HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+typedef struct {
+	uint32_t unused;
+} I2C_HandleTypeDef;
+
+#define I2C_MEMADD_SIZE_16BIT	0x00000010U
+#define HAL_MAX_DELAY			0xFFFFFFFFU
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t dev, uint16_t reg,
+                                    uint16_t reg_size, uint8_t *data, uint16_t size,
+                                    uint32_t timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t dev, uint16_t reg,
+                                   uint16_t reg_size, uint8_t *data, uint16_t size,
+                                   uint32_t timeout);
+#else
+#include "main.h"
+#endif
+
 // I2C 7-bit address (datasheet says 0x08)
 #define CYPD3177_I2C_ADDR   (0x08 << 1)  // HAL wants 8-bit shifted
 
@@ -46,6 +72,10 @@
 #define CYPD_SINK_TX				0x4000
 #define CYPD_PE_STATE				0x8000
 
+// Fixed supply PDO fields (USB PD 3.0, 6.4.1.2)
+#define PDO_MV(pdo)		((((pdo) >> 10) & 0x3FF) * 50)
+#define PDO_FIXED(pdo)	(((pdo) >> 30) == 0)	// fixed supply, PDO_MV applies
+
 // Structs/enums
 typedef enum {
 	NO_ATT = 0x00,
@@ -94,6 +124,11 @@ HAL_StatusTypeDef CYPD3177_VBUS_mV(uint16_t *voltage);
 HAL_StatusTypeDef CYPD3177_Int_Read(cypd3177_int_t *status);
 HAL_StatusTypeDef CYPD3177_TypeC_Status_Read(cypd3177_type_c_status_t *status);
 HAL_StatusTypeDef CYPD3177_PD_Status_Read(cypd3177_pd_status_t *status);
+HAL_StatusTypeDef CYPD3177_Current_PDO_Read(uint32_t *pdo);
 HAL_StatusTypeDef CYPD3177_ChangePDO(uint32_t *pdo);
+int CYPD3177_LiveContract(const uint32_t *pdos, uint8_t count, uint16_t *vbus_mv);
+#ifdef PDT_RTOS
+void CYPD3177_RTOS_Init(void);
+#endif
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef DEFER_H_
+#define DEFER_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Deferred work queue (top half / bottom half split).
+ *
+ * ISRs do the time-critical part (timestamp, read a pin, clear the source)
+ * and post a small work item; the bottom halves run later from PendSV at
+ * the lowest NVIC priority, so they never delay another interrupt. In the
+ * PDT_RTOS build PendSV belongs to the kernel and the driver task drains
+ * the queue instead.
+ *
+ * Work items travel through an evq (see evq.h), so ISRs at any priority
+ * can post while preempting each other.
+ */
+
+#define DEFER_DEPTH     16      // must be a power of two
+
+typedef void (*defer_fn_t)(uint32_t arg);
+
+/*Exported functions*/
+void DEFER_Init(void);
+bool DEFER_Post(defer_fn_t fn, uint32_t arg);   // ISR-safe, any priority
+void DEFER_Run(void);                           // consumer only
+uint32_t DEFER_Dropped(void);
+void DEFER_Dump(sched_print_t print);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef EVFLAGS_H_
+#define EVFLAGS_H_
+
+#include "sched.h"
+#include "coro.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Event flag groups: up to 32 condition bits that producers set and clear
+ * (ISR-safe), and that tasks and coroutines wait on in combination.
+ *
+ * Setting a bit that was clear posts the group's scheduler event, so a
+ * task subscribed to it is woken to re-evaluate its condition instead of
+ * polling; the timeout side of a wait is an ordinary scheduler timer.
+ *
+ *     CORO_AWAIT_ALL(co, &pd_flags, PDF_CONTRACT | PDF_VBUS_OK, 500);
+ *     CORO_AWAIT_ANY(co, &pd_flags, PDF_DETACH, 1000);
+ *     if (CORO_TIMED_OUT(co)) ...
+ */
+
+typedef struct {
+    uint32_t flags;
+    uint32_t event;         // scheduler event posted when a bit gets set
+} evflags_t;
+
+static inline uint32_t EVFLAGS_Get(const evflags_t *g) {
+    return __atomic_load_n(&g->flags, __ATOMIC_ACQUIRE);
+}
+
+/*True if any bit of 'mask' is set*/
+static inline bool EVFLAGS_Any(const evflags_t *g, uint32_t mask) {
+    return (EVFLAGS_Get(g) & mask) != 0;
+}
+
+/*True if every bit of 'mask' is set*/
+static inline bool EVFLAGS_All(const evflags_t *g, uint32_t mask) {
+    return (EVFLAGS_Get(g) & mask) == mask;
+}
+
+#define CORO_AWAIT_ANY(co, g, mask, ticks)                              \
+    CORO_AWAIT_TIMEOUT(co, EVFLAGS_Any(g, mask), ticks)
+
+#define CORO_AWAIT_ALL(co, g, mask, ticks)                              \
+    CORO_AWAIT_TIMEOUT(co, EVFLAGS_All(g, mask), ticks)
+
+/*Exported functions*/
+void EVFLAGS_Init(evflags_t *g, uint32_t sched_event);
+uint32_t EVFLAGS_Set(evflags_t *g, uint32_t mask);
+uint32_t EVFLAGS_Clear(evflags_t *g, uint32_t mask);
+void EVFLAGS_Put(evflags_t *g, uint32_t mask, bool on);
+
+#endif
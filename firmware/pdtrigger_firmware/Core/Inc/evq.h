@@ -0,0 +1,69 @@
+#ifndef EVQ_H_
+#define EVQ_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Multi-producer single-consumer queue of fixed-size records, for passing
+ * events from interrupts (any priority) to one consumer without masking
+ * interrupts.
+ *
+ * Each slot carries a sequence number. A producer claims the next position
+ * with an exclusive load/store pair on the head (LDREX/STREX; any exception
+ * in between clears the monitor and the claim is retried), copies its
+ * record in and publishes it by advancing the slot's sequence. The
+ * consumer only takes slots whose sequence says "published", so a producer
+ * preempted half way through blocks the consumer at that slot but never
+ * corrupts it. A full queue drops the record and counts an overflow.
+ *
+ * Built with -DPDT_HOST, the same algorithm runs on C11 atomics so it can
+ * be stress-tested with threads.
+ *
+ *     EVQ_DEFINE(events, my_event_t, 16);
+ *     EVQ_Init(&events);
+ *     EVQ_Post(&events, &ev);         // from any ISR
+ *     while (EVQ_Get(&events, &ev))   // from the consumer
+ */
+
+#ifdef PDT_HOST
+#include <stdatomic.h>
+typedef _Atomic uint32_t evq_word_t;
+#else
+typedef volatile uint32_t evq_word_t;
+#endif
+
+typedef struct {
+    uint32_t posted;
+    uint32_t overflows;
+    uint32_t depth_max;
+} evq_stats_t;
+
+typedef struct {
+    evq_word_t *seq;        // per slot: == pos free, == pos + 1 published
+    uint8_t *data;          // depth records of 'size' bytes
+    uint16_t size;
+    uint16_t mask;          // depth - 1, depth a power of two
+    evq_word_t head;        // next position to claim (producers)
+    evq_word_t tail;        // next position to take (consumer)
+    evq_stats_t stats;
+} evq_t;
+
+/*Static storage for a queue of 'depth' records of 'type'*/
+#define EVQ_DEFINE(name, type, depth)                                   \
+    _Static_assert(((depth) & ((depth) - 1)) == 0, #name " depth");     \
+    static evq_word_t name##_seq[depth];                                \
+    static type name##_data[depth];                                     \
+    static evq_t name = { .seq = name##_seq,                            \
+                          .data = (uint8_t *)name##_data,               \
+                          .size = sizeof(type), .mask = (depth) - 1 }
+
+/*Exported functions*/
+void EVQ_Init(evq_t *q);
+bool EVQ_Post(evq_t *q, const void *rec);      // ISR-safe, any priority
+bool EVQ_Get(evq_t *q, void *rec);             // consumer only
+uint32_t EVQ_Depth(const evq_t *q);
+void EVQ_Dump(const evq_t *q, const char *name, sched_print_t print);
+
+#endif
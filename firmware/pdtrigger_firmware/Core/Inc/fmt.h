@@ -0,0 +1,33 @@
+#ifndef FMT_H_
+#define FMT_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Integer-only printf subset for the log and command paths, instead of
+ * newlib's vsnprintf.
+ *
+ *   %d %i %u %x %X %c %s %%    with flags '-' and '0', a width and the
+ *                              'l' / 'h' length modifiers (32-bit values)
+ *   %V                         unsigned millivolts as volts, "9.000";
+ *                              a precision of 0..3 sets the decimals and
+ *                              rounds, "%.1V" of 9050 is "9.1"
+ *
+ * Anything else is copied through as written. No heap. Stack use is
+ * fixed: one digit buffer and a few locals. The output is always
+ * terminated and truncated to fit. The return value is the length
+ * written, not vsnprintf's would-be length. tools/fmtbench.c checks the
+ * output against the C library and compares cycles per call, on the
+ * host. The flash and stack saving against newlib-nano is not measured
+ * yet; tools/fmtsize.sh takes it with the arm-none-eabi toolchain.
+ */
+
+#define FMT_WIDTH_MAX   32      // wider fields are clamped
+
+/*Exported functions*/
+size_t FMT_Vformat(char *buf, size_t size, const char *fmt, va_list args);
+size_t FMT_Format(char *buf, size_t size, const char *fmt, ...);
+
+#endif
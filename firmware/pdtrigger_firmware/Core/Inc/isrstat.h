@@ -0,0 +1,108 @@
+#ifndef ISRSTAT_H_
+#define ISRSTAT_H_
+
+#include "sched.h"
+#include "timebase.h"
+#include "app_isr.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Interrupt latency and duration histograms, in core cycles.
+ *
+ * Buckets are powers of two: bucket 0 holds < 32 cycles, bucket b holds
+ * [2^(b+4), 2^(b+5)) and the last bucket everything from 2^19 cycles up
+ * (~6 ms at 84 MHz). Each source is written only by its own handler, which
+ * cannot preempt itself, so recording needs no locking; a reset is a
+ * request the handler applies on its next sample. Recording costs one CLZ
+ * and a few loads/stores (~20 cycles).
+ *
+ * Latency needs a hardware reference and is only recorded where there is
+ * one: SysTick (cycles since the counter wrapped). The PD event path is
+ * a pseudo-source written from task context: EXTI entry to pd_int task
+ * dispatch.
+ */
+
+#define ISRSTAT_BUCKETS     16
+#define ISRSTAT_MIN_SHIFT   5       // bucket 0 upper bound = 2^5 cycles
+
+typedef enum {
+    ISR_SYSTICK,
+    ISR_PD_INTR,        // EXTI15_10
+    ISR_BUTTON,         // EXTI9_5
+    ISR_I2C3_EV,
+    ISR_I2C3_ER,
+    ISR_UART_TX,        // DMA1_Stream6, TX chunk done
+    ISR_UART_RX,        // DMA1_Stream5, RX half/full buffer
+    ISR_UART,           // USART2: RX idle line, TX complete and errors
+    ISR_PENDSV,         // bottom halves (and the scheduler in PDT_ISR_ONLY)
+    ISR_PD_PATH,        // latency only, recorded by pd_int_task
+    ISR_SOURCES
+} isr_src_t;
+
+typedef struct {
+    uint32_t lat[ISRSTAT_BUCKETS];
+    uint32_t dur[ISRSTAT_BUCKETS];
+    uint32_t lat_max;
+    uint32_t dur_max;
+    uint32_t count;
+    uint32_t lat_count;
+    volatile uint8_t reset_req;
+} isr_hist_t;
+
+extern isr_hist_t isr_hist[ISR_SOURCES];
+
+static inline uint32_t isrstat_bucket(uint32_t cycles) {
+    uint32_t b = 31U - (uint32_t)__builtin_clz(cycles | 1U);
+    b = (b >= ISRSTAT_MIN_SHIFT) ? b - (ISRSTAT_MIN_SHIFT - 1) : 0;
+    return (b < ISRSTAT_BUCKETS) ? b : ISRSTAT_BUCKETS - 1;
+}
+
+static inline isr_hist_t *isrstat_slot(isr_src_t src) {
+    isr_hist_t *h = &isr_hist[src];
+    if (h->reset_req) {
+        __builtin_memset(h, 0, sizeof(*h));
+    }
+    return h;
+}
+
+/*Stamp at handler entry*/
+static inline uint32_t ISRSTAT_Enter(void) {
+    uint32_t now = TIMEBASE_Cycles();
+#ifdef PDT_ISR_ONLY
+    APP_ISR_WakeEnter(now);
+#endif
+    return now;
+}
+
+/*Record handler duration at exit*/
+static inline void ISRSTAT_Exit(isr_src_t src, uint32_t start) {
+    uint32_t now = TIMEBASE_Cycles();
+    uint32_t cycles = now - start;
+    isr_hist_t *h = isrstat_slot(src);
+    h->dur[isrstat_bucket(cycles)]++;
+    h->count++;
+    if (cycles > h->dur_max) {
+        h->dur_max = cycles;
+    }
+#ifdef PDT_ISR_ONLY
+    APP_ISR_WakeExit(now);
+#endif
+}
+
+/*Record an entry latency measured against a hardware reference*/
+static inline void ISRSTAT_Latency(isr_src_t src, uint32_t cycles) {
+    isr_hist_t *h = isrstat_slot(src);
+    h->lat[isrstat_bucket(cycles)]++;
+    h->lat_count++;
+    if (cycles > h->lat_max) {
+        h->lat_max = cycles;
+    }
+}
+
+/*Exported functions*/
+void ISRSTAT_Reset(void);
+void ISRSTAT_Dump(sched_print_t print);
+void ISRSTAT_DumpSource(sched_print_t print, isr_src_t src);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LINK_H_
+#define LINK_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * USART2 line rate: boots at LINK_BASE_BAUD, a host may negotiate more.
+ *
+ *   host                                    device
+ *   "baud 2000000"      @115200  ->
+ *                                <-  "ok"   @115200
+ *                                           LINK_SWITCH_MS later: switch
+ *   switch, then "ping" @2000000 ->
+ *                                <-  "ok"   @2000000, rate confirmed
+ *
+ * If no command line gets through at the new rate within LINK_CONFIRM_MS
+ * the device goes back to the base rate on its own, so a host that missed
+ * the "ok" or can't do the rate just retries at 115200. Once confirmed,
+ * RX framing/noise errors are counted per LINK_CHECK_MS window; a burst
+ * of them (a host that reopened the port at 115200, a marginal cable)
+ * also drops the link back to the base rate.
+ *
+ * The divisor is computed here rather than by HAL, whose USARTDIV goes
+ * through a truncated 1/100 step and lands a whole BRR step off at some
+ * rates. 16x oversampling is used where PCLK1 allows, else 8x. A rate is
+ * accepted only within LINK_TOL_PPM of what was asked. The clock governor
+ * moves PCLK1 between 42 and 16 MHz; LINK_Reclock re-derives the divisor
+ * after each switch and falls back if the new clock can't hold the rate.
+ * 1 and 2 Mbaud are exact at both.
+ *
+ * The UART itself is behind the apply callback (LINK_UartApply on the
+ * target), so the state machine builds with -DPDT_HOST.
+ */
+
+#define LINK_BASE_BAUD      115200
+#define LINK_MAX_BAUD       2000000
+#define LINK_TOL_PPM        15000   // 1.5%, leaves the rest of ~3% to the host
+#define LINK_SWITCH_MS      20      // for the "ok" to reach the ring and drain
+#define LINK_CONFIRM_MS     1000
+#define LINK_CONFIRM_POLL_MS 10
+#define LINK_CHECK_MS       250
+#define LINK_ERR_MIN        4       // errors per window before the ratio counts
+#define LINK_ERR_RATIO      32      // fall back at 1 error per 32 bytes or worse
+
+typedef enum {
+    LINK_BASE,          // at LINK_BASE_BAUD
+    LINK_SWITCHING,     // "ok" sent, switch pending
+    LINK_CONFIRMING,    // at the new rate, waiting for the host
+    LINK_FAST           // confirmed, watching the error rate
+} link_state_t;
+
+// Program the UART for 'baud' from the current clock; false if unreachable
+typedef bool (*link_apply_t)(uint32_t baud);
+
+typedef struct {
+    uint32_t switches;      // rate changes requested by the host
+    uint32_t confirmed;
+    uint32_t timeouts;      // host never heard at the new rate
+    uint32_t fallbacks;     // error rate or clock switch
+    uint32_t rx_errors;     // framing/noise errors seen
+} link_stats_t;
+
+/*Exported functions*/
+void LINK_Init(link_apply_t apply, sched_clock_t clock);
+const char *LINK_Request(uint32_t baud);
+uint32_t LINK_Poll(void);
+void LINK_Reclock(void);
+void LINK_RxError(void);            // ISR-safe
+uint16_t LINK_Brr(uint32_t pclk, uint32_t rate, bool *over8);
+uint32_t LINK_Baud(void);
+link_state_t LINK_State(void);
+const link_stats_t *LINK_Stats(void);
+void LINK_Dump(sched_print_t print);
+#ifndef PDT_HOST
+bool LINK_UartApply(uint32_t baud);
+#endif
+
+#endif
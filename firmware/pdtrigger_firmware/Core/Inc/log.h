@@ -0,0 +1,93 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+#include "sched.h"
+#include <stdint.h>
+
+/*
+ * Leveled logging with per-module compile-time limits.
+ *
+ *     LOG_INFO(PD, "PD event: 0x%02X\r\n", clear);
+ *
+ * A call above LOG_LEVEL_<module> is a constant-false branch: the format
+ * string is not emitted and the arguments are not evaluated, at any
+ * optimisation level. Below it, the call is also checked against the
+ * module's runtime level, which LOG_SetLevel can move between OFF and
+ * the compiled level but never above it.
+ *
+ * Compiled levels default to LOG_LEVEL_DEFAULT and are overridden per
+ * build with -DLOG_LEVEL_<module>=LOG_LVL_x (or a number).
+ * tools/logsize.sh compares flash use across such configurations.
+ *
+ * Output goes through LOG_Printf, or as binary records with -DPDT_BLOG
+ * (see blog.h).
+ */
+
+#define LOG_LVL_OFF     0
+#define LOG_LVL_ERROR   1
+#define LOG_LVL_WARN    2
+#define LOG_LVL_INFO    3
+#define LOG_LVL_DEBUG   4
+#define LOG_LVL_TRACE   5
+
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT   LOG_LVL_INFO
+#endif
+
+typedef enum {
+    LOG_MOD_SYS,        // banner, telemetry
+    LOG_MOD_PD,         // controller state and INTR events
+    LOG_MOD_PDO,        // PDO change sequence
+    LOG_MOD_I2C,        // CYPD3177 register traffic
+    LOG_MODULES
+} log_module_t;
+
+#ifndef LOG_LEVEL_SYS
+#define LOG_LEVEL_SYS       LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_PD
+#define LOG_LEVEL_PD        LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_PDO
+#define LOG_LEVEL_PDO       LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_I2C
+#ifdef DEBUG
+#define LOG_LEVEL_I2C       LOG_LVL_TRACE   // compiled in, off at runtime
+#else
+#define LOG_LEVEL_I2C       LOG_LVL_WARN
+#endif
+#endif
+
+extern uint8_t log_level[LOG_MODULES];
+
+#ifdef PDT_BLOG
+#include "blog.h"
+#define LOG_EMIT(...)   BLOG(__VA_ARGS__)
+#else
+#define LOG_EMIT(...)   LOG_Printf(__VA_ARGS__)
+#endif
+
+#define LOG_AT(mod, lvl, ...)                                           \
+    do {                                                                \
+        if ((lvl) <= LOG_LEVEL_##mod && (lvl) <= log_level[LOG_MOD_##mod]) { \
+            LOG_EMIT(__VA_ARGS__);                                      \
+        }                                                               \
+    } while (0)
+
+#define LOG_ERROR(mod, ...)     LOG_AT(mod, LOG_LVL_ERROR, __VA_ARGS__)
+#define LOG_WARN(mod, ...)      LOG_AT(mod, LOG_LVL_WARN, __VA_ARGS__)
+#define LOG_INFO(mod, ...)      LOG_AT(mod, LOG_LVL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(mod, ...)     LOG_AT(mod, LOG_LVL_DEBUG, __VA_ARGS__)
+#define LOG_TRACE(mod, ...)     LOG_AT(mod, LOG_LVL_TRACE, __VA_ARGS__)
+
+/*Exported functions*/
+void LOG_Printf(const char *fmt, ...);
+uint8_t LOG_SetLevel(log_module_t mod, uint8_t level);
+uint8_t LOG_Compiled(log_module_t mod);
+int LOG_ModuleByName(const char *name);
+int LOG_LevelByName(const char *name);
+const char *LOG_LevelName(uint8_t level);
+void LOG_Dump(sched_print_t print);
+
+#endif
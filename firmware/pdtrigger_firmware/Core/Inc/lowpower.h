@@ -0,0 +1,53 @@
+#ifndef LOWPOWER_H_
+#define LOWPOWER_H_
+
+#include "sched.h"
+#include <stdint.h>
+#ifndef PDT_HOST
+#include "main.h"
+#endif
+
+/*
+ * Tickless idle. When the scheduler has nothing to run, SysTick is
+ * stretched to the next timer deadline and the core sleeps in WFI until
+ * that deadline or an EXTI (PC11 INTR, PB7 button) wakes it.
+ *
+ * The tick arithmetic (how long to sleep, the stretched reload, and what
+ * to credit to the HAL tick on an early wake) is hardware-free, so it is
+ * also built with -DPDT_HOST for tests/lowpower_test.c.
+ */
+
+#define LOWPOWER_LOAD_MAX   0xFFFFFFUL      // SysTick reload is 24 bits
+
+typedef enum {
+    WAKE_TIMER,         // SysTick reached the stretched deadline
+    WAKE_PD_INTR,       // EXTI11, CYPD3177 INTR
+    WAKE_BUTTON,        // EXTI7, PB7
+    WAKE_OTHER,         // any other interrupt (UART, I2C, ...)
+    WAKE_CAUSES
+} wake_cause_t;
+
+typedef struct {
+    uint32_t sleeps;
+    uint32_t wakes[WAKE_CAUSES];
+    uint64_t idle_us;
+    uint32_t since_ms;  // HAL tick when the counters were last reset
+} lowpower_stats_t;
+
+/*Exported functions*/
+uint32_t LOWPOWER_SleepTicks(uint32_t max_ticks);
+uint32_t LOWPOWER_StretchLoad(uint32_t remain, uint32_t ticks, uint32_t per_tick);
+uint32_t LOWPOWER_Credit(uint32_t slept, uint32_t remain, uint32_t per_tick,
+                         uint32_t *finish_load);
+
+#ifndef PDT_HOST
+void LOWPOWER_Init(void);
+void LOWPOWER_Reclock(void);
+void LOWPOWER_Idle(void);
+uint32_t LOWPOWER_IdlePermille(void);
+const lowpower_stats_t *LOWPOWER_Stats(void);
+void LOWPOWER_ResetStats(void);
+void LOWPOWER_Dump(sched_print_t print);
+#endif
+
+#endif
@@ -41,6 +41,30 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+/* Scheduler event bits posted from interrupt context */
+#define EVT_PD_INTR     (1UL << 0)  // CYPD3177 INTR falling edge
+#define EVT_BUTTON      (1UL << 1)  // PB7 button falling edge
+#define EVT_PD_FLAGS    (1UL << 2)  // a pd_flags bit was set
+#define EVT_CMD         (1UL << 3)  // USART2 RX event, see cmd.h
+
+/* NVIC priority tiers (group 4, lower number preempts). Everything that
+   calls into the kernel in the PDT_RTOS build sits at or below 5, which
+   leaves 0..4 free for anything that must never be masked.
+     5  PRIO_PD_INTR  EXTI15_10  CYPD3177 INTR top half
+     6  PRIO_I2C      I2C3 EV/ER transfer completion
+     7  PRIO_BUTTON   EXTI9_5    button top half
+    10  PRIO_LOG      USART2 / log DMA
+    14  PRIO_TICK_ISR            SysTick in the PDT_ISR_ONLY build
+    15  PRIO_DEFER    PendSV     bottom halves (see defer.h)
+    15  TICK_INT_PRIORITY        SysTick
+   A PD event therefore preempts logging and bottom halves, never the
+   reverse. Keep pdtrigger_firmware.ioc in sync. */
+#define PRIO_PD_INTR    5
+#define PRIO_I2C        6
+#define PRIO_BUTTON     7
+#define PRIO_LOG        10
+#define PRIO_TICK_ISR   14
+#define PRIO_DEFER      15
 
 /* USER CODE END EC */
 
@@ -0,0 +1,68 @@
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Cooperative run-to-completion scheduler.
+ *
+ * Tasks are woken by a timer (periodic or one-shot) and/or by event bits
+ * posted from interrupt context. Timers live in a hashed timer wheel with
+ * one slot per clock tick. The scheduler has no hardware dependencies: the
+ * clock is injected, so the same code runs on the target (HAL_GetTick) and
+ * on a host build driven by a virtual clock.
+ */
+
+#define SCHED_MAX_TASKS     12      // must be <= 32 (ready set is a bitmask)
+#define SCHED_WHEEL_SLOTS   32      // must be a power of two
+#define SCHED_NO_TASK       0xFF
+
+typedef uint8_t sched_id_t;
+typedef void (*sched_fn_t)(void *arg);
+typedef uint32_t (*sched_clock_t)(void);
+
+// Per-task statistics. Run times are in stat clock units, lateness in
+// scheduler ticks.
+typedef struct {
+    uint32_t runs;
+    uint32_t run_last;
+    uint32_t run_max;
+    uint32_t run_total;
+    uint32_t late_last;     // dispatch time minus deadline
+    uint32_t late_max;
+    uint32_t missed;        // periodic deadlines skipped entirely
+} sched_stats_t;
+
+typedef void (*sched_print_t)(const char *fmt, ...);
+typedef void (*sched_hook_t)(sched_id_t id, uint32_t run);
+
+/*Exported functions*/
+void SCHED_Init(sched_clock_t clock);
+void SCHED_SetStatClock(sched_clock_t clock);
+void SCHED_SetRunHook(sched_hook_t hook);
+
+sched_id_t SCHED_AddPeriodic(const char *name, sched_fn_t fn, void *arg,
+                             uint32_t period, uint32_t phase);
+sched_id_t SCHED_AddOneShot(const char *name, sched_fn_t fn, void *arg);
+void SCHED_Subscribe(sched_id_t id, uint32_t event_mask);
+
+void SCHED_Start(sched_id_t id, uint32_t delay);
+void SCHED_Stop(sched_id_t id);
+void SCHED_SetPeriod(sched_id_t id, uint32_t period);
+bool SCHED_IsArmed(sched_id_t id);
+
+void SCHED_PostEvent(uint32_t mask);         // ISR-safe
+uint32_t SCHED_Events(void);                 // events that woke the running task
+sched_id_t SCHED_Current(void);
+
+bool SCHED_RunOnce(void);
+bool SCHED_NextDeadline(uint32_t *ticks);
+uint32_t SCHED_Now(void);
+
+const sched_stats_t *SCHED_Stats(sched_id_t id);
+const char *SCHED_Name(sched_id_t id);
+void SCHED_ResetStats(void);
+void SCHED_Dump(sched_print_t print);
+
+#endif
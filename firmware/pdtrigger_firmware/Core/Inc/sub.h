@@ -0,0 +1,70 @@
+#ifndef SUB_H_
+#define SUB_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Telemetry subscriptions: what is sampled and sent is what a host asked
+ * for, topic by topic.
+ *
+ *   sub                         list topics and their counters
+ *   sub <topic|all> <ms>        sample and send every ms
+ *   sub <topic|all> change [ms] sample every ms (SUB_CHANGE_MS), send
+ *                               only when the value differs from the last
+ *   sub <topic|all> off
+ *
+ * The application registers a table of topics: a sampler, which does the
+ * bus reads and fills in a small value, and an emitter that puts it on
+ * the wire. A topic that is off is never sampled, so it costs neither
+ * I2C nor UART time, and SUB_Poll returns 0 once nothing is subscribed:
+ * the task running it sleeps until a host subscribes again.
+ *
+ * Events the application sees anyway (PD INTR, a finished PDO change) are
+ * passed to SUB_Changed, which makes the on-change topics they affect due
+ * at once rather than at their next sample. SUB_Changed and SUB_Command
+ * return true / NULL when the caller should run SUB_Poll early.
+ *
+ * Poll may run in another task than Command and Changed (the telemetry
+ * task in the PDT_RTOS build); the state they share is only touched in
+ * short critical sections, never across a sampler.
+ */
+
+#define SUB_TOPICS_MAX      8
+#define SUB_VALUE_MAX       16      // bytes a sampler may fill in
+#define SUB_CHANGE_MS       100     // default sampling of on-change topics
+#define SUB_MIN_MS          10
+#define SUB_MAX_MS          3600000
+
+typedef enum {
+    SUB_OFF,
+    SUB_PERIODIC,       // send every sample
+    SUB_ON_CHANGE       // send samples that differ from the last one sent
+} sub_mode_t;
+
+typedef struct {
+    const char *name;
+    uint8_t size;                               // of the value, <= SUB_VALUE_MAX
+    bool (*sample)(uint8_t *value);             // false: nothing to report now
+    void (*emit)(const uint8_t *value);
+} sub_topic_t;
+
+typedef struct {
+    uint32_t samples;       // sampler calls
+    uint32_t failed;        // sampler had nothing (offline, I2C error)
+    uint32_t sent;
+    uint32_t unchanged;     // on-change samples not sent
+} sub_stats_t;
+
+/*Exported functions*/
+void SUB_Init(const sub_topic_t *topics, uint8_t count, sched_clock_t clock);
+const char *SUB_Set(uint8_t topic, sub_mode_t mode, uint32_t period_ms);
+const char *SUB_Command(uint8_t argc, char *argv[]);
+bool SUB_Changed(uint32_t topic_mask);
+uint32_t SUB_Poll(void);
+uint32_t SUB_Active(void);
+const sub_stats_t *SUB_Stats(uint8_t topic);
+void SUB_Dump(sched_print_t print);
+
+#endif
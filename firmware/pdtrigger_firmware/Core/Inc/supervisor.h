@@ -0,0 +1,44 @@
+#ifndef SUPERVISOR_H_
+#define SUPERVISOR_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Task supervisor. Every watched task gets a run time budget; a run that
+ * exceeds it is recorded as an overrun (task and duration). Tasks with a
+ * check-in window are required: the watchdog is only fed once all of them
+ * have completed a run since the previous feed, so a task that hangs (or
+ * stops being scheduled) ends in an IWDG reset.
+ *
+ * The logic is hardware-free: the scheduler reports finished runs through
+ * its run hook and the feed action is injected. With -DPDT_HOST the IWDG
+ * backend is left out so stalls can be injected from a host test.
+ */
+
+#define SUPERVISOR_IWDG_MS  1000    // nominal; LSI tolerance makes it 0.7..2 s
+
+typedef void (*supervisor_feed_t)(void);
+
+typedef struct {
+    uint32_t overruns;
+    uint32_t last_over;     // duration of the latest overrun, stat clock units
+    uint32_t worst;         // longest run seen
+    uint32_t starved;       // check-in windows missed
+} supervisor_stats_t;
+
+/*Exported functions*/
+void SUPERVISOR_Init(sched_clock_t clock, supervisor_feed_t feed);
+void SUPERVISOR_Watch(sched_id_t id, uint32_t budget, uint32_t window_ms);
+void SUPERVISOR_TaskDone(sched_id_t id, uint32_t run);
+bool SUPERVISOR_Poll(void);
+const supervisor_stats_t *SUPERVISOR_Stats(sched_id_t id);
+void SUPERVISOR_Dump(sched_print_t print);
+
+#ifndef PDT_HOST
+void SUPERVISOR_IwdgStart(uint32_t timeout_ms);
+void SUPERVISOR_IwdgFeed(void);
+#endif
+
+#endif
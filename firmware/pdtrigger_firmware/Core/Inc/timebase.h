@@ -0,0 +1,52 @@
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Free-running microsecond timebase on TIM5 (32-bit, wraps every ~71 min)
+ * plus the DWT cycle counter for sub-microsecond spans. Always compare
+ * timestamps through TIMEBASE_Elapsed / TIMEBASE_Reached so wraps are safe.
+ *
+ * Built with -DPDT_HOST, both clocks map onto clock_gettime(CLOCK_MONOTONIC).
+ */
+
+#ifdef PDT_HOST
+#include <time.h>
+
+#define TIMEBASE_CYCLES_PER_US  1000U   // host "cycles" are nanoseconds
+
+static inline uint32_t TIMEBASE_Cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+#else
+#include "main.h"
+
+#define TIMEBASE_CYCLES_PER_US  (SystemCoreClock / 1000000U)
+
+/*Core clock cycles; wraps every ~51 s at 84 MHz*/
+static inline uint32_t TIMEBASE_Cycles(void) {
+    return DWT->CYCCNT;
+}
+#endif
+
+/*Exported functions*/
+void TIMEBASE_Init(void);
+void TIMEBASE_Reclock(void);
+uint32_t TIMEBASE_Micros(void);
+uint32_t TIMEBASE_CyclesToNs(uint32_t cycles);
+
+/*Microseconds since 'start'; correct across one counter wrap*/
+static inline uint32_t TIMEBASE_Elapsed(uint32_t start) {
+    return TIMEBASE_Micros() - start;
+}
+
+/*True once 'deadline' (in microseconds) has passed*/
+static inline bool TIMEBASE_Reached(uint32_t deadline) {
+    return (int32_t)(TIMEBASE_Micros() - deadline) >= 0;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TLM_H_
+#define TLM_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Framed binary telemetry (compile with -DPDT_TLM).
+ *
+ * Every byte on USART2 then belongs to a frame; log text travels in
+ * TLM_MSG_TEXT frames. The host decoder is firmware/tools/tlmdec.cpp.
+ *
+ *     COBS( type, seq, payload..., crc16 lo, crc16 hi ) 0x00
+ *
+ * COBS removes every zero from the frame, so 0x00 only ever delimits and
+ * a receiver that starts mid-stream, or loses bytes to a TX ring drop,
+ * is back in sync at the next delimiter. The CRC is CRC-16/CCITT-FALSE
+ * (poly 0x1021, init 0xFFFF) over type, seq and payload. seq counts
+ * frames modulo 256, so the host can tell how many it missed.
+ *
+ * Payload fields are little-endian and unpadded; times are HAL ticks
+ * (ms). A new field is only ever appended to a message, and the decoder
+ * ignores trailing bytes it does not know, so TLM_SCHEMA only changes
+ * when a field's meaning does. TLM_MSG_HELLO carries it and is sent at
+ * boot and with every report, for hosts that attach late.
+ *
+ *   HELLO   u8 schema, u8 build flags (TLM_BUILD_x), u32 ms
+ *   STATUS  u32 ms, u8 flags (TLM_ST_x), u8 pdo_index, u8 pdo_target,
+ *           u16 vbus mV
+ *   EVENT   u32 ms, u8 event (tlm_event_t), u8 arg, u16 mV
+ *   VBUS    u32 ms, u16 mV (no longer sent; VBUS is a STATE field)
+ *   TEXT    log text, not terminated
+ *   STATE   u32 ms, u16 mask (bit n: field n, TLM_STATE_KEY), then each
+ *           field in the mask in field order, at its size (tlm_field_t)
+ *
+ * STATE carries the subscribed topics (see sub.h) as a delta: the
+ * encoder keeps the last value sent per field and a frame holds only
+ * the fields that changed since. Nothing changed, nothing is sent. Every
+ * TLM_KEY_MS, and after each HELLO, a keyframe (TLM_STATE_KEY) carries
+ * every field of the subscribed topics instead, so a host that attached
+ * late or saw a seq gap has the full state again; until then it should
+ * treat what it holds as stale. A field a new subscription brings in is
+ * sent with the next frame even if unchanged. STATUS is still sent for
+ * "status" requests; EVENT, HELLO and TEXT always are.
+ */
+
+typedef enum {
+    TLM_MSG_HELLO = 1,
+    TLM_MSG_STATUS,
+    TLM_MSG_EVENT,
+    TLM_MSG_VBUS,
+    TLM_MSG_TEXT,
+    TLM_MSG_STATE
+} tlm_msg_t;
+
+typedef enum {
+    TLM_F_FLAGS,            // u8, TLM_ST_x
+    TLM_F_PDO_INDEX,        // u8
+    TLM_F_PDO_TARGET,       // u8
+    TLM_F_VBUS,             // u16 mV
+    TLM_F_TYPEC,            // u8, Type-C status register
+    TLM_F_PD,               // u32, PD status register
+    TLM_F_PD_EVENTS,        // u32, counters from here on
+    TLM_F_CMD_LINES,        // u32
+    TLM_F_TX_DROPPED,       // u32, UART TX bytes
+    TLM_F_RX_ERRORS,        // u32, UART RX framing/noise
+    TLM_FIELDS
+} tlm_field_t;
+
+#define TLM_FIELD(f)        (1UL << (f))
+#define TLM_STATE_KEY       (1U << 15)
+
+#define TLM_BUILD_RTOS      (1U << 0)
+#define TLM_BUILD_ISR_ONLY  (1U << 1)
+#define TLM_BUILD_DEBUG     (1U << 2)
+
+#define TLM_ST_ONLINE       (1U << 0)   // CYPD3177 in active mode
+#define TLM_ST_CONTRACT     (1U << 1)   // source answered the last request
+#define TLM_ST_VBUS_OK      (1U << 2)   // VBUS within 5% of pdo_target
+#define TLM_ST_CHANGING     (1U << 3)   // PDO change in progress
+
+typedef enum {
+    TLM_EV_PD_INTR = 1,     // arg: interrupt sources cleared
+    TLM_EV_OFFLINE,         // CYPD3177 stopped answering
+    TLM_EV_PDO_REQUEST,     // arg: PDO index, mV: its voltage
+    TLM_EV_PDO_DONE,        // arg: PDO index, mV: its voltage
+    TLM_EV_PDO_FAILED,      // arg: PDO index, request not written
+    TLM_EV_PDO_TIMEOUT,     // arg: PDO index, VBUS never got there
+    TLM_EV_PDO_CANCEL,      // arg: PDO index
+    TLM_EV_ADOPTED          // arg: PDO index kept across reset, mV
+} tlm_event_t;
+
+#ifdef PDT_TLM
+
+#ifdef PDT_BLOG
+#error "PDT_TLM and PDT_BLOG both own the UART stream"
+#endif
+
+#define TLM_SCHEMA          1
+#define TLM_PAYLOAD_MAX     64      // longer text is split across frames
+#define TLM_FRAME_MAX       (2 + TLM_PAYLOAD_MAX + 2)       // before COBS
+#define TLM_WIRE_MAX        (TLM_FRAME_MAX + TLM_FRAME_MAX / 254 + 2)
+#define TLM_KEY_MS          5000
+
+typedef struct {
+    uint32_t frames;        // frames handed to the UART
+    uint32_t dropped;       // frames the UART path refused
+    uint32_t bytes;         // wire bytes, delimiters included
+    uint32_t states;        // STATE frames sent
+    uint32_t keyframes;     // of which keyframes
+} tlm_stats_t;
+
+/*Exported functions*/
+bool TLM_Send(tlm_msg_t type, const uint8_t *payload, uint16_t len);
+void TLM_Hello(void);
+void TLM_Status(uint8_t flags, uint8_t pdo_index, uint8_t pdo_target, uint16_t mv);
+void TLM_Event(tlm_event_t event, uint8_t arg, uint16_t mv);
+void TLM_State(tlm_field_t field, uint32_t value);
+void TLM_StateFlush(uint32_t live);
+void TLM_Text(const char *buf, uint16_t len);
+uint16_t TLM_Encode(uint8_t *wire, tlm_msg_t type, uint8_t seq,
+                    const uint8_t *payload, uint16_t len);
+uint16_t TLM_Crc16(uint16_t crc, const uint8_t *p, uint16_t len);
+const tlm_stats_t *TLM_Stats(void);
+void TLM_Dump(sched_print_t print);
+
+#else
+
+// Call sites stay unconditional; without PDT_TLM they compile to nothing
+static inline void TLM_Hello(void) { }
+static inline void TLM_Status(uint8_t flags, uint8_t pdo_index, uint8_t pdo_target, uint16_t mv) { }
+static inline void TLM_Event(tlm_event_t event, uint8_t arg, uint16_t mv) { }
+static inline void TLM_State(tlm_field_t field, uint32_t value) { }
+static inline void TLM_StateFlush(uint32_t live) { }
+static inline void TLM_Dump(sched_print_t print) { }
+
+#endif /* PDT_TLM */
+
+#endif
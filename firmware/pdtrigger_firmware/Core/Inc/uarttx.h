@@ -0,0 +1,61 @@
+#ifndef UARTTX_H_
+#define UARTTX_H_
+
+#include "sched.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * USART2 transmit ring drained by DMA1 Stream6.
+ *
+ * UARTTX_Write only copies into the ring; the DMA interrupt copies up to
+ * UARTTX_CHUNK bytes at a time into a separate DMA buffer and starts the
+ * next transfer, so the bytes left in the ring are never in flight and
+ * can be discarded under the DROP_OLDEST policy. A log line costs its
+ * formatting and a memcpy instead of ~87 us per byte at 115200 baud.
+ *
+ * Writers may run in thread mode or in any ISR below PRIO_LOG; the ring
+ * is guarded by a PRIO_LOG critical section. UARTTX_BLOCK falls back to
+ * dropping the new data where the DMA interrupt cannot preempt the
+ * caller, as waiting there would never end.
+ *
+ * Built with -DPDT_HOST, the DMA is replaced by a simulated UART that
+ * completes a chunk once 10 bit times per byte have elapsed at the
+ * configured baud rate, and writes it to a FILE.
+ */
+
+#define UARTTX_RING_SIZE    1024    // must be a power of two
+#define UARTTX_CHUNK        64      // bytes per DMA transfer, bounds Suspend
+
+typedef enum {
+    UARTTX_DROP_NEWEST,     // discard a write that doesn't fit, whole
+    UARTTX_DROP_OLDEST,     // discard queued bytes to make room
+    UARTTX_BLOCK            // wait for the DMA to make room
+} uarttx_policy_t;
+
+typedef struct {
+    uint32_t written;       // bytes accepted into the ring
+    uint32_t sent;          // bytes completed by the DMA
+    uint32_t dropped;       // bytes lost to either drop policy
+    uint32_t blocked;       // writes that had to wait
+    uint32_t errors;        // transfers ended by a DMA/UART error
+    uint16_t high_water;    // most bytes ever queued
+} uarttx_stats_t;
+
+/*Exported functions*/
+void UARTTX_Init(uarttx_policy_t policy);
+void UARTTX_SetPolicy(uarttx_policy_t policy);
+uint16_t UARTTX_Write(const char *buf, uint16_t len);
+uint32_t UARTTX_Pending(void);
+void UARTTX_Flush(void);
+void UARTTX_Suspend(void);
+void UARTTX_Resume(void);
+void UARTTX_TxDone(void);
+const uarttx_stats_t *UARTTX_Stats(void);
+void UARTTX_Dump(sched_print_t print);
+#ifdef PDT_HOST
+#include <stdio.h>
+void UARTTX_SimInit(uint32_t baud, FILE *out);
+#endif
+
+#endif
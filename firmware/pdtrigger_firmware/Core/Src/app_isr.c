@@ -0,0 +1,87 @@
+#include "app_isr.h"
+
+#ifdef PDT_ISR_ONLY
+
+#include "supervisor.h"
+#include "clockgov.h"
+
+#define NO_DEADLINE_MS  1000U   // re-check this often with nothing scheduled
+
+app_isr_wake_t app_isr_wake;
+
+static volatile uint32_t next_due;  // HAL tick at which SysTick pends PendSV
+
+
+static uint32_t ns_per_cycle_q16(void) {
+    return (uint32_t)((1000ULL << 16) / (SystemCoreClock / 1000000U));
+}
+
+
+/*Hand the rest of the run over to interrupts; does not return*/
+void APP_ISR_Start(void) {
+    // Tick above PendSV so HAL_GetTick advances while a task runs
+    HAL_InitTick(PRIO_TICK_ISR);
+#ifdef DEBUG
+    HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+    app_isr_wake.ns_q16 = ns_per_cycle_q16();
+    app_isr_wake.since_ms = HAL_GetTick();
+    next_due = HAL_GetTick();
+
+    // Mark awake first: the PendSV taken below closes this wake
+    app_isr_wake.start = DWT->CYCCNT;
+    app_isr_wake.phase = APP_ISR_AWAKE;
+    SCB->SCR |= SCB_SCR_SLEEPONEXIT_Msk;
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    __DSB();
+    for (;;) {
+        __WFI();    // only reached if PendSV was not taken yet
+    }
+}
+
+
+/*PendSV, after the bottom halves: run everything that is ready*/
+void APP_ISR_Run(void) {
+    if (app_isr_wake.phase == APP_ISR_OFF) {
+        return;     // boot path still drives the scheduler from thread mode
+    }
+    while (SCHED_RunOnce()) {
+    }
+    SUPERVISOR_Poll();
+    CLOCKGOV_Update();
+    app_isr_wake.ns_q16 = ns_per_cycle_q16();
+
+    uint32_t ticks;
+    if (!SCHED_NextDeadline(&ticks)) {
+        ticks = NO_DEADLINE_MS;
+    }
+    next_due = HAL_GetTick() + ticks;
+    if (ticks == 0) {
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;     // posted while we were running
+    }
+}
+
+
+/*SysTick, after HAL_IncTick*/
+void APP_ISR_Tick(void) {
+    if ((int32_t)(HAL_GetTick() - next_due) >= 0) {
+        SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    }
+}
+
+
+/*Print the wake count and active time per wake*/
+void APP_ISR_Dump(sched_print_t print) {
+    // Only the handler returning to sleep writes these and that is this
+    // PendSV while the report runs, so no lock is needed
+    app_isr_wake_t w = app_isr_wake;
+    uint32_t total_ms = HAL_GetTick() - w.since_ms;
+    uint32_t permille = total_ms ? (uint32_t)(w.active_ns / 1000U / total_ms) : 0;
+    print("isr-only: %lu wakes, active avg %lu max %lu ns, awake %lu.%lu%%\r\n",
+          (unsigned long)w.wakes,
+          (unsigned long)(w.wakes ? w.active_ns / w.wakes : 0),
+          (unsigned long)w.active_max_ns,
+          (unsigned long)(permille / 10), (unsigned long)(permille % 10));
+}
+
+#endif
@@ -0,0 +1,267 @@
+#include "app_rtos.h"
+
+#ifdef PDT_RTOS
+
+#ifndef PDT_HOST
+#include "main.h"
+#else
+void Error_Handler(void);
+#endif
+#include "cypd3177.h"
+#include "supervisor.h"
+#include "defer.h"
+#include "uarttx.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include <string.h>
+
+#define LOG_MSG_LEN         64
+#define LOG_QUEUE_DEPTH     16
+#define LOG_DRIVER_WAIT     pdMS_TO_TICKS(5)    // longest the driver task waits to log
+#define MAX_JOBS            4
+
+#ifdef PDT_HOST
+// tools/rtosbench.c on the POSIX port: no interrupts, and each task runs
+// as a pthread on its FreeRTOS stack, which must be PTHREAD_STACK_MIN
+#define xPortIsInsideInterrupt()    pdFALSE
+#define DRIVER_STACK        configMINIMAL_STACK_SIZE
+#define TELEMETRY_STACK     configMINIMAL_STACK_SIZE
+#define UI_STACK            configMINIMAL_STACK_SIZE
+#else
+// ISRs that call FreeRTOS FromISR APIs must sit at or below the syscall ceiling
+#if PRIO_PD_INTR < configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY
+#error "PRIO_PD_INTR is above configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY"
+#endif
+
+#define DRIVER_STACK        384     // words
+#define TELEMETRY_STACK     320
+#define UI_STACK            192
+#endif
+
+#define DRIVER_PRIO         (tskIDLE_PRIORITY + 3)
+#define TELEMETRY_PRIO      (tskIDLE_PRIORITY + 2)
+#define UI_PRIO             (tskIDLE_PRIORITY + 1)
+
+typedef struct {
+    uint8_t len;
+    char text[LOG_MSG_LEN];
+} log_msg_t;
+
+static TaskHandle_t driver_handle;
+static TaskHandle_t telemetry_handle;
+static TaskHandle_t ui_handle;
+static QueueHandle_t log_queue;
+static SemaphoreHandle_t log_lock;      // keeps the items of one line together
+static app_rtos_job_t jobs[MAX_JOBS];
+static TickType_t job_next[MAX_JOBS];
+static uint8_t n_jobs;
+static uint32_t log_dropped;
+
+
+/*Run the cooperative scheduler, blocking until its next deadline*/
+static void driver_task(void *arg) {
+    for (;;) {
+        DEFER_Run();    // PendSV is the kernel's; bottom halves run here
+        while (SCHED_RunOnce()) {
+        }
+        SUPERVISOR_Poll();
+        uint32_t ticks;
+        TickType_t wait = SCHED_NextDeadline(&ticks) ? pdMS_TO_TICKS(ticks) : portMAX_DELAY;
+        if (wait) {
+            ulTaskNotifyTake(pdTRUE, wait);
+        }
+    }
+}
+
+
+/*Run each telemetry job at its own period; a period of 0 parks the job*/
+static void telemetry_task(void *arg) {
+    TickType_t now = xTaskGetTickCount();
+
+    for (uint8_t i = 0; i < n_jobs; i++) {
+        job_next[i] = now + pdMS_TO_TICKS(jobs[i].period_ms);
+    }
+    for (;;) {
+        now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        for (uint8_t i = 0; i < n_jobs; i++) {
+            TickType_t period = pdMS_TO_TICKS(jobs[i].period_ms);
+            if (period == 0) {
+                continue;
+            }
+            if ((int32_t)(now - job_next[i]) >= 0) {
+                job_next[i] += period;
+                jobs[i].fn(NULL);       // may retime itself with APP_RTOS_SetPeriod
+                if (jobs[i].period_ms == 0) {
+                    continue;
+                }
+            }
+            TickType_t left = job_next[i] - now;
+            if (left < wait) {
+                wait = left;
+            }
+        }
+        // Sleeps until the next job is due or APP_RTOS_SetPeriod retimes one
+        ulTaskNotifyTake(pdTRUE, wait ? wait : 1);
+    }
+}
+
+
+/*Drain the log queue into the USART2 TX ring*/
+static void ui_task(void *arg) {
+    log_msg_t msg;
+    for (;;) {
+        if (xQueueReceive(log_queue, &msg, portMAX_DELAY) == pdPASS) {
+            UARTTX_Write(msg.text, msg.len);
+        }
+    }
+}
+
+
+/*Cut the next queue item off the front of buf*/
+static void next_item(log_msg_t *msg, const char **buf, uint16_t *len) {
+    msg->len = (*len > LOG_MSG_LEN) ? LOG_MSG_LEN : (uint8_t)*len;
+    memcpy(msg->text, *buf, msg->len);
+    *buf += msg->len;
+    *len -= msg->len;
+}
+
+
+/*Queue a log line in LOG_MSG_LEN pieces. Tasks wait for the UI task to
+  make room: the driver task for at most LOG_DRIVER_WAIT, so the UART can
+  never hold up a PD event for long, and the others for as long as it
+  takes. An ISR never waits, and drops the line unless it fits whole and
+  no task is part way through one. Returns false if any of it was dropped.*/
+bool APP_RTOS_Log(const char *buf, uint16_t len) {
+    log_msg_t msg;
+    uint16_t items = (uint16_t)((len + LOG_MSG_LEN - 1) / LOG_MSG_LEN);
+    TickType_t wait;
+    bool ok = true;
+
+    if (log_queue == NULL) {
+        // Before the scheduler starts, straight into the TX ring
+        return UARTTX_Write(buf, len) == len;
+    }
+    if (xPortIsInsideInterrupt()) {
+        BaseType_t woken = pdFALSE;
+        if (xSemaphoreGetMutexHolderFromISR(log_lock) != NULL ||
+                LOG_QUEUE_DEPTH - uxQueueMessagesWaitingFromISR(log_queue) < items) {
+            log_dropped++;
+            return false;
+        }
+        while (len) {
+            next_item(&msg, &buf, &len);
+            xQueueSendFromISR(log_queue, &msg, &woken);
+        }
+        portYIELD_FROM_ISR(woken);
+        return true;
+    }
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        wait = 0;
+    } else if (xTaskGetCurrentTaskHandle() == driver_handle) {
+        wait = LOG_DRIVER_WAIT;
+    } else {
+        wait = portMAX_DELAY;
+    }
+    if (xSemaphoreTake(log_lock, wait) != pdPASS) {
+        log_dropped++;
+        return false;
+    }
+    while (len) {
+        next_item(&msg, &buf, &len);
+        if (xQueueSend(log_queue, &msg, wait) != pdPASS) {
+            log_dropped++;      // the rest of the line goes with it
+            ok = false;
+            break;
+        }
+    }
+    xSemaphoreGive(log_lock);
+    return ok;
+}
+
+
+/*Change a telemetry job's period (0 parks it); the next run is one new
+  period from now*/
+void APP_RTOS_SetPeriod(sched_fn_t fn, uint32_t period_ms) {
+    for (uint8_t i = 0; i < n_jobs; i++) {
+        if (jobs[i].fn == fn) {
+            taskENTER_CRITICAL();
+            jobs[i].period_ms = period_ms;
+            job_next[i] = xTaskGetTickCount() + pdMS_TO_TICKS(period_ms);
+            taskEXIT_CRITICAL();
+            if (telemetry_handle != NULL) {
+                xTaskNotifyGive(telemetry_handle);
+            }
+            return;
+        }
+    }
+}
+
+
+/*Wake the driver task after SCHED_PostEvent from an ISR*/
+void APP_RTOS_WakeFromISR(void) {
+    BaseType_t woken = pdFALSE;
+    if (driver_handle != NULL) {
+        vTaskNotifyGiveFromISR(driver_handle, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+
+/*Wake the driver task from any context (e.g. after a flag set by telemetry)*/
+void APP_RTOS_Wake(void) {
+    if (driver_handle == NULL) {
+        return;
+    }
+    if (xPortIsInsideInterrupt()) {
+        APP_RTOS_WakeFromISR();
+    } else if (xTaskGetCurrentTaskHandle() != driver_handle) {
+        xTaskNotifyGive(driver_handle);
+    }
+}
+
+
+/*Create the tasks and queues and hand over to the kernel*/
+void APP_RTOS_Start(const app_rtos_job_t *job_list, uint8_t count) {
+    n_jobs = (count > MAX_JOBS) ? MAX_JOBS : count;
+    memcpy(jobs, job_list, n_jobs * sizeof(jobs[0]));
+
+    CYPD3177_RTOS_Init();
+    log_lock = xSemaphoreCreateMutex();
+    log_queue = xQueueCreate(LOG_QUEUE_DEPTH, sizeof(log_msg_t));
+
+    xTaskCreate(driver_task, "driver", DRIVER_STACK, NULL, DRIVER_PRIO, &driver_handle);
+    xTaskCreate(telemetry_task, "telem", TELEMETRY_STACK, NULL, TELEMETRY_PRIO, &telemetry_handle);
+    xTaskCreate(ui_task, "ui", UI_STACK, NULL, UI_PRIO, &ui_handle);
+
+    vTaskStartScheduler();
+
+    // Only reached if the kernel could not allocate the idle task
+    Error_Handler();
+}
+
+
+/*RAM footprint: heap low-water mark and per-task stack headroom*/
+void APP_RTOS_Dump(app_rtos_print_t print) {
+    print("rtos heap free min %u B, log dropped %lu\r\n",
+          (unsigned)xPortGetMinimumEverFreeHeapSize(), (unsigned long)log_dropped);
+    print("stack free: driver %u, telem %u, ui %u words\r\n",
+          (unsigned)uxTaskGetStackHighWaterMark(driver_handle),
+          (unsigned)uxTaskGetStackHighWaterMark(telemetry_handle),
+          (unsigned)uxTaskGetStackHighWaterMark(ui_handle));
+}
+
+
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name) {
+    Error_Handler();
+}
+
+
+void vApplicationMallocFailedHook(void) {
+    Error_Handler();
+}
+
+#endif /* PDT_RTOS */
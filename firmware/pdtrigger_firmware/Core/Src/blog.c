@@ -0,0 +1,56 @@
+#include "blog.h"
+#include <string.h>
+
+#ifdef PDT_RTOS
+#include "app_rtos.h"
+#else
+#include "uarttx.h"
+#endif
+
+
+static void blog_out(const uint8_t *rec, uint16_t len) {
+#ifdef PDT_RTOS
+    APP_RTOS_Log((const char *)rec, len);
+#else
+    UARTTX_Write((const char *)rec, len);
+#endif
+}
+
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+
+/*Encode one record; the format string itself never leaves the ELF*/
+void BLOG_Emit(const char *fmt, const uint32_t *args, uint8_t n) {
+    uint8_t rec[BLOG_RECORD_MAX];
+    uint8_t *p = put_varint(rec, (uint32_t)(uintptr_t)fmt + 1);
+
+    for (uint8_t i = 0; i < n; i++) {
+        p = put_varint(p, args[i]);
+    }
+    blog_out(rec, (uint16_t)(p - rec));
+}
+
+
+/*Send preformatted text as ID 0 records*/
+void BLOG_Text(const char *buf, uint16_t len) {
+    uint8_t rec[2 + BLOG_TEXT_CHUNK];
+
+    while (len) {
+        uint16_t n = (len > BLOG_TEXT_CHUNK) ? BLOG_TEXT_CHUNK : len;
+        uint8_t *p = put_varint(rec, 0);
+        p = put_varint(p, n);
+        memcpy(p, buf, n);
+        p += n;
+        blog_out(rec, (uint16_t)(p - rec));
+        buf += n;
+        len -= n;
+    }
+}
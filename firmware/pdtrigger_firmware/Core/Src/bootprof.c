@@ -0,0 +1,69 @@
+#include "bootprof.h"
+#include "main.h"
+
+typedef struct {
+    uint32_t cycles;
+    uint32_t hclk;      // core clock in effect when the mark was taken
+} boot_mark_t;
+
+static boot_mark_t marks[BOOT_PHASES];
+static uint8_t reached_mask;
+
+static const char *const phase_names[BOOT_PHASES] = {
+    "crt0", "hal_init", "clock", "gpio+i2c", "pd_online",
+    "pdo_request", "uart+leds", "contract"
+};
+
+
+/*Record the first time a phase completes. Returns true on that first call.*/
+bool BOOTPROF_Mark(boot_phase_t phase) {
+    if (BOOTPROF_Reached(phase)) {
+        return false;
+    }
+    marks[phase].cycles = DWT->CYCCNT;
+    marks[phase].hclk = SystemCoreClock;
+    reached_mask |= (1u << phase);
+    return true;
+}
+
+
+bool BOOTPROF_Reached(boot_phase_t phase) {
+    return (reached_mask & (1u << phase)) != 0;
+}
+
+
+/*Microseconds from reset to the end of a phase*/
+uint32_t BOOTPROF_Us(boot_phase_t phase) {
+    // Reset runs on HSI (16 MHz) until SystemClock_Config switches to the PLL
+    uint32_t prev_cycles = 0;
+    uint32_t prev_hclk = HSI_VALUE;
+    uint64_t ns = 0;
+
+    for (int p = 0; p <= (int)phase; p++) {
+        if (!BOOTPROF_Reached((boot_phase_t)p)) {
+            continue;
+        }
+        // Each span is timed at the clock it started on
+        ns += (uint64_t)(marks[p].cycles - prev_cycles) * 1000U / (prev_hclk / 1000000U);
+        prev_cycles = marks[p].cycles;
+        prev_hclk = marks[p].hclk;
+    }
+    return (uint32_t)(ns / 1000U);
+}
+
+
+/*Phase-by-phase boot report*/
+void BOOTPROF_Dump(sched_print_t print) {
+    uint32_t prev = 0;
+    print("boot phase       delta_us   total_us\r\n");
+    for (int p = 0; p < BOOT_PHASES; p++) {
+        if (!BOOTPROF_Reached((boot_phase_t)p)) {
+            print("%-13s %11s %10s\r\n", phase_names[p], "-", "-");
+            continue;
+        }
+        uint32_t total = BOOTPROF_Us((boot_phase_t)p);
+        print("%-13s %11lu %10lu\r\n", phase_names[p],
+              (unsigned long)(total - prev), (unsigned long)total);
+        prev = total;
+    }
+}
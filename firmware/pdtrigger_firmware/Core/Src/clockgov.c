@@ -0,0 +1,105 @@
+#include "clockgov.h"
+#include <string.h>
+
+static clockgov_apply_t apply_fn;
+static sched_clock_t now_fn;
+static clk_state_t state;
+static uint32_t burst_until;    // stay high until this time
+static uint32_t entered;        // time the current state was entered
+static clockgov_stats_t stats;
+
+static const char *const state_names[CLK_STATES] = { "low", "high" };
+static const char *const reason_names[BURST_REASONS] = { "negotiation", "telemetry" };
+
+
+static bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+
+/*Account time in the current state and switch; stays put if apply fails*/
+static void switch_to(clk_state_t next, uint32_t now) {
+    if (next == state || apply_fn == NULL) {
+        return;
+    }
+    if (!apply_fn(next)) {
+        stats.failures++;
+        return;
+    }
+    stats.time_ms[state] += now - entered;
+    stats.switches++;
+    state = next;
+    entered = now;
+}
+
+
+/*Pure decision: next clock state for the given inputs*/
+clk_state_t CLOCKGOV_Decide(clk_state_t cur, uint32_t now, uint32_t until,
+                            uint32_t entered_high) {
+    if (time_before(now, until)) {
+        return CLK_HIGH;
+    }
+    if (cur == CLK_HIGH && time_before(now, entered_high + CLOCKGOV_MIN_HIGH_MS)) {
+        return CLK_HIGH;
+    }
+    return CLK_LOW;
+}
+
+
+void CLOCKGOV_Init(clockgov_apply_t apply, sched_clock_t clock, clk_state_t initial) {
+    apply_fn = apply;
+    now_fn = clock;
+    state = initial;
+    entered = clock();
+    burst_until = entered;
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+/*Ramp up now and hold the high clock for at least 'hold_ms'*/
+void CLOCKGOV_Request(burst_reason_t reason, uint32_t hold_ms) {
+    if (apply_fn == NULL) {
+        return;     // governor not in use (e.g. PDT_RTOS build)
+    }
+    uint32_t now = now_fn();
+    if (time_before(burst_until, now + hold_ms)) {
+        burst_until = now + hold_ms;
+    }
+    stats.bursts[reason]++;
+    switch_to(CLK_HIGH, now);
+}
+
+
+/*Re-evaluate; called from the idle path before sleeping*/
+void CLOCKGOV_Update(void) {
+    if (apply_fn == NULL) {
+        return;
+    }
+    uint32_t now = now_fn();
+    switch_to(CLOCKGOV_Decide(state, now, burst_until, entered), now);
+}
+
+
+clk_state_t CLOCKGOV_State(void) {
+    return state;
+}
+
+
+const clockgov_stats_t *CLOCKGOV_Stats(void) {
+    return &stats;
+}
+
+
+/*Print time spent in each clock state and the burst counters*/
+void CLOCKGOV_Dump(sched_print_t print) {
+    uint32_t now = now_fn();
+    print("clock: %s, %lu switches, %lu failed\r\n", state_names[state],
+          (unsigned long)stats.switches, (unsigned long)stats.failures);
+    for (int i = 0; i < CLK_STATES; i++) {
+        uint32_t t = stats.time_ms[i] + ((clk_state_t)i == state ? now - entered : 0);
+        print("  %-5s %lu ms\r\n", state_names[i], (unsigned long)t);
+    }
+    for (int i = 0; i < BURST_REASONS; i++) {
+        print("  burst %-12s %lu\r\n", reason_names[i], (unsigned long)stats.bursts[i]);
+    }
+}
@@ -0,0 +1,356 @@
+#include "cmd.h"
+#include "fmt.h"
+#include <stdarg.h>
+#include <string.h>
+
+#ifndef PDT_HOST
+#include "defer.h"
+extern UART_HandleTypeDef huart2;
+#endif
+
+#define RING_MASK       (CMD_RING_SIZE - 1)
+
+static uint8_t ring[CMD_RING_SIZE];
+static uint32_t head;               // written by the producer (RX event)
+static uint32_t tail;               // written by CMD_Poll
+static uint32_t lost_at;            // stream position of the first lost byte
+static bool lost;                   // lost_at is valid
+static char line[CMD_LINE_MAX];
+static uint8_t line_len;
+static const char *discard;         // why the line up to the next end is dropped
+static const cmd_t *commands;
+static uint8_t n_commands;
+static sched_print_t reply;
+static cmd_token_t current;         // request being dispatched
+static bool deferred;               // its handler called CMD_Defer
+static cmd_stats_t stats;
+
+static const char pending[] = "pending";
+
+
+/*Copy received bytes into the ring; returns how many fit*/
+uint16_t CMD_Feed(const uint8_t *buf, uint16_t len) {
+    uint32_t h = head;
+    uint32_t room = CMD_RING_SIZE - (h - __atomic_load_n(&tail, __ATOMIC_ACQUIRE));
+    uint16_t n = (len > room) ? (uint16_t)room : len;
+
+    for (uint16_t i = 0; i < n; i++) {
+        ring[(h + i) & RING_MASK] = buf[i];
+    }
+    if (n < len && !__atomic_load_n(&lost, __ATOMIC_ACQUIRE)) {
+        lost_at = h + n;
+        __atomic_store_n(&lost, true, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&head, h + n, __ATOMIC_RELEASE);
+    stats.bytes += len;
+    stats.overflows += len - n;
+    return n;
+}
+
+
+/*Bind the command table and where replies go*/
+void CMD_Init(const cmd_t *table, uint8_t count, sched_print_t print) {
+    commands = table;
+    n_commands = count;
+    reply = print;
+    head = tail = 0;
+    lost = false;
+    line_len = 0;
+    discard = NULL;
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+/*Decimal, or hex with 0x; the whole word must be a number that fits*/
+bool CMD_ParseU32(const char *s, uint32_t *out) {
+    uint32_t base = 10;
+    uint32_t v = 0;
+
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+    if (*s == '\0') {
+        return false;
+    }
+    for (; *s; s++) {
+        uint32_t d;
+        if (*s >= '0' && *s <= '9') {
+            d = (uint32_t)(*s - '0');
+        } else if (base == 16 && (*s | 0x20) >= 'a' && (*s | 0x20) <= 'f') {
+            d = (uint32_t)((*s | 0x20) - 'a' + 10);
+        } else {
+            return false;
+        }
+        if (v > (UINT32_MAX - d) / base) {
+            return false;
+        }
+        v = v * base + d;
+    }
+    *out = v;
+    return true;
+}
+
+
+/*Print on behalf of a request, also a deferred one: tagged ones get "#<id> | "*/
+void CMD_Vprintf(const cmd_token_t *token, const char *fmt, va_list args) {
+    char buf[96];
+
+    FMT_Vformat(buf, sizeof(buf), fmt, args);
+    if (token->tagged) {
+        reply("#%lu | %s", (unsigned long)token->id, buf);
+    } else {
+        reply("%s", buf);
+    }
+}
+
+
+/*Print on behalf of the request being run*/
+void CMD_Printf(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    CMD_Vprintf(&current, fmt, args);
+    va_end(args);
+}
+
+
+/*Final line of a request*/
+static void answer(const cmd_token_t *t, const char *err) {
+    char tag[16] = "";
+
+    if (t->tagged) {
+        FMT_Format(tag, sizeof(tag), "#%lu ", (unsigned long)t->id);
+    }
+    if (err != NULL) {
+        stats.rejected++;
+        reply("%serr %s\r\n", tag, err);
+    } else {
+        stats.lines++;
+        reply("%sok\r\n", tag);
+    }
+}
+
+
+/*From a handler: keep the reply for later. 'token' must outlive the
+  handler; the return value is the handler's own.*/
+const char *CMD_Defer(cmd_token_t *token) {
+    *token = current;
+    token->live = true;
+    deferred = true;
+    stats.deferred++;
+    return pending;
+}
+
+
+/*Send the reply owed to a deferred request; a spent token is ignored*/
+void CMD_Complete(cmd_token_t *token, const char *err) {
+    if (token->live) {
+        token->live = false;
+        answer(token, err);
+    }
+}
+
+
+static void help(void) {
+    for (uint8_t i = 0; i < n_commands; i++) {
+        CMD_Printf("%s %s\r\n", commands[i].name, commands[i].help);
+    }
+}
+
+
+/*"#<id>" at the start of the line, also for one that is being discarded*/
+static bool line_tag(uint32_t *id) {
+    char digits[11];
+    uint8_t n = 0;
+
+    if (line_len == 0 || line[0] != '#') {
+        return false;
+    }
+    while (n + 1U < line_len && n < sizeof(digits) - 1 && line[n + 1] >= '0' && line[n + 1] <= '9') {
+        digits[n] = line[n + 1];
+        n++;
+    }
+    digits[n] = '\0';
+    return (n + 1U == line_len || line[n + 1] == ' ' || line[n + 1] == '\t')
+           && CMD_ParseU32(digits, id);
+}
+
+
+static const cmd_t *find(const char *name) {
+    for (uint8_t i = 0; i < n_commands; i++) {
+        if (strcmp(name, commands[i].name) == 0) {
+            return &commands[i];
+        }
+    }
+    return NULL;
+}
+
+
+/*Split the line into words in place and run the command*/
+static void dispatch(void) {
+    char *words[CMD_ARGS_MAX + 3];
+    char **argv = words;
+    uint8_t argc = 0;
+    bool too_many = false;
+    const char *err = NULL;
+    char *p = line;
+
+    current.tagged = line_tag(&current.id);
+
+    line[line_len] = '\0';
+    for (;;) {
+        while (*p == ' ' || *p == '\t') {
+            *p++ = '\0';
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (argc == CMD_ARGS_MAX + 2) {
+            too_many = true;
+            break;
+        }
+        words[argc++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+    }
+    if (current.tagged) {
+        argv++;     // the tag
+        argc--;
+    } else if (argc == CMD_ARGS_MAX + 2) {
+        too_many = true;
+    }
+    if (argc == 0 && !current.tagged) {
+        return;
+    }
+    argv[argc] = NULL;
+
+    const cmd_t *cmd = NULL;
+    deferred = false;
+    if (line[0] == '#' && !current.tagged) {
+        err = "tag";
+    } else if (argc == 0) {
+        err = "arguments";
+    } else if ((cmd = find(argv[0])) == NULL) {
+        if (strcmp(argv[0], "help") == 0) {
+            help();
+        } else {
+            err = "unknown command";
+        }
+    } else if (too_many || argc - 1 < cmd->min_args || argc - 1 > cmd->max_args) {
+        err = "arguments";
+    } else {
+        err = cmd->fn(argc, argv);
+    }
+    if (!deferred) {
+        answer(&current, err);
+    }
+    current.tagged = false;
+}
+
+
+/*Where bytes were lost to a full ring, the line they belonged to can't be
+  trusted, nor can the one after it if its start was lost too*/
+static void check_lost(void) {
+    if (__atomic_load_n(&lost, __ATOMIC_ACQUIRE) && tail == lost_at) {
+        discard = "overflow";
+        __atomic_store_n(&lost, false, __ATOMIC_RELEASE);
+    }
+}
+
+
+/*Consume received bytes and run every complete line (task context)*/
+void CMD_Poll(void) {
+    uint32_t h = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+
+    check_lost();
+    while (tail != h) {
+        char c = (char)ring[tail & RING_MASK];
+        __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+
+        if (c == '\r' || c == '\n') {
+            if (discard != NULL) {
+                cmd_token_t t = { 0, false, true };
+                t.tagged = line_tag(&t.id);
+                answer(&t, discard);
+            } else if (line_len) {
+                dispatch();
+            }
+            line_len = 0;
+            discard = NULL;
+        } else if (line_len < CMD_LINE_MAX - 1) {
+            line[line_len++] = c;
+        } else {
+            discard = "too long";
+        }
+        check_lost();
+    }
+}
+
+
+const cmd_stats_t *CMD_Stats(void) {
+    return &stats;
+}
+
+
+void CMD_Dump(sched_print_t print) {
+    print("cmd rx: %lu bytes, %lu ok, %lu rejected, %lu deferred, %lu overflow, %lu uart errors\r\n",
+          (unsigned long)stats.bytes, (unsigned long)stats.lines,
+          (unsigned long)stats.rejected, (unsigned long)stats.deferred,
+          (unsigned long)stats.overflows, (unsigned long)stats.uart_errors);
+}
+
+
+#ifndef PDT_HOST
+static uint8_t rx_dma[CMD_RX_DMA];
+static uint16_t rx_pos;             // next byte of rx_dma not yet fed
+
+
+/*Bottom half of an RX event*/
+static void cmd_bh(uint32_t unused) {
+    SCHED_PostEvent(EVT_CMD);
+}
+
+
+/*Start circular reception; also after a UART re-init or error*/
+void CMD_RxStart(void) {
+    rx_pos = 0;
+    if (HAL_UARTEx_ReceiveToIdle_DMA(&huart2, rx_dma, sizeof(rx_dma)) != HAL_OK) {
+        stats.uart_errors++;
+    }
+}
+
+
+void CMD_RxStop(void) {
+    HAL_UART_AbortReceive(&huart2);
+}
+
+
+/*RX event (idle line, half or full buffer): 'pos' is the DMA write index*/
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t pos) {
+    if (huart != &huart2 || pos == rx_pos) {
+        return;
+    }
+    if (pos < rx_pos) {
+        // Wrapped without a full-buffer event in between
+        CMD_Feed(&rx_dma[rx_pos], sizeof(rx_dma) - rx_pos);
+        rx_pos = 0;
+    }
+    CMD_Feed(&rx_dma[rx_pos], pos - rx_pos);
+    rx_pos = (pos == sizeof(rx_dma)) ? 0 : pos;
+    if (!DEFER_Post(cmd_bh, 0)) {
+        cmd_bh(0);
+    }
+}
+
+
+/*Called from HAL_UART_ErrorCallback: HAL stops DMA reception on any RX
+  error (framing, noise, overrun), so start it again*/
+void CMD_RxError(UART_HandleTypeDef *huart) {
+    if (huart == &huart2 && huart->RxState == HAL_UART_STATE_READY) {
+        stats.uart_errors++;
+        CMD_RxStart();
+    }
+}
+#endif
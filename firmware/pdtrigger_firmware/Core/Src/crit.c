@@ -0,0 +1,46 @@
+#include "crit.h"
+#include <string.h>
+
+#ifndef PDT_HOST
+#include "main.h"
+#endif
+
+crit_stats_t crit_stats[CRIT_LEVELS];
+
+
+void CRIT_ResetStats(void) {
+    memset(crit_stats, 0, sizeof(crit_stats));
+}
+
+
+/*Worst time (cycles) an ISR at 'prio' has been held off: any section whose
+  ceiling is at or above it, PRIMASK included*/
+uint32_t CRIT_Blocking(uint8_t prio) {
+    uint32_t worst = 0;
+    for (uint8_t c = 0; c <= prio && c < CRIT_LEVELS; c++) {
+        if (crit_stats[c].max > worst) {
+            worst = crit_stats[c].max;
+        }
+    }
+    return worst;
+}
+
+
+/*Per-ceiling section stats and the resulting blocking per ISR tier*/
+void CRIT_Dump(sched_print_t print) {
+    print("critical sections (ceiling: count, max ns)\r\n");
+    for (uint8_t c = 0; c < CRIT_LEVELS; c++) {
+        if (crit_stats[c].count) {
+            print("  %2u%s %lu, %lu\r\n", c, c ? "" : " (PRIMASK)",
+                  (unsigned long)crit_stats[c].count,
+                  (unsigned long)TIMEBASE_CyclesToNs(crit_stats[c].max));
+        }
+    }
+#ifndef PDT_HOST
+    print("  worst blocking ns: pd_intr %lu, i2c %lu, button %lu, log %lu\r\n",
+          (unsigned long)TIMEBASE_CyclesToNs(CRIT_Blocking(PRIO_PD_INTR)),
+          (unsigned long)TIMEBASE_CyclesToNs(CRIT_Blocking(PRIO_I2C)),
+          (unsigned long)TIMEBASE_CyclesToNs(CRIT_Blocking(PRIO_BUTTON)),
+          (unsigned long)TIMEBASE_CyclesToNs(CRIT_Blocking(PRIO_LOG)));
+#endif
+}
@@ -1,9 +1,21 @@
 #include "cypd3177.h"
+#include "log.h"
 #include <string.h>
 #include <stdio.h>
 
+#ifdef PDT_RTOS
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#define CYPD_I2C_TIMEOUT_MS 50
+
+static SemaphoreHandle_t i2c_lock;  // one transfer at a time across tasks
+static SemaphoreHandle_t i2c_done;  // given by the transfer-complete ISR
+static volatile HAL_StatusTypeDef i2c_result;
+#endif
+
 extern I2C_HandleTypeDef hi2c3;
-extern UART_HandleTypeDef huart2;
 
 
 /*Swap 16-bit endian-ness*/
@@ -12,9 +24,82 @@ static uint16_t swap16(uint16_t x) {
 }
 
 
-/*Write to CYPD3177 over I2C*/
-HAL_StatusTypeDef CYPD3177_Write(uint16_t reg, uint8_t *data, uint16_t size) {
+#ifdef PDT_RTOS
+/*Create the bus lock and completion semaphore; call before the kernel starts*/
+void CYPD3177_RTOS_Init(void) {
+    i2c_lock = xSemaphoreCreateMutex();
+    i2c_done = xSemaphoreCreateBinary();
+}
+
+
+/*Before the kernel runs (boot fast path) transfers stay blocking*/
+static bool cypd_kernel_running(void) {
+    return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+
+/*Take the bus. A transfer that timed out may still have completed (or
+  errored) before its abort took effect; drop that completion so it is not
+  taken for this transfer's.*/
+static void cypd_acquire(void) {
+    xSemaphoreTake(i2c_lock, portMAX_DELAY);
+    xSemaphoreTake(i2c_done, 0);
+}
+
+
+/*Block the calling task until the interrupt-driven transfer finishes*/
+static HAL_StatusTypeDef cypd_wait(HAL_StatusTypeDef started) {
+    HAL_StatusTypeDef res = started;
+    if (started == HAL_OK) {
+        if (xSemaphoreTake(i2c_done, pdMS_TO_TICKS(CYPD_I2C_TIMEOUT_MS)) == pdPASS) {
+            res = i2c_result;
+        } else {
+            HAL_I2C_Master_Abort_IT(&hi2c3, CYPD3177_I2C_ADDR);
+            res = HAL_TIMEOUT;
+        }
+    }
+    xSemaphoreGive(i2c_lock);
+    return res;
+}
+
+
+static void cypd_complete_isr(HAL_StatusTypeDef res) {
+    BaseType_t woken = pdFALSE;
+    i2c_result = res;
+    xSemaphoreGiveFromISR(i2c_done, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    cypd_complete_isr(HAL_OK);
+}
+
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+    cypd_complete_isr(HAL_OK);
+}
+
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+    cypd_complete_isr(HAL_ERROR);
+}
+#endif
+
+
+static HAL_StatusTypeDef cypd_write(uint16_t reg, uint8_t *data, uint16_t size) {
     uint16_t reg_swapped = swap16(reg);
+#ifdef PDT_RTOS
+    if (cypd_kernel_running()) {
+        cypd_acquire();
+        return cypd_wait(HAL_I2C_Mem_Write_IT(&hi2c3,
+                                              (CYPD3177_I2C_ADDR),
+                                              reg_swapped,
+                                              I2C_MEMADD_SIZE_16BIT,
+                                              data,
+                                              size));
+    }
+#endif
     return HAL_I2C_Mem_Write(&hi2c3,
                              (CYPD3177_I2C_ADDR),
                              reg_swapped,
@@ -25,9 +110,19 @@ HAL_StatusTypeDef CYPD3177_Write(uint16_t reg, uint8_t *data, uint16_t size) {
 }
 
 
-/*Read from CYPD3177 over I2C*/
-HAL_StatusTypeDef CYPD3177_Read(uint16_t reg, uint8_t *data, uint16_t size) {
+static HAL_StatusTypeDef cypd_read(uint16_t reg, uint8_t *data, uint16_t size) {
     uint16_t reg_swapped = swap16(reg);
+#ifdef PDT_RTOS
+    if (cypd_kernel_running()) {
+        cypd_acquire();
+        return cypd_wait(HAL_I2C_Mem_Read_IT(&hi2c3,
+                                             (CYPD3177_I2C_ADDR),
+                                             reg_swapped,
+                                             I2C_MEMADD_SIZE_16BIT,
+                                             data,
+                                             size));
+    }
+#endif
     return HAL_I2C_Mem_Read(&hi2c3,
                             (CYPD3177_I2C_ADDR),
                             reg_swapped,
@@ -38,6 +133,32 @@ HAL_StatusTypeDef CYPD3177_Read(uint16_t reg, uint8_t *data, uint16_t size) {
 }
 
 
+/*Failures always, every transfer at trace level (first data byte only)*/
+static void cypd_trace(char dir, uint16_t reg, const uint8_t *data, uint16_t size,
+                       HAL_StatusTypeDef res) {
+    if (res != HAL_OK) {
+        LOG_WARN(I2C, "i2c %c %04X failed (%u)\r\n", dir, reg, res);
+        return;
+    }
+    LOG_TRACE(I2C, "i2c %c %04X n=%u %02X\r\n", dir, reg, size, size ? data[0] : 0);
+}
+
+
+/*Write to CYPD3177 over I2C*/
+HAL_StatusTypeDef CYPD3177_Write(uint16_t reg, uint8_t *data, uint16_t size) {
+    HAL_StatusTypeDef res = cypd_write(reg, data, size);
+    cypd_trace('w', reg, data, size, res);
+    return res;
+}
+
+
+/*Read from CYPD3177 over I2C*/
+HAL_StatusTypeDef CYPD3177_Read(uint16_t reg, uint8_t *data, uint16_t size) {
+    HAL_StatusTypeDef res = cypd_read(reg, data, size);
+    cypd_trace('r', reg, data, size, res);
+    return res;
+}
+
 /*Check if CYPD3177 device is responsive*/
 HAL_StatusTypeDef CYPD3177_Online(bool *is_active)
 {
@@ -115,6 +236,17 @@ HAL_StatusTypeDef CYPD3177_PD_Status_Read(cypd3177_pd_status_t *status) {
 }
 
 
+/*Read the source PDO selected in the current contract*/
+HAL_StatusTypeDef CYPD3177_Current_PDO_Read(uint32_t *pdo) {
+    uint8_t buf[4] = {0};
+    HAL_StatusTypeDef res = CYPD3177_Read(CYPD_CURRENT_PDO_REG, buf, 4);
+    if (res == HAL_OK) {
+        *pdo = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+    }
+    return res;
+}
+
+
 
 /*Change CYPD3177 PDOs*/
 HAL_StatusTypeDef CYPD3177_ChangePDO(uint32_t *pdo) {
@@ -137,3 +269,31 @@ HAL_StatusTypeDef CYPD3177_ChangePDO(uint32_t *pdo) {
     return HAL_OK;
 }
 
+
+/*After an MCU-only reset the controller may still hold a contract. Returns
+  its index in 'pdos' if it is a fixed supply found there and VBUS is
+  already within 5% of it, else -1 (negotiate). VBUS goes to 'vbus_mv'.*/
+int CYPD3177_LiveContract(const uint32_t *pdos, uint8_t count, uint16_t *vbus_mv) {
+    cypd3177_pd_status_t pd;
+    uint32_t pdo;
+
+    if (CYPD3177_PD_Status_Read(&pd) != HAL_OK || !pd.explicit_contract ||
+        CYPD3177_Current_PDO_Read(&pdo) != HAL_OK || !PDO_FIXED(pdo)) {
+        return -1;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        if (PDO_MV(pdos[i]) != PDO_MV(pdo)) {
+            continue;
+        }
+        uint16_t target = PDO_MV(pdo);
+        uint16_t tol = target / 20;
+        uint16_t vbus = 0;
+        if (CYPD3177_VBUS_mV(&vbus) != HAL_OK ||
+            vbus + tol < target || vbus > target + tol) {
+            return -1;      // contract still settling
+        }
+        *vbus_mv = vbus;
+        return i;
+    }
+    return -1;
+}
@@ -0,0 +1,71 @@
+#include "defer.h"
+#include "evq.h"
+
+#if defined(PDT_HOST)
+// Host builds drain explicitly
+#elif defined(PDT_RTOS)
+#include "app_rtos.h"
+#else
+#include "main.h"
+#endif
+
+typedef struct {
+    defer_fn_t fn;
+    uint32_t arg;
+} defer_item_t;
+
+EVQ_DEFINE(work, defer_item_t, DEFER_DEPTH);
+static uint32_t ran;
+
+
+/*Get the consumer to run*/
+static void kick(void) {
+#if defined(PDT_HOST)
+#elif defined(PDT_RTOS)
+    APP_RTOS_WakeFromISR();
+#else
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+#endif
+}
+
+
+/*Empty the queue; PendSV runs at the lowest priority (PRIO_DEFER)*/
+void DEFER_Init(void) {
+    EVQ_Init(&work);
+    ran = 0;
+#if !defined(PDT_HOST) && !defined(PDT_RTOS)
+    HAL_NVIC_SetPriority(PendSV_IRQn, PRIO_DEFER, 0);
+#endif
+}
+
+
+/*Queue fn(arg) for the bottom half. Returns false (and counts a drop) when full.*/
+bool DEFER_Post(defer_fn_t fn, uint32_t arg) {
+    defer_item_t item = { fn, arg };
+    if (!EVQ_Post(&work, &item)) {
+        return false;
+    }
+    kick();
+    return true;
+}
+
+
+/*Run queued items in order; stops at a slot still being filled*/
+void DEFER_Run(void) {
+    defer_item_t item;
+    while (EVQ_Get(&work, &item)) {
+        item.fn(item.arg);
+        ran++;
+    }
+}
+
+
+uint32_t DEFER_Dropped(void) {
+    return work.stats.overflows;
+}
+
+
+void DEFER_Dump(sched_print_t print) {
+    EVQ_Dump(&work, "defer", print);
+    print("  ran %lu\r\n", (unsigned long)ran);
+}
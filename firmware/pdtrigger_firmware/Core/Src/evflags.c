@@ -0,0 +1,40 @@
+#include "evflags.h"
+
+#ifdef PDT_RTOS
+#include "app_rtos.h"
+#endif
+
+
+void EVFLAGS_Init(evflags_t *g, uint32_t sched_event) {
+    __atomic_store_n(&g->flags, 0, __ATOMIC_RELAXED);
+    g->event = sched_event;
+}
+
+
+/*Set bits; wakes waiters if any of them was clear. Returns the old flags.*/
+uint32_t EVFLAGS_Set(evflags_t *g, uint32_t mask) {
+    uint32_t old = __atomic_fetch_or(&g->flags, mask, __ATOMIC_RELEASE);
+    if ((old & mask) != mask) {
+        SCHED_PostEvent(g->event);
+#ifdef PDT_RTOS
+        APP_RTOS_Wake();    // setter may be another task or an ISR
+#endif
+    }
+    return old;
+}
+
+
+/*Clear bits. Nobody waits for a bit to drop, so no wakeup. Returns the old flags.*/
+uint32_t EVFLAGS_Clear(evflags_t *g, uint32_t mask) {
+    return __atomic_fetch_and(&g->flags, ~mask, __ATOMIC_RELEASE);
+}
+
+
+/*Set or clear bits from a condition*/
+void EVFLAGS_Put(evflags_t *g, uint32_t mask, bool on) {
+    if (on) {
+        EVFLAGS_Set(g, mask);
+    } else {
+        EVFLAGS_Clear(g, mask);
+    }
+}
@@ -0,0 +1,113 @@
+#include "evq.h"
+#include <string.h>
+
+#ifdef PDT_HOST
+
+#define LOAD_ACQ(p)         atomic_load_explicit((p), memory_order_acquire)
+#define LOAD_RLX(p)         atomic_load_explicit((p), memory_order_relaxed)
+#define STORE_REL(p, v)     atomic_store_explicit((p), (v), memory_order_release)
+#define STORE_RLX(p, v)     atomic_store_explicit((p), (v), memory_order_relaxed)
+#define ADD_RLX(p, v)       ((void)__atomic_fetch_add((p), (v), __ATOMIC_RELAXED))
+
+/*Claim position 'pos' if the head still holds it*/
+static inline bool claim(evq_word_t *head, uint32_t *pos) {
+    return atomic_compare_exchange_weak_explicit(head, pos, *pos + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed);
+}
+
+#else
+
+#include "main.h"
+
+// Single core: volatile accesses plus a DMB where ordering matters
+#define LOAD_ACQ(p)         ({ uint32_t v_ = *(p); __DMB(); v_; })
+#define LOAD_RLX(p)         (*(p))
+#define STORE_REL(p, v)     do { __DMB(); *(p) = (v); } while (0)
+#define STORE_RLX(p, v)     (*(p) = (v))
+#define ADD_RLX(p, v)       ((void)__atomic_fetch_add((p), (v), __ATOMIC_RELAXED))
+
+/*Claim position 'pos' if the head still holds it (LDREX/STREX)*/
+static inline bool claim(evq_word_t *head, uint32_t *pos) {
+    uint32_t cur = __LDREXW(head);
+    if (cur != *pos) {
+        __CLREX();
+        *pos = cur;
+        return false;
+    }
+    return __STREXW(cur + 1, head) == 0;
+}
+
+#endif
+
+
+/*Mark every slot free for the first lap*/
+void EVQ_Init(evq_t *q) {
+    for (uint32_t i = 0; i <= q->mask; i++) {
+        STORE_RLX(&q->seq[i], i);
+    }
+    STORE_RLX(&q->head, 0);
+    STORE_RLX(&q->tail, 0);
+    memset(&q->stats, 0, sizeof(q->stats));
+}
+
+
+/*Copy 'rec' into the queue. Returns false (and counts an overflow) when full.*/
+bool EVQ_Post(evq_t *q, const void *rec) {
+    uint32_t pos = LOAD_RLX(&q->head);
+    uint32_t slot;
+
+    for (;;) {
+        slot = pos & q->mask;
+        int32_t dif = (int32_t)(LOAD_ACQ(&q->seq[slot]) - pos);
+        if (dif == 0) {
+            if (claim(&q->head, &pos)) {
+                break;
+            }
+        } else if (dif < 0) {
+            ADD_RLX(&q->stats.overflows, 1);
+            return false;
+        } else {
+            pos = LOAD_RLX(&q->head);   // another producer got there first
+        }
+    }
+
+    memcpy(&q->data[slot * q->size], rec, q->size);
+    STORE_REL(&q->seq[slot], pos + 1);
+
+    ADD_RLX(&q->stats.posted, 1);
+    uint32_t depth = pos + 1 - LOAD_RLX(&q->tail);
+    if (depth > __atomic_load_n(&q->stats.depth_max, __ATOMIC_RELAXED)) {
+        // Racy maximum, statistics only; atomic so the host stress is clean
+        __atomic_store_n(&q->stats.depth_max, depth, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+
+/*Take the oldest published record. Returns false if there is none (yet).*/
+bool EVQ_Get(evq_t *q, void *rec) {
+    uint32_t pos = LOAD_RLX(&q->tail);
+    uint32_t slot = pos & q->mask;
+
+    if ((int32_t)(LOAD_ACQ(&q->seq[slot]) - (pos + 1)) < 0) {
+        return false;
+    }
+    memcpy(rec, &q->data[slot * q->size], q->size);
+    // Free the slot for the producers' next lap
+    STORE_REL(&q->seq[slot], pos + q->mask + 1);
+    STORE_RLX(&q->tail, pos + 1);
+    return true;
+}
+
+
+uint32_t EVQ_Depth(const evq_t *q) {
+    return LOAD_RLX(&q->head) - LOAD_RLX(&q->tail);
+}
+
+
+void EVQ_Dump(const evq_t *q, const char *name, sched_print_t print) {
+    print("%s: posted %lu, overflows %lu, depth max %lu/%u\r\n", name,
+          (unsigned long)q->stats.posted, (unsigned long)q->stats.overflows,
+          (unsigned long)q->stats.depth_max, q->mask + 1);
+}
@@ -0,0 +1,192 @@
+#include "fmt.h"
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct {
+    char *p;
+    char *end;          // last byte, kept for the terminator
+} fmt_out_t;
+
+static const char lower[] = "0123456789abcdef";
+static const char upper[] = "0123456789ABCDEF";
+
+
+static void put(fmt_out_t *o, char c) {
+    if (o->p < o->end) {
+        *o->p++ = c;
+    }
+}
+
+
+static void fill(fmt_out_t *o, char c, uint8_t n) {
+    while (n--) {
+        put(o, c);
+    }
+}
+
+
+/*Digits of v, written backwards ending at 'end'; returns the first*/
+static char *digits(char *end, uint32_t v, uint32_t base, const char *set) {
+    do {
+        *--end = set[v % base];
+        v /= base;
+    } while (v);
+    return end;
+}
+
+
+/*One converted field, padded to 'width'. Zeros go after a sign.*/
+static void field(fmt_out_t *o, const char *s, size_t len, uint8_t width, bool left, bool zero) {
+    uint8_t pad = (len < width) ? (uint8_t)(width - len) : 0;
+
+    if (left) {
+        while (len--) {
+            put(o, *s++);
+        }
+        fill(o, ' ', pad);
+        return;
+    }
+    if (zero && len && *s == '-') {
+        put(o, *s++);
+        len--;
+    }
+    fill(o, zero ? '0' : ' ', pad);
+    while (len--) {
+        put(o, *s++);
+    }
+}
+
+
+/*See fmt.h for what is understood*/
+size_t FMT_Vformat(char *buf, size_t size, const char *fmt, va_list args) {
+    static const uint16_t unit[4] = { 1000, 100, 10, 1 };    // mV per last %V digit
+    fmt_out_t o;
+    char num[16];           // "-2147483648", or "4294967.295" for %V
+    char *const num_end = num + sizeof(num);
+
+    if (size == 0) {
+        return 0;
+    }
+    o.p = buf;
+    o.end = buf + size - 1;
+
+    while (*fmt) {
+        if (*fmt != '%') {
+            put(&o, *fmt++);
+            continue;
+        }
+        const char *spec = fmt++;
+        bool left = false, zero = false, lng = false;
+        uint32_t width = 0;
+        int32_t prec = -1;
+
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                left = true;
+            } else if (*fmt == '0') {
+                zero = true;
+            } else {
+                break;
+            }
+        }
+        while (*fmt >= '0' && *fmt <= '9') {
+            width = width * 10 + (uint32_t)(*fmt++ - '0');
+            if (width > FMT_WIDTH_MAX) {
+                width = FMT_WIDTH_MAX;
+            }
+        }
+        if (*fmt == '.') {
+            prec = 0;
+            while (*++fmt >= '0' && *fmt <= '9') {
+                prec = (prec < 100) ? prec * 10 + (*fmt - '0') : prec;
+            }
+        }
+        while (*fmt == 'l' || *fmt == 'h') {
+            lng |= (*fmt++ == 'l');
+        }
+
+        const char *s = num_end;
+        size_t len;
+        uint32_t u;
+        switch (*fmt) {
+        case 'd':
+        case 'i': {
+            int32_t v = lng ? (int32_t)va_arg(args, long) : (int32_t)va_arg(args, int);
+            u = (v < 0) ? 0U - (uint32_t)v : (uint32_t)v;
+            char *d = digits(num_end, u, 10, lower);
+            if (v < 0) {
+                *--d = '-';
+            }
+            s = d;
+            break;
+        }
+        case 'u':
+        case 'x':
+        case 'X':
+            u = lng ? (uint32_t)va_arg(args, unsigned long) : va_arg(args, unsigned int);
+            s = digits(num_end, u, (*fmt == 'u') ? 10 : 16, (*fmt == 'X') ? upper : lower);
+            break;
+        case 'V': {
+            uint32_t p = (prec < 0 || prec > 3) ? 3 : (uint32_t)prec;
+            u = lng ? (uint32_t)va_arg(args, unsigned long) : va_arg(args, unsigned int);
+            uint32_t q = u / unit[p] + ((u % unit[p]) >= unit[p] / 2U && p < 3);
+            char *d = num_end;
+            for (uint32_t i = 0; i < p; i++) {
+                *--d = (char)('0' + q % 10);
+                q /= 10;
+            }
+            if (p) {
+                *--d = '.';
+            }
+            s = digits(d, q, 10, lower);
+            zero = false;
+            break;
+        }
+        case 'c':
+            num[0] = (char)va_arg(args, int);
+            s = num;
+            field(&o, s, 1, (uint8_t)width, left, false);
+            fmt++;
+            continue;
+        case 's':
+            s = va_arg(args, const char *);
+            if (s == NULL) {
+                s = "(null)";
+            }
+            len = strlen(s);
+            if (prec >= 0 && len > (size_t)prec) {
+                len = (size_t)prec;
+            }
+            field(&o, s, len, (uint8_t)width, left, false);
+            fmt++;
+            continue;
+        case '%':
+            put(&o, '%');
+            fmt++;
+            continue;
+        default:
+            // Not ours: copy it through as written
+            while (spec < fmt) {
+                put(&o, *spec++);
+            }
+            if (*fmt) {
+                put(&o, *fmt++);
+            }
+            continue;
+        }
+        field(&o, s, (size_t)(num_end - s), (uint8_t)width, left, zero && !left);
+        fmt++;
+    }
+    *o.p = '\0';
+    return (size_t)(o.p - buf);
+}
+
+
+size_t FMT_Format(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    size_t n = FMT_Vformat(buf, size, fmt, args);
+    va_end(args);
+    return n;
+}
@@ -0,0 +1,100 @@
+#include "isrstat.h"
+#include "crit.h"
+
+isr_hist_t isr_hist[ISR_SOURCES];
+
+#ifdef PDT_HOST
+#define SRC_CEILING(prio)   1
+#define TICK_CEILING()      1
+#else
+#define SRC_CEILING(prio)   (prio)
+// Set by HAL_InitTick, which PDT_ISR_ONLY calls again with PRIO_TICK_ISR
+// and the RTOS port overrides; read back rather than assumed
+#define TICK_CEILING()      ((uint8_t)NVIC_GetPriority(SysTick_IRQn))
+#endif
+
+// Masking each source's own tier is enough for a consistent snapshot
+static const uint8_t src_ceiling[ISR_SOURCES] = {
+    [ISR_PD_INTR] = SRC_CEILING(PRIO_PD_INTR),
+    [ISR_BUTTON]  = SRC_CEILING(PRIO_BUTTON),
+    [ISR_I2C3_EV] = SRC_CEILING(PRIO_I2C),
+    [ISR_I2C3_ER] = SRC_CEILING(PRIO_I2C),
+    [ISR_UART_TX] = SRC_CEILING(PRIO_LOG),
+    [ISR_UART_RX] = SRC_CEILING(PRIO_LOG),
+    [ISR_UART]    = SRC_CEILING(PRIO_LOG),
+    [ISR_PENDSV]  = SRC_CEILING(PRIO_DEFER),
+    [ISR_PD_PATH] = 0,  // written from task context
+};
+
+static const char *const src_names[ISR_SOURCES] = {
+    "systick", "pd_intr", "button", "i2c3_ev", "i2c3_er", "uart_tx", "uart_rx", "uart",
+    "pendsv", "pd_path"
+};
+
+
+/*Ask every source to clear its histograms on its next sample*/
+void ISRSTAT_Reset(void) {
+    for (int i = 0; i < ISR_SOURCES; i++) {
+        isr_hist[i].reset_req = 1;
+    }
+}
+
+
+static void dump_row(sched_print_t print, const char *what, const uint32_t *b) {
+    // One bucket per column, counts above 9999 saturate the column
+    char line[ISRSTAT_BUCKETS * 5 + 1];
+    char *p = line;
+    for (int i = 0; i < ISRSTAT_BUCKETS; i++) {
+        uint32_t n = (b[i] > 9999) ? 9999 : b[i];
+        p[0] = ' ';
+        p[1] = (n >= 1000) ? '0' + (n / 1000) : ' ';
+        p[2] = (n >= 100) ? '0' + (n / 100) % 10 : ' ';
+        p[3] = (n >= 10) ? '0' + (n / 10) % 10 : ' ';
+        p[4] = (n > 0) ? '0' + n % 10 : '.';
+        p += 5;
+    }
+    *p = '\0';
+    print("  %s%s\r\n", what, line);
+}
+
+
+/*Print one source's histograms; the first one comes with the legend*/
+void ISRSTAT_DumpSource(sched_print_t print, isr_src_t src) {
+    static isr_hist_t snap;     // too big for the caller's stack
+    const isr_hist_t *h = &snap;
+
+    if (src == 0) {
+        print("isr histograms, bucket n = [2^(n+4), 2^(n+5)) cycles\r\n");
+    }
+    uint8_t ceiling = (src == ISR_SYSTICK) ? TICK_CEILING() : src_ceiling[src];
+    if (ceiling) {
+        crit_t c;
+        CRIT_Enter(&c, ceiling);
+        snap = isr_hist[src];
+        CRIT_Exit(&c);
+    } else {
+        snap = isr_hist[src];
+    }
+    if (h->reset_req || (h->count == 0 && h->lat_count == 0)) {
+        print("%-8s no samples\r\n", src_names[src]);
+        return;
+    }
+    print("%-8s n %lu/%lu, dur max %lu ns, lat max %lu ns\r\n", src_names[src],
+          (unsigned long)h->count, (unsigned long)h->lat_count,
+          (unsigned long)TIMEBASE_CyclesToNs(h->dur_max),
+          (unsigned long)TIMEBASE_CyclesToNs(h->lat_max));
+    if (h->count) {
+        dump_row(print, "dur", h->dur);
+    }
+    if (h->lat_count) {
+        dump_row(print, "lat", h->lat);
+    }
+}
+
+
+/*Print latency/duration histograms (cycles, log2 buckets) per source*/
+void ISRSTAT_Dump(sched_print_t print) {
+    for (int i = 0; i < ISR_SOURCES; i++) {
+        ISRSTAT_DumpSource(print, (isr_src_t)i);
+    }
+}
@@ -0,0 +1,244 @@
+#include "link.h"
+#include "cmd.h"
+#include "uarttx.h"
+#include "log.h"
+#include <string.h>
+
+#ifdef PDT_HOST
+#define link_pclk()     42000000U       // PLL build, APB1 /2
+#else
+#include "main.h"
+#define link_pclk()     HAL_RCC_GetPCLK1Freq()
+extern UART_HandleTypeDef huart2;
+#endif
+
+static link_apply_t apply;
+static sched_clock_t now;
+static link_state_t state;
+static uint32_t baud = LINK_BASE_BAUD;
+static uint32_t pending;            // rate the host asked for
+static uint32_t since;              // ms, start of the confirm or error window
+static uint32_t lines0;             // CMD lines dispatched before the switch
+static uint32_t bytes0;             // CMD bytes at the start of the window
+static uint32_t errors0;
+static volatile uint32_t rx_errors;
+static link_stats_t stats;
+
+static const char *const state_names[] = { "base", "switching", "confirming", "fast" };
+
+
+void LINK_Init(link_apply_t fn, sched_clock_t clock) {
+    apply = fn;
+    now = clock;
+    state = LINK_BASE;
+    baud = LINK_BASE_BAUD;
+    rx_errors = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+/*BRR for 'rate' from 'pclk', or 0 if out of reach or off by more than
+  LINK_TOL_PPM. *over8 tells which oversampling the value is for.*/
+uint16_t LINK_Brr(uint32_t pclk, uint32_t rate, bool *over8) {
+    if (rate == 0) {
+        return 0;
+    }
+    // USARTDIV in 1/16 steps (OVER8=0) or 1/8 steps (OVER8=1) is pclk/rate either way
+    uint32_t div = (pclk + rate / 2) / rate;
+    uint16_t brr;
+
+    if (div > 0xFFFF) {
+        return 0;
+    } else if (div >= 16) {
+        *over8 = false;
+        brr = (uint16_t)div;
+    } else if (div >= 8) {
+        *over8 = true;
+        brr = (uint16_t)(((div & ~7U) << 1) | (div & 7U));   // DIV_Fraction[3] stays 0
+    } else {
+        return 0;
+    }
+
+    uint32_t actual = pclk / div;
+    uint32_t off = (actual > rate) ? actual - rate : rate - actual;
+    if ((uint64_t)off * 1000000U > (uint64_t)rate * LINK_TOL_PPM) {
+        return 0;
+    }
+    return brr;
+}
+
+
+/*Change rate with TX drained and RX stopped; stays on the old rate if
+  the new one can't be programmed*/
+static bool switch_to(uint32_t rate) {
+    bool ok;
+
+    UARTTX_Flush();         // whatever was said at the old rate goes out at it
+    UARTTX_Suspend();
+#ifndef PDT_HOST
+    CMD_RxStop();
+#endif
+    ok = apply(rate);
+    if (ok) {
+        baud = rate;
+    } else {
+        apply(baud);
+    }
+#ifndef PDT_HOST
+    CMD_RxStart();
+#endif
+    UARTTX_Resume();
+    return ok;
+}
+
+
+static void open_window(void) {
+    since = now();
+    bytes0 = CMD_Stats()->bytes;
+    errors0 = rx_errors;
+}
+
+
+static void fall_back(void) {
+    switch_to(LINK_BASE_BAUD);
+    state = LINK_BASE;
+}
+
+
+/*"baud <rate>": checked against the clock as it is now; the switch itself
+  waits LINK_SWITCH_MS for the reply, then LINK_Poll does it*/
+const char *LINK_Request(uint32_t rate) {
+    bool over8;
+
+    if (rate < LINK_BASE_BAUD || rate > LINK_MAX_BAUD) {
+        return "range";
+    }
+    if (LINK_Brr(link_pclk(), rate, &over8) == 0) {
+        return "clock";
+    }
+    pending = rate;
+    state = LINK_SWITCHING;
+    stats.switches++;
+    return NULL;
+}
+
+
+/*Advance the negotiation; returns ms until the next call, 0 when idle*/
+uint32_t LINK_Poll(void) {
+    switch (state) {
+    case LINK_SWITCHING:
+        lines0 = CMD_Stats()->lines;
+        if (!switch_to(pending)) {
+            state = LINK_BASE;
+            return 0;
+        }
+        if (baud == LINK_BASE_BAUD) {
+            state = LINK_BASE;      // asked for the base rate: nothing to confirm
+            return 0;
+        }
+        state = LINK_CONFIRMING;
+        open_window();
+        return LINK_CONFIRM_POLL_MS;
+
+    case LINK_CONFIRMING:
+        if (CMD_Stats()->lines != lines0) {
+            stats.confirmed++;
+            state = LINK_FAST;
+            LOG_INFO(SYS, "baud %lu\r\n", (unsigned long)baud);
+            open_window();
+            return LINK_CHECK_MS;
+        }
+        if (now() - since >= LINK_CONFIRM_MS) {
+            stats.timeouts++;
+            fall_back();
+            LOG_WARN(SYS, "baud: not confirmed, back to %lu\r\n", (unsigned long)baud);
+            return 0;
+        }
+        return LINK_CONFIRM_POLL_MS;
+
+    case LINK_FAST: {
+        uint32_t errors = rx_errors - errors0;
+        uint32_t bytes = CMD_Stats()->bytes - bytes0;
+        if (errors >= LINK_ERR_MIN && errors * LINK_ERR_RATIO >= bytes) {
+            stats.fallbacks++;
+            fall_back();
+            LOG_WARN(SYS, "baud: %lu rx errors, back to %lu\r\n",
+                     (unsigned long)errors, (unsigned long)baud);
+            return 0;
+        }
+        open_window();
+        return LINK_CHECK_MS;
+    }
+
+    default:
+        return 0;
+    }
+}
+
+
+/*After a clock switch, with TX suspended and RX stopped by the caller*/
+void LINK_Reclock(void) {
+    if (apply(baud)) {
+        return;
+    }
+    stats.fallbacks++;
+    baud = LINK_BASE_BAUD;
+    apply(baud);
+    if (state != LINK_SWITCHING) {
+        state = LINK_BASE;
+    }
+}
+
+
+/*A framing or noise error on RX*/
+void LINK_RxError(void) {
+    rx_errors++;
+}
+
+
+uint32_t LINK_Baud(void) {
+    return baud;
+}
+
+
+link_state_t LINK_State(void) {
+    return state;
+}
+
+
+const link_stats_t *LINK_Stats(void) {
+    stats.rx_errors = rx_errors;
+    return &stats;
+}
+
+
+void LINK_Dump(sched_print_t print) {
+    const link_stats_t *s = LINK_Stats();
+    print("link %lu baud (%s): %lu switches, %lu confirmed, %lu timeouts, %lu fallbacks, %lu rx errors\r\n",
+          (unsigned long)baud, state_names[state], (unsigned long)s->switches,
+          (unsigned long)s->confirmed, (unsigned long)s->timeouts,
+          (unsigned long)s->fallbacks, (unsigned long)s->rx_errors);
+}
+
+
+#ifndef PDT_HOST
+/*Program USART2 from the current PCLK1. HAL_UART_Init sets up the frame
+  and OVER8; the BRR it computes is then replaced by LINK_Brr's.*/
+bool LINK_UartApply(uint32_t rate) {
+    bool over8;
+    uint16_t brr = LINK_Brr(HAL_RCC_GetPCLK1Freq(), rate, &over8);
+
+    if (brr == 0) {
+        return false;
+    }
+    huart2.Init.BaudRate = rate;
+    huart2.Init.OverSampling = over8 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+    if (HAL_UART_Init(&huart2) != HAL_OK) {
+        return false;
+    }
+    __HAL_UART_DISABLE(&huart2);
+    huart2.Instance->BRR = brr;
+    __HAL_UART_ENABLE(&huart2);
+    return true;
+}
+#endif
@@ -0,0 +1,105 @@
+#include "log.h"
+#include "main.h"
+#include "app_rtos.h"
+#include "uarttx.h"
+#include "blog.h"
+#include "tlm.h"
+#include "fmt.h"
+#include <stdarg.h>
+#include <string.h>
+
+#define LOG_LINE_MAX    128
+
+extern UART_HandleTypeDef huart2;
+
+static const uint8_t compiled[LOG_MODULES] = {
+    LOG_LEVEL_SYS, LOG_LEVEL_PD, LOG_LEVEL_PDO, LOG_LEVEL_I2C
+};
+
+// Runtime levels; I2C tracing is compiled into debug builds but starts quiet
+uint8_t log_level[LOG_MODULES] = {
+    LOG_LEVEL_SYS, LOG_LEVEL_PD, LOG_LEVEL_PDO,
+    (LOG_LEVEL_I2C < LOG_LVL_WARN) ? LOG_LEVEL_I2C : LOG_LVL_WARN
+};
+
+static const char *const module_names[LOG_MODULES] = { "sys", "pd", "pdo", "i2c" };
+static const char *const level_names[] = { "off", "error", "warn", "info", "debug", "trace" };
+
+
+/*Format and queue one line of text*/
+void LOG_Printf(const char *fmt, ...) {
+    char buf[LOG_LINE_MAX];
+    va_list args;
+
+    if (huart2.gState == HAL_UART_STATE_RESET) {
+        return;     // boot fast path: UART not brought up yet
+    }
+    va_start(args, fmt);
+    uint16_t len = (uint16_t)FMT_Vformat(buf, sizeof(buf), fmt, args);
+    va_end(args);
+#if defined(PDT_BLOG)
+    BLOG_Text(buf, len);
+#elif defined(PDT_TLM)
+    TLM_Text(buf, len);
+#elif defined(PDT_RTOS)
+    APP_RTOS_Log(buf, len);
+#else
+    UARTTX_Write(buf, len);
+#endif
+}
+
+
+/*Set a module's runtime level, clamped to what was compiled in; returns it*/
+uint8_t LOG_SetLevel(log_module_t mod, uint8_t level) {
+    if (mod >= LOG_MODULES) {
+        return LOG_LVL_OFF;
+    }
+    log_level[mod] = (level > compiled[mod]) ? compiled[mod] : level;
+    return log_level[mod];
+}
+
+
+uint8_t LOG_Compiled(log_module_t mod) {
+    return (mod < LOG_MODULES) ? compiled[mod] : LOG_LVL_OFF;
+}
+
+
+/*Module index for a name as printed by LOG_Dump, or -1*/
+int LOG_ModuleByName(const char *name) {
+    for (int i = 0; i < LOG_MODULES; i++) {
+        if (strcmp(name, module_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/*Level for a name ("warn") or a digit ("2"), or -1*/
+int LOG_LevelByName(const char *name) {
+    if (name[0] >= '0' && name[0] <= '0' + LOG_LVL_TRACE && name[1] == '\0') {
+        return name[0] - '0';
+    }
+    for (int i = 0; i <= LOG_LVL_TRACE; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+const char *LOG_LevelName(uint8_t level) {
+    return (level <= LOG_LVL_TRACE) ? level_names[level] : "?";
+}
+
+
+/*Print runtime and compiled level per module*/
+void LOG_Dump(sched_print_t print) {
+    print("log levels (runtime/compiled):");
+    for (int i = 0; i < LOG_MODULES; i++) {
+        print(" %s %s/%s", module_names[i], level_names[log_level[i]],
+              level_names[compiled[i]]);
+    }
+    print("\r\n");
+}
@@ -0,0 +1,189 @@
+#include "lowpower.h"
+#include <string.h>
+
+#ifndef PDT_HOST
+#include "crit.h"
+#include "timebase.h"
+
+#define EXTI_PD_INTR    (1UL << 11)
+#define EXTI_BUTTON     (1UL << 7)
+
+static uint32_t tick_reload;        // SysTick LOAD for one HAL tick
+static uint32_t max_sleep_ticks;    // longest stretch the 24-bit counter allows
+static lowpower_stats_t stats;
+
+static const char *const cause_names[WAKE_CAUSES] = {
+    "timer", "pd_intr", "button", "other"
+};
+#endif
+
+
+/*Ticks to sleep for the scheduler's next deadline, at most max_ticks;
+  0 if something is ready. Call with interrupts masked.*/
+uint32_t LOWPOWER_SleepTicks(uint32_t max_ticks) {
+    uint32_t ticks;
+
+    if (!SCHED_NextDeadline(&ticks) || ticks > max_ticks) {
+        ticks = max_ticks;
+    }
+    return ticks;
+}
+
+
+/*SysTick reload that stretches the current tick, 'remain' counts from its
+  end, over 'ticks' ticks*/
+uint32_t LOWPOWER_StretchLoad(uint32_t remain, uint32_t ticks, uint32_t per_tick) {
+    uint64_t load = remain + (uint64_t)(ticks - 1) * per_tick;
+    return (load > LOWPOWER_LOAD_MAX) ? LOWPOWER_LOAD_MAX : (uint32_t)load;
+}
+
+
+/*Woken 'slept' counts into a stretch that began 'remain' counts before a
+  tick boundary: returns the whole ticks that passed and sets the reload
+  that ends the partial one on the original tick grid*/
+uint32_t LOWPOWER_Credit(uint32_t slept, uint32_t remain, uint32_t per_tick,
+                         uint32_t *finish_load) {
+    uint32_t elapsed = slept + (per_tick - remain);
+    *finish_load = per_tick - (elapsed % per_tick) - 1;
+    return elapsed / per_tick;
+}
+
+
+#ifndef PDT_HOST
+/*Capture the SysTick configuration set up by HAL_InitTick*/
+void LOWPOWER_Reclock(void) {
+    tick_reload = SysTick->LOAD;
+    max_sleep_ticks = LOWPOWER_LOAD_MAX / (tick_reload + 1);
+}
+
+
+void LOWPOWER_Init(void) {
+    LOWPOWER_Reclock();
+    LOWPOWER_ResetStats();
+#ifdef DEBUG
+    // Keep the debugger attached while the core sleeps
+    HAL_DBGMCU_EnableDBGSleepMode();
+#endif
+}
+
+
+/*Sleep until the scheduler's next deadline or an interrupt*/
+void LOWPOWER_Idle(void) {
+    uint32_t ticks;
+
+    // PRIMASK, not BASEPRI: WFI must still wake on every interrupt. Only the
+    // awake part of the masked window is accounted as blocking.
+    __disable_irq();
+    uint32_t mask_start = TIMEBASE_Cycles();
+
+    // Re-check with interrupts masked so a late event can't be slept through
+    ticks = LOWPOWER_SleepTicks(max_sleep_ticks);
+    if (ticks == 0) {
+        CRIT_Account(0, TIMEBASE_Cycles() - mask_start);
+        __enable_irq();
+        return;
+    }
+
+    uint32_t per_tick = tick_reload + 1;
+    uint32_t slept;
+    uint32_t masked_pre;    // masked and awake before WFI
+    uint32_t woke_at;
+    wake_cause_t cause;
+
+    if (ticks == 1) {
+        // Next tick is the deadline anyway; no need to touch SysTick
+        uint32_t before = SysTick->VAL;
+        masked_pre = TIMEBASE_Cycles() - mask_start;
+        __DSB();
+        __WFI();
+        woke_at = TIMEBASE_Cycles();
+        uint32_t after = SysTick->VAL;
+        slept = (before >= after) ? (before - after) : (before + per_tick - after);
+        cause = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) ? WAKE_TIMER : WAKE_OTHER;
+    } else {
+        // Stretch the current tick to cover the whole sleep
+        SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+        uint32_t remain = SysTick->VAL;
+        uint32_t load = LOWPOWER_StretchLoad(remain, ticks, per_tick);
+        SysTick->LOAD = load;
+        SysTick->VAL = 0;
+        (void)SysTick->CTRL;    // clear COUNTFLAG
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+        masked_pre = TIMEBASE_Cycles() - mask_start;
+        __DSB();
+        __WFI();
+        woke_at = TIMEBASE_Cycles();
+
+        SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+        if (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) {
+            // Full stretch elapsed; the pending SysTick accounts for one tick
+            slept = load + 1;
+            uwTick += (ticks - 1) * uwTickFreq;
+            SysTick->LOAD = tick_reload;
+            SysTick->VAL = 0;
+            cause = WAKE_TIMER;
+        } else {
+            // Woken early: credit whole ticks and finish the partial one
+            uint32_t finish;
+            slept = load - SysTick->VAL;
+            uwTick += LOWPOWER_Credit(slept, remain, per_tick, &finish) * uwTickFreq;
+            SysTick->LOAD = finish;
+            SysTick->VAL = 0;
+            cause = WAKE_OTHER;
+        }
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        // Takes effect at the next reload, i.e. after the partial tick
+        SysTick->LOAD = tick_reload;
+    }
+
+    if (cause == WAKE_OTHER) {
+        if (EXTI->PR & EXTI_PD_INTR) {
+            cause = WAKE_PD_INTR;
+        } else if (EXTI->PR & EXTI_BUTTON) {
+            cause = WAKE_BUTTON;
+        }
+    }
+
+    stats.sleeps++;
+    stats.wakes[cause]++;
+    stats.idle_us += slept / (SystemCoreClock / 1000000U);
+
+    CRIT_Account(0, masked_pre + (TIMEBASE_Cycles() - woke_at));
+    __enable_irq();
+}
+
+
+/*Share of wall time spent asleep since the last reset, in 1/1000*/
+uint32_t LOWPOWER_IdlePermille(void) {
+    uint32_t total_ms = HAL_GetTick() - stats.since_ms;
+    if (total_ms == 0) {
+        return 0;
+    }
+    uint64_t permille = stats.idle_us / total_ms;  // us per ms == 1/1000
+    return (permille > 1000) ? 1000 : (uint32_t)permille;
+}
+
+
+const lowpower_stats_t *LOWPOWER_Stats(void) {
+    return &stats;
+}
+
+
+void LOWPOWER_ResetStats(void) {
+    memset(&stats, 0, sizeof(stats));
+    stats.since_ms = HAL_GetTick();
+}
+
+
+/*Print the idle ratio and wakeup-cause histogram*/
+void LOWPOWER_Dump(sched_print_t print) {
+    uint32_t permille = LOWPOWER_IdlePermille();
+    print("idle: %lu.%lu%% over %lu sleeps\r\n",
+          (unsigned long)(permille / 10), (unsigned long)(permille % 10),
+          (unsigned long)stats.sleeps);
+    for (int i = 0; i < WAKE_CAUSES; i++) {
+        print("  wake %-8s %lu\r\n", cause_names[i], (unsigned long)stats.wakes[i]);
+    }
+}
+#endif
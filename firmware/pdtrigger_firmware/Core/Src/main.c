@@ -19,15 +19,37 @@
 
 #include "main.h"
 #include "cypd3177.h"
+#include "sched.h"
+#include "lowpower.h"
+#include "coro.h"
+#include "app_rtos.h"
+#include "app_isr.h"
+#include "timebase.h"
+#include "clockgov.h"
+#include "bootprof.h"
+#include "supervisor.h"
+#include "isrstat.h"
+#include "defer.h"
+#include "evq.h"
+#include "crit.h"
+#include "evflags.h"
+#include "uarttx.h"
+#include "log.h"
+#include "tlm.h"
+#include "cmd.h"
+#include "link.h"
+#include "sub.h"
 #include <string.h>
-#include <stdio.h>
 #include <stdarg.h>
 
 I2C_HandleTypeDef hi2c3;
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_USART2_UART_Init(void);
 static void MX_I2C3_Init(void);
 
@@ -35,7 +57,10 @@ static void MX_I2C3_Init(void);
 // GPIO pin defines
 // --------------------
 #define BTN_PORT    GPIOB
-#define BTN_PIN     GPIO_PIN_7   // Button input
+#define BTN_PIN     GPIO_PIN_7   // Button input (EXTI7)
+
+#define PD_INTR_PORT GPIOC
+#define PD_INTR_PIN  GPIO_PIN_11 // CYPD3177 INTR, active low (EXTI11)
 
 #define LED_5V_PORT GPIOB
 #define LED_5V_PIN  GPIO_PIN_6
@@ -59,87 +84,1087 @@ static void MX_I2C3_Init(void);
 #define PDO_15V  0x0004B12C  // 15 V, 3 A
 #define PDO_20V  0x0006412C  // 20 V, 3 A
 
+#define PDO_COUNT (sizeof(pdos)/sizeof(pdos[0]))
+
 static const uint32_t pdos[] = {PDO_5V, PDO_9V, PDO_12V, PDO_15V, PDO_20V};
-static uint8_t pdo_index = 0;
+static uint8_t pdo_index = 0;   // PDO currently in effect
+static uint8_t pdo_target = 0;  // PDO being requested
+
+// --------------------
+// LED update: turn on only active PDO LED
+// --------------------
+static void update_leds(uint8_t index)
+{
+    HAL_GPIO_WritePin(LED_5V_PORT, LED_5V_PIN,  (index == 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_9V_PORT, LED_9V_PIN,  (index == 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_12V_PORT, LED_12V_PIN,(index == 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_15V_PORT, LED_15V_PIN,(index == 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_20V_PORT, LED_20V_PIN,(index == 4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
 
+#ifndef PDT_RTOS
 // --------------------
-// Simple UART printf wrapper
+// Clock governor backend
 // --------------------
-static void uart_printf(const char *fmt, ...)
+/*Switch the clock tree only*/
+static bool clock_switch(clk_state_t next)
+{
+  RCC_OscInitTypeDef RCC_OscInitStruct = {0};
+  RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+
+  RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                              |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV1;
+
+  if (next == CLK_HIGH)
+  {
+    /* VOS may only change while the PLL is off, i.e. before enabling it */
+    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE2);
+
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+    RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+    RCC_OscInitStruct.PLL.PLLM = 8;
+    RCC_OscInitStruct.PLL.PLLN = 84;
+    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+    RCC_OscInitStruct.PLL.PLLQ = 4;
+    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+    {
+      return false;
+    }
+
+    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_2) != HAL_OK)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_HSE;
+    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
+    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
+    {
+      return false;
+    }
+
+    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_OFF;
+    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+    {
+      return false;
+    }
+    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE3);
+  }
+
+  return true;
+}
+
+/*Switch the clock tree, then re-derive everything that depends on it*/
+static bool clock_apply(clk_state_t next)
+{
+  /* The chunk in flight must finish at the baud rate it started with */
+  UARTTX_Suspend();
+  CMD_RxStop();
+  bool ok = clock_switch(next);
+  if (ok)
+  {
+    /* HAL_RCC_ClockConfig already re-ran HAL_InitTick; redo the rest.
+       Both buses are idle here: I2C is blocking, UART TX is suspended. */
+    MX_I2C3_Init();
+    LINK_Reclock();
+    TIMEBASE_Reclock();
+    LOWPOWER_Reclock();
+  }
+  CMD_RxStart();
+  UARTTX_Resume();
+  return ok;
+}
+#endif /* PDT_RTOS */
+
+// --------------------
+// Tasks
+// --------------------
+#define STATUS_PERIOD_MS    100
+#define VBUS_PERIOD_MS      100
+#define REPORT_PERIOD_MS    10000
+#define REPORT_BURST_MS     20
+#define REPORT_PART_MAX     768     // bytes on the wire; the task table is ~700 in TLM frames
+#define REPORT_POLL_MS      10      // ~115 bytes leave the ring meanwhile
+#define BTN_DEBOUNCE_MS     20
+#define SEQ_POLL_MS         10
+#define PDO_ACCEPT_MS       500
+#define VBUS_SETTLE_MS      1000
+#define PD_ONLINE_MS        500
+#define BOOT_POLL_MS        1       // probe rate until the first contract
+#define BOOT_PDO_INDEX      0       // PDO requested straight out of reset
+#define RATE_MIN_MS         10      // fastest telemetry period a host may set
+#define RATE_MAX_MS         3600000
+#ifdef PDT_RTOS
+#define LOG_POLICY          UARTTX_BLOCK        // only the ui task writes
+#else
+#define LOG_POLICY          UARTTX_DROP_NEWEST  // a full ring never stalls the driver
+#endif
+
+// Run time budgets (us) for the supervisor; UART prints block at 115200 baud
+#define PD_INT_BUDGET_US    5000
+#define PDO_BUDGET_US       10000
+#define PROBE_BUDGET_US     5000
+#define BUTTON_BUDGET_US    1000
+#define STATUS_BUDGET_US    5000
+#define SUB_BUDGET_US       10000   // every topic due at once
+#define REPORT_BUDGET_US    20000   // one part, formatted into the ring
+#define CMD_BUDGET_US       20000
+#define LINK_BUDGET_US      150000  // drains a full TX ring at 115200
+#define CHECKIN_PERIODS     3       // required tasks may miss this many periods
+
+// PD conditions, set by the driver tasks and telemetry, waited on by the
+// PDO sequence
+#define PDF_ONLINE      (1UL << 0)  // CYPD3177 answering, in active mode
+#define PDF_DETACH      (1UL << 1)  // CYPD3177 went offline
+#define PDF_CONTRACT    (1UL << 2)  // source answered the PDO request (INTR)
+#define PDF_VBUS_OK     (1UL << 3)  // VBUS within 5% of pdo_target
+
+static evflags_t pd_flags;
+static bool online = false;
+static sched_id_t button_task_id;
+static sched_id_t pdo_task_id;
+static sched_id_t probe_task_id;
+static sched_id_t link_task_id;
+#ifndef PDT_RTOS
+// Telemetry; in PDT_RTOS these are jobs. Until the UART is up there is no sub task.
+static sched_id_t sub_task_id = SCHED_NO_TASK;
+static sched_id_t report_task_id;
+#endif
+static coro_t pdo_co = { .line = CORO_LINE_DONE };
+static const char *pdo_result;      // why the last change ended, NULL = reached
+static cmd_token_t pdo_waiter;      // "pdo" request answered when the change ends
+static sched_id_t dump_task_id;
+static cmd_token_t dump_waiter;     // "dump" request answered when the report is out
+
+// INTR edges, timestamped in the ISR, for the pd_int task
+typedef struct {
+    uint32_t stamp;     // core cycles at the edge
+} pd_edge_t;
+
+EVQ_DEFINE(pd_edges, pd_edge_t, 8);
+
+// INTR edge to handler latency, in core cycles (same measure in both builds)
+static uint32_t pd_lat_max;
+static uint32_t pd_lat_sum;
+static uint32_t pd_lat_count;
+
+static uint16_t vbus_last;      // latest good VBUS sample, for telemetry
+
+/*Track the controller state in 'online' and the flag group*/
+static void set_online(bool on)
+{
+    online = on;
+    if (on) {
+        EVFLAGS_Clear(&pd_flags, PDF_DETACH);
+        EVFLAGS_Set(&pd_flags, PDF_ONLINE);
+    } else {
+        EVFLAGS_Clear(&pd_flags, PDF_ONLINE);
+        EVFLAGS_Set(&pd_flags, PDF_DETACH);
+    }
+}
+
+/*Poll the controller's mode register*/
+static bool probe_online(void)
+{
+    bool on = false;
+    if (CYPD3177_Online(&on) != HAL_OK) {
+        on = false;
+    }
+    set_online(on);
+    return on;
+}
+
+/*Sample VBUS and update PDF_VBUS_OK against the requested PDO*/
+static HAL_StatusTypeDef vbus_sample(uint16_t *mv)
+{
+    uint16_t vbus = 0;
+    uint16_t target = PDO_MV(pdos[pdo_target]);
+    uint16_t tol = target / 20;
+
+    HAL_StatusTypeDef res = CYPD3177_VBUS_mV(&vbus);
+    if (res == HAL_OK) {
+        EVFLAGS_Put(&pd_flags, PDF_VBUS_OK,
+                    (vbus + tol >= target) && (vbus <= target + tol));
+        vbus_last = vbus;
+    }
+    if (mv) {
+        *mv = vbus;
+    }
+    return res;
+}
+
+/*After an MCU-only reset the CYPD3177 usually still holds the contract we
+  asked for. Take it over as is: requesting it again would cost a round
+  trip and may glitch VBUS. Every check must pass, else boot negotiates.*/
+static bool adopt_contract(void)
+{
+    uint16_t vbus = 0;
+
+    if (!probe_online()) {
+        return false;
+    }
+    int i = CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus);
+    if (i < 0) {
+        return false;
+    }
+    pdo_index = pdo_target = (uint8_t)i;
+    vbus_last = vbus;
+    EVFLAGS_Set(&pd_flags, PDF_CONTRACT | PDF_VBUS_OK);
+    return true;
+}
+
+/*Controller state as TLM_ST_x bits*/
+static uint8_t status_flags(void)
+{
+    uint8_t flags = 0;
+
+    if (online) {
+        flags |= TLM_ST_ONLINE;
+    }
+    if (EVFLAGS_All(&pd_flags, PDF_CONTRACT)) {
+        flags |= TLM_ST_CONTRACT;
+    }
+    if (EVFLAGS_All(&pd_flags, PDF_VBUS_OK)) {
+        flags |= TLM_ST_VBUS_OK;
+    }
+    if (!CORO_IsDone(&pdo_co)) {
+        flags |= TLM_ST_CHANGING;
+    }
+    return flags;
+}
+
+/*Status snapshot for telemetry*/
+static void status_report(void)
+{
+    TLM_Status(status_flags(), pdo_index, pdo_target, vbus_last);
+}
+
+// --------------------
+// Telemetry topics (see sub.h): sampled only while a host subscribes
+// --------------------
+enum { TOPIC_VBUS, TOPIC_TYPEC, TOPIC_PD, TOPIC_CONTRACT, TOPIC_COUNTERS };
+#define TOPIC_BIT(t)    (1UL << (t))
+
+// With PDT_TLM the STATE frame already carries each sample, and log text
+// would go out beside it as a TEXT frame: the lines drop to DEBUG, which
+// the default LOG_LEVEL_x compiles out
+#ifdef PDT_TLM
+#define TOPIC_LOG(mod, ...)     LOG_DEBUG(mod, __VA_ARGS__)
+#else
+#define TOPIC_LOG(mod, ...)     LOG_INFO(mod, __VA_ARGS__)
+#endif
+
+static bool vbus_topic(uint8_t *value)
+{
+    uint16_t mv;
+
+    if (!online || vbus_sample(&mv) != HAL_OK) {
+        return false;
+    }
+    memcpy(value, &mv, sizeof(mv));
+    return true;
+}
+
+static void vbus_emit(const uint8_t *value)
+{
+    uint16_t mv;
+
+    memcpy(&mv, value, sizeof(mv));
+    TLM_State(TLM_F_VBUS, mv);
+    TOPIC_LOG(SYS, "VBUS: %V V\r\n", mv);
+}
+
+static bool typec_topic(uint8_t *value)
+{
+    return online && CYPD3177_Read(CYPD_TYPE_C_STATUS_REG, value, 1) == HAL_OK;
+}
+
+static void typec_emit(const uint8_t *value)
+{
+    TLM_State(TLM_F_TYPEC, value[0]);
+    TOPIC_LOG(PD, "Type-C status: 0x%02X\r\n", value[0]);
+}
+
+static bool pd_topic(uint8_t *value)
+{
+    return online && CYPD3177_Read(CYPD_PD_STATUS_REG, value, 4) == HAL_OK;
+}
+
+static void pd_emit(const uint8_t *value)
+{
+    uint32_t st;
+
+    memcpy(&st, value, sizeof(st));     // register bytes are little-endian, as is the core
+    TLM_State(TLM_F_PD, st);
+    TOPIC_LOG(PD, "PD status: 0x%08lX\r\n", (unsigned long)st);
+}
+
+/*No bus access: the driver tasks keep this state current*/
+static bool contract_topic(uint8_t *value)
+{
+    value[0] = status_flags();
+    value[1] = pdo_index;
+    value[2] = pdo_target;
+    return true;
+}
+
+static void contract_emit(const uint8_t *value)
+{
+    TLM_State(TLM_F_FLAGS, value[0]);
+    TLM_State(TLM_F_PDO_INDEX, value[1]);
+    TLM_State(TLM_F_PDO_TARGET, value[2]);
+    TOPIC_LOG(PDO, "Contract: PDO[%u] target PDO[%u] flags 0x%02X\r\n", value[1], value[2], value[0]);
+}
+
+static bool counters_topic(uint8_t *value)
+{
+    uint32_t c[4] = {
+        pd_lat_count, CMD_Stats()->lines, UARTTX_Stats()->dropped, LINK_Stats()->rx_errors,
+    };
+
+    memcpy(value, c, sizeof(c));
+    return true;
+}
+
+static void counters_emit(const uint8_t *value)
+{
+    uint32_t c[4];
+
+    memcpy(c, value, sizeof(c));
+    for (uint8_t i = 0; i < 4; i++) {
+        TLM_State((tlm_field_t)(TLM_F_PD_EVENTS + i), c[i]);
+    }
+    TOPIC_LOG(SYS, "Counters: %lu PD events, %lu commands, %lu TX dropped, %lu RX errors\r\n",
+              (unsigned long)c[0], (unsigned long)c[1], (unsigned long)c[2], (unsigned long)c[3]);
+}
+
+static const sub_topic_t topics[] = {
+    [TOPIC_VBUS]     = { "vbus",     2,  vbus_topic,     vbus_emit },
+    [TOPIC_TYPEC]    = { "typec",    1,  typec_topic,    typec_emit },
+    [TOPIC_PD]       = { "pd",       4,  pd_topic,       pd_emit },
+    [TOPIC_CONTRACT] = { "contract", 3,  contract_topic, contract_emit },
+    [TOPIC_COUNTERS] = { "counters", 16, counters_topic, counters_emit },
+};
+
+// STATE fields each topic fills in
+static const uint32_t topic_fields[] = {
+    [TOPIC_VBUS]     = TLM_FIELD(TLM_F_VBUS),
+    [TOPIC_TYPEC]    = TLM_FIELD(TLM_F_TYPEC),
+    [TOPIC_PD]       = TLM_FIELD(TLM_F_PD),
+    [TOPIC_CONTRACT] = TLM_FIELD(TLM_F_FLAGS) | TLM_FIELD(TLM_F_PDO_INDEX) |
+                       TLM_FIELD(TLM_F_PDO_TARGET),
+    [TOPIC_COUNTERS] = TLM_FIELD(TLM_F_PD_EVENTS) | TLM_FIELD(TLM_F_CMD_LINES) |
+                       TLM_FIELD(TLM_F_TX_DROPPED) | TLM_FIELD(TLM_F_RX_ERRORS),
+};
+
+static void sub_task(void *arg);
+
+/*Run the subscriptions now rather than at their next sample*/
+static void sub_wake(void)
+{
+#ifdef PDT_RTOS
+    APP_RTOS_SetPeriod(sub_task, 1);
+#else
+    SCHED_Start(sub_task_id, 0);
+#endif
+}
+
+/*Something the on-change topics in topic_mask report may have changed*/
+static void sub_changed(uint32_t topic_mask)
+{
+    if (SUB_Changed(topic_mask)) {
+        sub_wake();
+    }
+}
+
+/*Sample what is due and send what changed as one STATE frame; sleeps
+  while nothing is subscribed*/
+static void sub_task(void *arg)
+{
+    uint32_t next = SUB_Poll();
+    uint32_t active = SUB_Active();
+    uint32_t live = 0;
+
+    for (uint8_t i = 0; i < sizeof(topic_fields)/sizeof(topic_fields[0]); i++) {
+        if (active & TOPIC_BIT(i)) {
+            live |= topic_fields[i];
+        }
+    }
+    TLM_StateFlush(live);
+
+#ifdef PDT_RTOS
+    APP_RTOS_SetPeriod(sub_task, next);
+#else
+    if (next) {
+        SCHED_Start(sub_task_id, next);
+    }
+#endif
+}
+
+/*Check the CYPD3177 is alive and mirror it on the status LED*/
+static void status_task(void *arg)
+{
+    bool was_online = online;
+
+    if (probe_online()) {
+        // Turn ON status LED if chip is online
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0, GPIO_PIN_SET);
+    } else {
+        // Turn OFF status LED => chip offline
+        HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0, GPIO_PIN_RESET);
+        // A change still waiting for the controller to come up keeps waiting
+        if (was_online && !CORO_IsDone(&pdo_co)) {
+            CORO_Cancel(&pdo_co);
+            // Clearing flags posts no event: run it now so the cancel is seen
+            SCHED_Start(pdo_task_id, 0);
+        }
+        if (was_online) {
+            TLM_Event(TLM_EV_OFFLINE, 0, 0);
+        }
+        LOG_WARN(PD, "CYPD3177 not active.\r\n");
+    }
+    if (online != was_online) {
+        sub_changed(TOPIC_BIT(TOPIC_CONTRACT) | TOPIC_BIT(TOPIC_TYPEC) | TOPIC_BIT(TOPIC_PD));
+    }
+}
+
+/*Handle the CYPD3177 INTR line: read and acknowledge the interrupt sources*/
+static void pd_int_task(void *arg)
+{
+    cypd3177_int_t status;
+    uint8_t clear = 0;
+    pd_edge_t edge;
+
+    // One record per edge, even if several arrived before this run
+    while (EVQ_Get(&pd_edges, &edge)) {
+        uint32_t lat = TIMEBASE_Cycles() - edge.stamp;
+        if (lat > pd_lat_max) {
+            pd_lat_max = lat;
+        }
+        pd_lat_sum += lat;
+        pd_lat_count++;
+        ISRSTAT_Latency(ISR_PD_PATH, lat);
+    }
+
+    if (CYPD3177_Int_Read(&status) != HAL_OK) {
+        return;
+    }
+    if (status.device_int) {
+        clear |= CYPD_DEVICE_INT;
+    }
+    if (status.pd_port_int) {
+        clear |= CYPD_PD_PORT_INT;
+    }
+    if (clear) {
+        CYPD3177_Write(CYPD_INTERRUPT_REG, &clear, 1);
+        TLM_Event(TLM_EV_PD_INTR, clear, 0);
+        LOG_INFO(PD, "PD event: 0x%02X\r\n", clear);
+    }
+    if (status.pd_port_int) {
+        EVFLAGS_Set(&pd_flags, PDF_CONTRACT);
+        vbus_sample(NULL);
+    }
+    if (clear) {
+        sub_changed(TOPIC_BIT(TOPIC_TYPEC) | TOPIC_BIT(TOPIC_PD) | TOPIC_BIT(TOPIC_CONTRACT));
+    }
+}
+
+/*Start a PDO change; one already running is superseded*/
+static void request_pdo(uint8_t index)
+{
+    CMD_Complete(&pdo_waiter, "superseded");
+    pdo_target = index;
+    CORO_Reset(&pdo_co);
+    SCHED_Start(pdo_task_id, 0);
+    sub_changed(TOPIC_BIT(TOPIC_CONTRACT));
+}
+
+/*Button edge arms a debounce timer; the press is acted on when it expires*/
+static void button_task(void *arg)
+{
+    if (SCHED_Events() & EVT_BUTTON) {
+        if (!SCHED_IsArmed(button_task_id)) {
+            SCHED_Start(button_task_id, BTN_DEBOUNCE_MS);
+        }
+        return;
+    }
+
+    // Still pressed after debounce? (active low)
+    if (HAL_GPIO_ReadPin(BTN_PORT, BTN_PIN) != GPIO_PIN_RESET || !online) {
+        return;
+    }
+
+    // Advance PDO index; a press during a running change supersedes it
+    request_pdo((pdo_target + 1) % PDO_COUNT);
+}
+
+/*Sample what a running PDO change is still waiting for. The controller has
+  no interrupt for "online" or "VBUS in range", so this is the one place that
+  polls; everything else waits on pd_flags.*/
+static void probe_task(void *arg)
+{
+    if (CORO_IsDone(&pdo_co)) {
+        return;
+    }
+    if (!online) {
+        probe_online();
+    } else if (!EVFLAGS_All(&pd_flags, PDF_VBUS_OK)) {
+        vbus_sample(NULL);
+    }
+    if (!EVFLAGS_All(&pd_flags, PDF_ONLINE | PDF_VBUS_OK)) {
+        SCHED_Start(probe_task_id, BOOTPROF_Reached(BOOT_CONTRACT) ? SEQ_POLL_MS : BOOT_POLL_MS);
+    }
+}
+
+/*Write PDO -> wait for the source to answer and VBUS to settle -> update LEDs*/
+static coro_status_t pdo_change_seq(coro_t *co)
+{
+    uint32_t req[2];
+
+    CORO_BEGIN(co);
+
+    pdo_result = NULL;
+    CLOCKGOV_Request(BURST_NEGOTIATION, PDO_ACCEPT_MS + VBUS_SETTLE_MS);
+
+    // Both refer to the previous request
+    EVFLAGS_Clear(&pd_flags, PDF_CONTRACT | PDF_VBUS_OK);
+    SCHED_Start(probe_task_id, 0);
+
+    CORO_AWAIT_ALL(co, &pd_flags, PDF_ONLINE, PD_ONLINE_MS);
+    if (CORO_TIMED_OUT(co)) {
+        pdo_result = "offline";
+        pdo_target = pdo_index;
+        CORO_EXIT(co);
+    }
+    BOOTPROF_Mark(BOOT_PD_ONLINE);
+
+    req[0] = pdos[0];
+    req[1] = pdos[pdo_target];
+    if (CYPD3177_ChangePDO(req) != HAL_OK) {
+        TLM_Event(TLM_EV_PDO_FAILED, pdo_target, 0);
+        LOG_ERROR(PDO, "PDO change failed!\r\n");
+        pdo_result = "i2c";
+        CORO_EXIT(co);
+    }
+    BOOTPROF_Mark(BOOT_PDO_REQUEST);
+    TLM_Event(TLM_EV_PDO_REQUEST, pdo_target, PDO_MV(pdos[pdo_target]));
+    LOG_INFO(PDO, ">> Requested PDO[%u], V=%V V\r\n",
+                pdo_target, PDO_MV(pdos[pdo_target]));
+
+    // The CYPD3177 raises INTR once the source has responded
+    CORO_AWAIT_ALL(co, &pd_flags, PDF_CONTRACT | PDF_VBUS_OK, PDO_ACCEPT_MS);
+    if (CORO_TIMED_OUT(co)) {
+        // No answer seen in time: VBUS alone decides
+        CORO_AWAIT_ANY(co, &pd_flags, PDF_VBUS_OK, VBUS_SETTLE_MS);
+    }
+    if (CORO_TIMED_OUT(co)) {
+        TLM_Event(TLM_EV_PDO_TIMEOUT, pdo_target, vbus_last);
+        LOG_WARN(PDO, "PDO[%u] not reached, keeping PDO[%u]\r\n", pdo_target, pdo_index);
+        pdo_result = "timeout";
+        pdo_target = pdo_index;
+        CORO_EXIT(co);
+    }
+
+    pdo_index = pdo_target;
+    update_leds(pdo_index);
+    TLM_Event(TLM_EV_PDO_DONE, pdo_index, vbus_last);
+    if (BOOTPROF_Mark(BOOT_CONTRACT)) {
+        BOOTPROF_Dump(LOG_Printf);
+    }
+
+    CORO_END(co);
+}
+
+/*Drive the PDO change sequence. pd_flags changes wake it; the timer only
+  covers the current wait's timeout.*/
+static void pdo_task(void *arg)
+{
+    coro_status_t st = pdo_change_seq(&pdo_co);
+
+    if (st == CORO_RUNNING) {
+        SCHED_Start(pdo_task_id, CORO_Remaining(&pdo_co));
+    } else if (st == CORO_CANCELLED) {
+        TLM_Event(TLM_EV_PDO_CANCEL, pdo_target, 0);
+        LOG_WARN(PDO, "PDO change cancelled\r\n");
+        pdo_target = pdo_index;
+        CMD_Complete(&pdo_waiter, "cancelled");
+    } else {
+        CMD_Complete(&pdo_waiter, pdo_result);
+    }
+    if (st != CORO_RUNNING) {
+        sub_changed(TOPIC_BIT(TOPIC_CONTRACT));
+    }
+}
+
+/*Report parts. Each prints at most REPORT_PART_MAX bytes, so dump_task can
+  send one as soon as the TX ring has room for it and no scheduler pass
+  waits on the UART. 'step' counts the calls a part has had; it returns
+  true once it is done.*/
+typedef bool (*report_part_t)(sched_print_t print, uint8_t step);
+
+static const report_part_t *report_parts;   // report going out, NULL = none
+static uint8_t report_count;
+static uint8_t report_part;
+static uint8_t report_step;
+static sched_print_t report_print;
+
+static bool report_tasks(sched_print_t print, uint8_t step)
+{
+    CLOCKGOV_Request(BURST_TELEMETRY, REPORT_BURST_MS);
+    TLM_Hello();
+    SCHED_Dump(print);
+    return true;
+}
+
+static bool report_power(sched_print_t print, uint8_t step)
+{
+#ifdef PDT_RTOS
+    APP_RTOS_Dump(print);
+#else
+#ifdef PDT_ISR_ONLY
+    APP_ISR_Dump(print);
+#else
+    LOWPOWER_Dump(print);
+#endif
+    CLOCKGOV_Dump(print);
+#endif
+    return true;
+}
+
+static bool report_supervisor(sched_print_t print, uint8_t step)
+{
+    SUPERVISOR_Dump(print);
+    return true;
+}
+
+static bool report_events(sched_print_t print, uint8_t step)
+{
+    DEFER_Dump(print);
+    EVQ_Dump(&pd_edges, "pd_edges", print);
+    if (pd_lat_count) {
+        print("PD event latency: avg %lu max %lu ns\r\n",
+              (unsigned long)TIMEBASE_CyclesToNs(pd_lat_sum / pd_lat_count),
+              (unsigned long)TIMEBASE_CyclesToNs(pd_lat_max));
+    }
+    return true;
+}
+
+/*One source per step; the histograms cover one report interval*/
+static bool report_isr(sched_print_t print, uint8_t step)
+{
+    ISRSTAT_DumpSource(print, (isr_src_t)step);
+    if (step + 1 < ISR_SOURCES) {
+        return false;
+    }
+    ISRSTAT_Reset();
+    return true;
+}
+
+static bool report_crit(sched_print_t print, uint8_t step)
+{
+    CRIT_Dump(print);
+    return true;
+}
+
+static bool report_link(sched_print_t print, uint8_t step)
+{
+    UARTTX_Dump(print);
+    CMD_Dump(print);
+    LINK_Dump(print);
+    return true;
+}
+
+static bool report_streams(sched_print_t print, uint8_t step)
+{
+    SUB_Dump(print);
+    return true;
+}
+
+static bool report_log(sched_print_t print, uint8_t step)
+{
+    LOG_Dump(print);
+    TLM_Dump(print);
+    return true;
+}
+
+static const report_part_t report_all[] = {
+    report_tasks, report_power, report_supervisor, report_events,
+    report_isr, report_crit, report_link, report_streams, report_log,
+};
+
+static const report_part_t report_isr_only[] = { report_isr };
+
+/*Queue a report for dump_task. Returns false while another is going out.*/
+static bool report_begin(const report_part_t *parts, uint8_t count, sched_print_t print)
+{
+    if (report_parts != NULL) {
+        return false;
+    }
+    report_parts = parts;
+    report_count = count;
+    report_part = 0;
+    report_step = 0;
+    report_print = print;
+    SCHED_Start(dump_task_id, 0);
+    return true;
+}
+
+/*Send the next report part once the TX ring has room for all of it*/
+static void dump_task(void *arg)
+{
+    if (report_parts == NULL) {
+        return;
+    }
+    if (UARTTX_Pending() > UARTTX_RING_SIZE - REPORT_PART_MAX) {
+        SCHED_Start(dump_task_id, REPORT_POLL_MS);
+        return;
+    }
+    if (report_parts[report_part](report_print, report_step++)) {
+        report_part++;
+        report_step = 0;
+    }
+    if (report_part < report_count) {
+        SCHED_Start(dump_task_id, 0);
+        return;
+    }
+    report_parts = NULL;
+    CMD_Complete(&dump_waiter, NULL);   // spent unless "dump" asked for it
+}
+
+/*CMD_Printf on behalf of the deferred "dump" request*/
+static void dump_print(const char *fmt, ...)
 {
-    char buf[128];
     va_list args;
+
     va_start(args, fmt);
-    vsnprintf(buf, sizeof(buf), fmt, args);
+    CMD_Vprintf(&dump_waiter, fmt, args);
     va_end(args);
-    HAL_UART_Transmit(&huart2, (uint8_t*)buf, strlen(buf), HAL_MAX_DELAY);
+}
+
+/*Periodic report*/
+static void report_task(void *arg)
+{
+#ifdef PDT_RTOS
+    // APP_RTOS_Log makes the telemetry task wait for the UART while the
+    // log queue is full, so the whole report goes out in one go
+    for (uint8_t i = 0; i < sizeof(report_all)/sizeof(report_all[0]); i++) {
+        for (uint8_t step = 0; !report_all[i](LOG_Printf, step); step++) {
+        }
+    }
+#else
+    // Skipped if a "dump" is still going out
+    report_begin(report_all, sizeof(report_all)/sizeof(report_all[0]), LOG_Printf);
+#endif
 }
 
 // --------------------
-// LED update: turn on only active PDO LED
+// Commands (USART2 RX, see cmd.h)
 // --------------------
-static void update_leds(uint8_t index)
+/*pdo <index>: answered once the change is done, failed or superseded*/
+static const char *cmd_pdo(uint8_t argc, char *argv[])
 {
-    HAL_GPIO_WritePin(LED_5V_PORT, LED_5V_PIN,  (index == 0) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED_9V_PORT, LED_9V_PIN,  (index == 1) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED_12V_PORT, LED_12V_PIN,(index == 2) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED_15V_PORT, LED_15V_PIN,(index == 3) ? GPIO_PIN_SET : GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED_20V_PORT, LED_20V_PIN,(index == 4) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    uint32_t index;
+
+    if (!CMD_ParseU32(argv[1], &index) || index >= PDO_COUNT) {
+        return "range";
+    }
+    if (!online) {
+        return "offline";
+    }
+    request_pdo((uint8_t)index);
+    return CMD_Defer(&pdo_waiter);
+}
+
+/*status*/
+static const char *cmd_status(uint8_t argc, char *argv[])
+{
+    uint8_t flags = status_flags();
+
+    status_report();
+    CMD_Printf("pdo %u/%u vbus %u mV%s%s%s%s\r\n", pdo_index, pdo_target, vbus_last,
+               (flags & TLM_ST_ONLINE) ? " online" : " offline",
+               (flags & TLM_ST_CONTRACT) ? " contract" : "",
+               (flags & TLM_ST_VBUS_OK) ? " vbus_ok" : "",
+               (flags & TLM_ST_CHANGING) ? " changing" : "");
+    return NULL;
+}
+
+/*rate report <ms>; 0 stops the stream. Topics are set with "sub".*/
+static const char *cmd_rate(uint8_t argc, char *argv[])
+{
+    uint32_t ms;
+
+    if (strcmp(argv[1], "report") != 0) {
+        return "stream";
+    }
+    if (!CMD_ParseU32(argv[2], &ms) || (ms && (ms < RATE_MIN_MS || ms > RATE_MAX_MS))) {
+        return "range";
+    }
+#ifdef PDT_RTOS
+    APP_RTOS_SetPeriod(report_task, ms);
+#else
+    SCHED_SetPeriod(report_task_id, ms);
+#endif
+    return NULL;
+}
+
+/*sub [<topic|all> <ms|change|off> [ms]], see sub.h*/
+static const char *cmd_sub(uint8_t argc, char *argv[])
+{
+    const char *err = SUB_Command(argc, argv);
+
+    if (err == NULL) {
+        sub_wake();
+    }
+    return err;
+}
+
+/*dump [all|isr|cmd]*/
+static const char *cmd_dump(uint8_t argc, char *argv[])
+{
+    const char *what = (argc > 1) ? argv[1] : "all";
+
+    const report_part_t *parts;
+    uint8_t count;
+
+    if (strcmp(what, "all") == 0) {
+        parts = report_all;
+        count = sizeof(report_all)/sizeof(report_all[0]);
+    } else if (strcmp(what, "isr") == 0) {
+        parts = report_isr_only;
+        count = 1;
+    } else if (strcmp(what, "cmd") == 0) {
+        CMD_Dump(CMD_Printf);
+        return NULL;
+    } else {
+        return "arguments";
+    }
+    // Goes out a part at a time; answered once all of it is in the ring
+    if (report_parts != NULL) {
+        return "busy";
+    }
+    report_begin(parts, count, dump_print);
+    return CMD_Defer(&dump_waiter);
+}
+
+/*log <module> <level>; the level is clamped to what was compiled in*/
+static const char *cmd_log(uint8_t argc, char *argv[])
+{
+    int mod = LOG_ModuleByName(argv[1]);
+    int level = LOG_LevelByName(argv[2]);
+
+    if (mod < 0 || level < 0) {
+        return "arguments";
+    }
+    CMD_Printf("log %s %s\r\n", argv[1],
+               LOG_LevelName(LOG_SetLevel((log_module_t)mod, (uint8_t)level)));
+    return NULL;
+}
+
+/*baud [rate]: the switch happens once this reply is out, see link.h*/
+static const char *cmd_baud(uint8_t argc, char *argv[])
+{
+    uint32_t rate;
+    const char *err;
+
+    if (argc == 1) {
+        LINK_Dump(CMD_Printf);
+        return NULL;
+    }
+    if (!CMD_ParseU32(argv[1], &rate)) {
+        return "range";
+    }
+    err = LINK_Request(rate);
+    if (err == NULL) {
+        SCHED_Start(link_task_id, LINK_SWITCH_MS);
+    }
+    return err;
+}
+
+/*ping: does nothing, confirms a new baud rate*/
+static const char *cmd_ping(uint8_t argc, char *argv[])
+{
+    return NULL;
+}
+
+static const cmd_t commands[] = {
+    { "pdo",    cmd_pdo,    1, 1, "<index>: request a PDO, answered once reached" },
+    { "status", cmd_status, 0, 0, ": controller state" },
+    { "rate",   cmd_rate,   2, 2, "report <ms>: report period, 0 = off" },
+    { "sub",    cmd_sub,    0, 3, "[<vbus|typec|pd|contract|counters|all> <ms|change [ms]|off>]" },
+    { "dump",   cmd_dump,   0, 1, "[all|isr|cmd]: print statistics" },
+    { "log",    cmd_log,    2, 2, "<sys|pd|pdo|i2c> <level>: runtime log level" },
+    { "baud",   cmd_baud,   0, 1, "[rate]: switch USART2, confirm with any command" },
+    { "ping",   cmd_ping,   0, 0, ": no-op" },
+};
+
+/*Run every complete command line received so far*/
+static void cmd_task(void *arg)
+{
+    CMD_Poll();
+}
+
+/*Line rate negotiation and error watch*/
+static void link_task(void *arg)
+{
+    uint32_t next = LINK_Poll();
+    if (next) {
+        SCHED_Start(link_task_id, next);
+    }
+}
+
+/*Bottom half of the PD INTR edge: runs from PendSV with the edge timestamp*/
+static void pd_intr_bh(uint32_t stamp)
+{
+    pd_edge_t edge = { stamp };
+    EVQ_Post(&pd_edges, &edge);     // overflow is counted, the event still fires
+    SCHED_PostEvent(EVT_PD_INTR);
+}
+
+/*Bottom half of the button edge*/
+static void button_bh(uint32_t unused)
+{
+    SCHED_PostEvent(EVT_BUTTON);
+}
+
+/*EXTI callback (top half): timestamp, then defer the rest*/
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    if (GPIO_Pin == PD_INTR_PIN) {
+        uint32_t stamp = TIMEBASE_Cycles();
+        if (!DEFER_Post(pd_intr_bh, stamp)) {
+            pd_intr_bh(stamp);      // queue full: never lose a PD event
+        }
+    } else if (GPIO_Pin == BTN_PIN) {
+        if (!DEFER_Post(button_bh, 0)) {
+            button_bh(0);
+        }
+    }
+#ifdef PDT_RTOS
+    APP_RTOS_WakeFromISR();
+#endif
 }
 
 // --------------------
 // Main program
 // --------------------
 int main(void) {
+    BOOTPROF_Mark(BOOT_MAIN);
     HAL_Init();
+    BOOTPROF_Mark(BOOT_HAL);
     SystemClock_Config();
+    BOOTPROF_Mark(BOOT_CLOCK);
+    DEFER_Init();           // before any EXTI can fire
+    UARTTX_Init(LOG_POLICY);
+    EVQ_Init(&pd_edges);
+    EVFLAGS_Init(&pd_flags, EVT_PD_FLAGS);
+    // Only what the first PDO request needs; UART and LEDs come after it
     MX_GPIO_Init();
-    MX_USART2_UART_Init();
     MX_I2C3_Init();
+    BOOTPROF_Mark(BOOT_IO);
 
-    uart_printf("\r\n=== CYPD3177 PDO Button Switcher ===\r\n");
-    update_leds(pdo_index); // Turn on 5V LED, as this is the default PDO
+    TIMEBASE_Init();
 
-    bool online = false;
-    uint16_t vbus = 0;
+    SCHED_Init(HAL_GetTick);
+    SCHED_SetStatClock(TIMEBASE_Micros);
+
+    SUPERVISOR_Init(HAL_GetTick, SUPERVISOR_IwdgFeed);
+    SCHED_SetRunHook(SUPERVISOR_TaskDone);
+
+    sched_id_t id = SCHED_AddOneShot("pd_int", pd_int_task, NULL);
+    SCHED_Subscribe(id, EVT_PD_INTR);
+    SUPERVISOR_Watch(id, PD_INT_BUDGET_US, 0);
+    pdo_task_id = SCHED_AddOneShot("pdo", pdo_task, NULL);
+    SCHED_Subscribe(pdo_task_id, EVT_PD_FLAGS);
+    SUPERVISOR_Watch(pdo_task_id, PDO_BUDGET_US, 0);
+    probe_task_id = SCHED_AddOneShot("probe", probe_task, NULL);
+    SUPERVISOR_Watch(probe_task_id, PROBE_BUDGET_US, 0);
+    button_task_id = SCHED_AddOneShot("button", button_task, NULL);
+    SCHED_Subscribe(button_task_id, EVT_BUTTON);
+    SUPERVISOR_Watch(button_task_id, BUTTON_BUDGET_US, 0);
+    id = SCHED_AddOneShot("cmd", cmd_task, NULL);
+    SCHED_Subscribe(id, EVT_CMD);
+    SUPERVISOR_Watch(id, CMD_BUDGET_US, 0);
+    CMD_Init(commands, sizeof(commands)/sizeof(commands[0]), LOG_Printf);
+    dump_task_id = SCHED_AddOneShot("dump", dump_task, NULL);
+    SUPERVISOR_Watch(dump_task_id, REPORT_BUDGET_US, 0);
+    link_task_id = SCHED_AddOneShot("link", link_task, NULL);
+    SUPERVISOR_Watch(link_task_id, LINK_BUDGET_US, 0);
+    LINK_Init(LINK_UartApply, HAL_GetTick);
+    SUB_Init(topics, sizeof(topics)/sizeof(topics[0]), HAL_GetTick);
+    // What the fixed loop used to send, minus the unchanged status
+    SUB_Set(TOPIC_VBUS, SUB_PERIODIC, VBUS_PERIOD_MS);
+    SUB_Set(TOPIC_CONTRACT, SUB_ON_CHANGE, 0);
+    id = SCHED_AddPeriodic("status", status_task, NULL, STATUS_PERIOD_MS, STATUS_PERIOD_MS);
+    SUPERVISOR_Watch(id, STATUS_BUDGET_US, CHECKIN_PERIODS * STATUS_PERIOD_MS);
+
+    // From here on a hung I2C/UART call ends in a reset
+    SUPERVISOR_IwdgStart(SUPERVISOR_IWDG_MS);
+
+    // Warm reset: keep a live contract. Otherwise the boot fast path gets
+    // the first PDO request out, then does the rest.
+    bool adopted = adopt_contract();
+    if (adopted) {
+        BOOTPROF_Mark(BOOT_PD_ONLINE);
+        BOOTPROF_Mark(BOOT_CONTRACT);
+    } else {
+        pdo_target = BOOT_PDO_INDEX;
+        CORO_Reset(&pdo_co);
+        SCHED_Start(pdo_task_id, 0);
+        while (!BOOTPROF_Reached(BOOT_PDO_REQUEST) && !CORO_IsDone(&pdo_co)) {
+            SCHED_RunOnce();
+        }
+    }
+
+    MX_DMA_Init();
+    MX_USART2_UART_Init();
+    CMD_RxStart();
+    TLM_Hello();
+    LOG_INFO(SYS, "\r\n=== CYPD3177 PDO Button Switcher ===\r\n");
+    update_leds(pdo_index); // adopted PDO, else 5V (the default) until the request lands
+    BOOTPROF_Mark(BOOT_UART);
+    if (adopted) {
+        TLM_Event(TLM_EV_ADOPTED, pdo_index, vbus_last);
+        LOG_INFO(PDO, "Kept live contract PDO[%u], V=%V V\r\n",
+                    pdo_index, PDO_MV(pdos[pdo_index]));
+        BOOTPROF_Dump(LOG_Printf);
+    }
+
+#ifdef PDT_RTOS
+    // Driver work stays on the cooperative scheduler inside the driver task;
+    // telemetry jobs get their own preemptible task.
+    static const app_rtos_job_t telemetry[] = {
+        { sub_task,    1 },         // retimes itself, see sub_task
+        { report_task, REPORT_PERIOD_MS },
+    };
+    APP_RTOS_Start(telemetry, sizeof(telemetry)/sizeof(telemetry[0]));
+#else
+    sub_task_id = SCHED_AddOneShot("sub", sub_task, NULL);
+    SUPERVISOR_Watch(sub_task_id, SUB_BUDGET_US, 0);
+    SCHED_Start(sub_task_id, 0);
+    report_task_id = SCHED_AddPeriodic("report", report_task, NULL, REPORT_PERIOD_MS, REPORT_PERIOD_MS);
+    SUPERVISOR_Watch(report_task_id, REPORT_BUDGET_US, 0);
+    CLOCKGOV_Init(clock_apply, HAL_GetTick, CLK_HIGH);
+#ifdef PDT_ISR_ONLY
+    APP_ISR_Start();        // thread mode ends here, see app_isr.h
+#endif
+    LOWPOWER_Init();
+#endif
 
     while (1) {
-        
-      HAL_Delay(100);
-
-        if (CYPD3177_Online(&online) == HAL_OK && online) {
-            // Turn ON status LED if chip is online
-            HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0, GPIO_PIN_SET);
-
-            // Check bus voltage
-            if (CYPD3177_VBUS_mV(&vbus) == HAL_OK) {
-                uart_printf("VBUS: %u mV\r\n", vbus);
-            }
-
-            // Button pressed? (active low)
-            if (HAL_GPIO_ReadPin(BTN_PORT, BTN_PIN) == GPIO_PIN_RESET) {
-                // Advance PDO index
-                pdo_index = (pdo_index + 1) % (sizeof(pdos)/sizeof(pdos[0]));
-                uint32_t req[2] = {pdos[0], pdos[pdo_index]};
-
-                if (CYPD3177_ChangePDO(req) == HAL_OK) {
-                    uart_printf(">> Requested PDO[%u], V=%u mV\r\n",
-                                pdo_index,
-                                ((pdos[pdo_index] >> 10) & 0x3FF) * 50);
-                    update_leds(pdo_index);
-                } else {
-                    uart_printf("PDO change failed!\r\n");
-                }
-
-                // wait for button release
-                while (HAL_GPIO_ReadPin(BTN_PORT, BTN_PIN) == GPIO_PIN_RESET) {
-                    HAL_Delay(10);
-                }
-            }
-        } else {
-            // Turn OFF status LED => chip offline
-            HAL_GPIO_WritePin(GPIOB, GPIO_PIN_0, GPIO_PIN_RESET);
-            uart_printf("CYPD3177 not active.\r\n");
+        if (!SCHED_RunOnce()) {
+            SUPERVISOR_Poll();
+            CLOCKGOV_Update();
+            LOWPOWER_Idle();
         }
     }
 }
@@ -257,6 +1282,25 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 10, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+  /* DMA1_Stream6_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Stream6_IRQn, 10, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -306,10 +1350,17 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pin : PB7 */
   GPIO_InitStruct.Pin = GPIO_PIN_7;
-  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 7, 0);
+  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
+
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+
 /* USER CODE BEGIN MX_GPIO_Init_2 */
 /* USER CODE END MX_GPIO_Init_2 */
 }
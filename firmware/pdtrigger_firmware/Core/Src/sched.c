@@ -0,0 +1,370 @@
+#include "sched.h"
+#include <string.h>
+
+#define WHEEL_MASK      (SCHED_WHEEL_SLOTS - 1u)
+
+#define TASK_USED       0x01
+#define TASK_ARMED      0x02
+#define TASK_PERIODIC   0x04
+#define TASK_FIRED      0x08    // timer expired, dispatch pending
+
+typedef struct {
+    const char *name;
+    sched_fn_t fn;
+    void *arg;
+    uint32_t deadline;
+    uint32_t period;
+    uint32_t event_mask;
+    uint32_t events;
+    uint8_t next;           // next task in the same wheel slot
+    uint8_t flags;
+    sched_stats_t stats;
+} sched_task_t;
+
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static uint8_t wheel[SCHED_WHEEL_SLOTS];
+static uint8_t n_tasks;
+static uint32_t wheel_time;
+static uint32_t ready;
+static volatile uint32_t pending_events;
+static sched_id_t current = SCHED_NO_TASK;
+static sched_clock_t now_fn;
+static sched_clock_t stat_fn;
+static sched_hook_t run_hook;
+
+
+/*Wrap-safe "a is at or before b"*/
+static bool time_reached(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) <= 0;
+}
+
+
+/*Unlink a task from its wheel slot*/
+static void wheel_remove(sched_id_t id) {
+    uint8_t *link = &wheel[tasks[id].deadline & WHEEL_MASK];
+    while (*link != SCHED_NO_TASK) {
+        if (*link == id) {
+            *link = tasks[id].next;
+            break;
+        }
+        link = &tasks[*link].next;
+    }
+    tasks[id].next = SCHED_NO_TASK;
+    tasks[id].flags &= ~TASK_ARMED;
+}
+
+
+/*Hash a task into the wheel, or mark it ready if already due*/
+static void wheel_insert(sched_id_t id, uint32_t deadline) {
+    sched_task_t *t = &tasks[id];
+    t->deadline = deadline;
+    t->flags |= TASK_ARMED;
+    if (time_reached(deadline, wheel_time)) {
+        t->flags = (t->flags & ~TASK_ARMED) | TASK_FIRED;
+        ready |= (1u << id);
+        return;
+    }
+    uint8_t *slot = &wheel[deadline & WHEEL_MASK];
+    t->next = *slot;
+    *slot = id;
+}
+
+
+/*Move every due task in one slot to the ready set*/
+static void wheel_expire_slot(uint32_t slot, uint32_t now) {
+    uint8_t *link = &wheel[slot];
+    while (*link != SCHED_NO_TASK) {
+        sched_id_t id = *link;
+        sched_task_t *t = &tasks[id];
+        if (time_reached(t->deadline, now)) {
+            *link = t->next;
+            t->next = SCHED_NO_TASK;
+            t->flags = (t->flags & ~TASK_ARMED) | TASK_FIRED;
+            ready |= (1u << id);
+        } else {
+            link = &t->next;
+        }
+    }
+}
+
+
+/*Advance the wheel to 'now', expiring timers on the way*/
+static void wheel_advance(uint32_t now) {
+    uint32_t gap = now - wheel_time;
+    if (gap >= SCHED_WHEEL_SLOTS) {
+        // Slept through a full rotation: every slot has to be visited anyway
+        for (uint32_t s = 0; s < SCHED_WHEEL_SLOTS; s++) {
+            wheel_expire_slot(s, now);
+        }
+        wheel_time = now;
+        return;
+    }
+    while (wheel_time != now) {
+        wheel_time++;
+        wheel_expire_slot(wheel_time & WHEEL_MASK, now);
+    }
+}
+
+
+static sched_id_t add_task(const char *name, sched_fn_t fn, void *arg) {
+    if (n_tasks >= SCHED_MAX_TASKS) {
+        return SCHED_NO_TASK;
+    }
+    sched_id_t id = n_tasks++;
+    sched_task_t *t = &tasks[id];
+    memset(t, 0, sizeof(*t));
+    t->name = name;
+    t->fn = fn;
+    t->arg = arg;
+    t->next = SCHED_NO_TASK;
+    t->flags = TASK_USED;
+    return id;
+}
+
+
+/*Reset the scheduler and bind it to a millisecond clock*/
+void SCHED_Init(sched_clock_t clock) {
+    memset(tasks, 0, sizeof(tasks));
+    memset(wheel, SCHED_NO_TASK, sizeof(wheel));
+    n_tasks = 0;
+    ready = 0;
+    pending_events = 0;
+    current = SCHED_NO_TASK;
+    now_fn = clock;
+    stat_fn = clock;
+    run_hook = NULL;
+    wheel_time = clock();
+}
+
+
+/*Use a finer clock for run time statistics*/
+void SCHED_SetStatClock(sched_clock_t clock) {
+    stat_fn = clock;
+}
+
+
+/*Call 'hook' after every task run with its run time (stat clock units)*/
+void SCHED_SetRunHook(sched_hook_t hook) {
+    run_hook = hook;
+}
+
+
+/*Add a task that runs every 'period' ticks, first after 'phase' ticks*/
+sched_id_t SCHED_AddPeriodic(const char *name, sched_fn_t fn, void *arg,
+                             uint32_t period, uint32_t phase) {
+    sched_id_t id = add_task(name, fn, arg);
+    if (id != SCHED_NO_TASK) {
+        tasks[id].period = period;
+        tasks[id].flags |= TASK_PERIODIC;
+        wheel_insert(id, wheel_time + phase);
+    }
+    return id;
+}
+
+
+/*Add a task that runs only when started or when a subscribed event fires*/
+sched_id_t SCHED_AddOneShot(const char *name, sched_fn_t fn, void *arg) {
+    return add_task(name, fn, arg);
+}
+
+
+/*Wake a task whenever any of the given event bits is posted*/
+void SCHED_Subscribe(sched_id_t id, uint32_t event_mask) {
+    if (id < n_tasks) {
+        tasks[id].event_mask |= event_mask;
+    }
+}
+
+
+/*(Re)arm a task's timer 'delay' ticks from now. A timer run that is
+  already pending is replaced; an event wake-up is kept.*/
+void SCHED_Start(sched_id_t id, uint32_t delay) {
+    if (id >= n_tasks) {
+        return;
+    }
+    if (tasks[id].flags & TASK_ARMED) {
+        wheel_remove(id);
+    }
+    if (tasks[id].flags & TASK_FIRED) {
+        tasks[id].flags &= ~TASK_FIRED;
+        if (!tasks[id].events) {
+            ready &= ~(1u << id);
+        }
+    }
+    wheel_insert(id, now_fn() + delay);
+}
+
+
+/*Disarm a task's timer and drop it from the ready set*/
+void SCHED_Stop(sched_id_t id) {
+    if (id >= n_tasks) {
+        return;
+    }
+    if (tasks[id].flags & TASK_ARMED) {
+        wheel_remove(id);
+    }
+    tasks[id].flags &= ~TASK_FIRED;
+    ready &= ~(1u << id);
+}
+
+
+/*Change a periodic task's period and restart its timer; 0 stops it*/
+void SCHED_SetPeriod(sched_id_t id, uint32_t period) {
+    if (id >= n_tasks || !(tasks[id].flags & TASK_PERIODIC)) {
+        return;
+    }
+    SCHED_Stop(id);
+    tasks[id].period = period;
+    if (period) {
+        SCHED_Start(id, period);
+    }
+}
+
+
+bool SCHED_IsArmed(sched_id_t id) {
+    return (id < n_tasks) && ((tasks[id].flags & TASK_ARMED) || (ready & (1u << id)));
+}
+
+
+/*Post event bits; safe to call from any interrupt priority*/
+void SCHED_PostEvent(uint32_t mask) {
+    __atomic_fetch_or(&pending_events, mask, __ATOMIC_RELEASE);
+}
+
+
+uint32_t SCHED_Events(void) {
+    return (current != SCHED_NO_TASK) ? tasks[current].events : 0;
+}
+
+
+sched_id_t SCHED_Current(void) {
+    return current;
+}
+
+
+uint32_t SCHED_Now(void) {
+    return now_fn();
+}
+
+
+/*Ticks until the scheduler next has work. Returns false if no timer is
+  armed and only an event can wake it up.*/
+bool SCHED_NextDeadline(uint32_t *ticks) {
+    if (ready || pending_events) {
+        *ticks = 0;
+        return true;
+    }
+
+    uint32_t now = now_fn();
+    bool found = false;
+    uint32_t best = 0;
+    for (sched_id_t id = 0; id < n_tasks; id++) {
+        if (!(tasks[id].flags & TASK_ARMED)) {
+            continue;
+        }
+        int32_t left = (int32_t)(tasks[id].deadline - now);
+        uint32_t wait = (left > 0) ? (uint32_t)left : 0;
+        if (!found || wait < best) {
+            best = wait;
+            found = true;
+        }
+    }
+    *ticks = best;
+    return found;
+}
+
+
+/*Run the highest priority ready task (lowest id). Returns false if idle.*/
+bool SCHED_RunOnce(void) {
+    uint32_t now = now_fn();
+    wheel_advance(now);
+
+    uint32_t ev = __atomic_exchange_n(&pending_events, 0, __ATOMIC_ACQUIRE);
+    if (ev) {
+        for (sched_id_t id = 0; id < n_tasks; id++) {
+            if (tasks[id].event_mask & ev) {
+                tasks[id].events |= tasks[id].event_mask & ev;
+                ready |= (1u << id);
+            }
+        }
+    }
+
+    if (!ready) {
+        return false;
+    }
+
+    sched_id_t id = (sched_id_t)__builtin_ctz(ready);
+    sched_task_t *t = &tasks[id];
+    ready &= ~(1u << id);
+
+    bool timed = (t->flags & TASK_FIRED) != 0;
+    t->flags &= ~TASK_FIRED;
+    if (timed) {
+        uint32_t late = now - t->deadline;
+        t->stats.late_last = late;
+        if (late > t->stats.late_max) {
+            t->stats.late_max = late;
+        }
+    }
+    if (timed && (t->flags & TASK_PERIODIC)) {
+        uint32_t next = t->deadline + t->period;
+        while ((int32_t)(next - now) < 0) {
+            next += t->period;
+            t->stats.missed++;
+        }
+        wheel_insert(id, next);
+    }
+
+    current = id;
+    uint32_t start = stat_fn();
+    t->fn(t->arg);
+    uint32_t run = stat_fn() - start;
+    current = SCHED_NO_TASK;
+    t->events = 0;
+
+    t->stats.runs++;
+    t->stats.run_last = run;
+    t->stats.run_total += run;
+    if (run > t->stats.run_max) {
+        t->stats.run_max = run;
+    }
+    if (run_hook) {
+        run_hook(id, run);
+    }
+    return true;
+}
+
+
+const sched_stats_t *SCHED_Stats(sched_id_t id) {
+    return (id < n_tasks) ? &tasks[id].stats : NULL;
+}
+
+
+const char *SCHED_Name(sched_id_t id) {
+    return (id < n_tasks) ? tasks[id].name : NULL;
+}
+
+
+void SCHED_ResetStats(void) {
+    for (sched_id_t id = 0; id < n_tasks; id++) {
+        memset(&tasks[id].stats, 0, sizeof(tasks[id].stats));
+    }
+}
+
+
+/*Print one line of statistics per task*/
+void SCHED_Dump(sched_print_t print) {
+    print("%-10s %6s %9s %8s %9s %6s\r\n",
+          "task", "runs", "run_max", "run_avg", "late_max", "missed");
+    for (sched_id_t id = 0; id < n_tasks; id++) {
+        const sched_stats_t *s = &tasks[id].stats;
+        uint32_t avg = s->runs ? (s->run_total / s->runs) : 0;
+        print("%-10s %6lu %9lu %8lu %9lu %6lu\r\n",
+              tasks[id].name,
+              (unsigned long)s->runs,
+              (unsigned long)s->run_max,
+              (unsigned long)avg,
+              (unsigned long)s->late_max,
+              (unsigned long)s->missed);
+    }
+}
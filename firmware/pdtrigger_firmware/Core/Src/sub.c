@@ -0,0 +1,220 @@
+#include "sub.h"
+#include "cmd.h"
+#include "crit.h"
+#include "fmt.h"
+#include <string.h>
+
+#ifdef PDT_HOST
+#define SUB_CEILING     1
+#else
+#include "main.h"
+#define SUB_CEILING     PRIO_DEFER      // shared between tasks only: no switch inside
+#endif
+
+typedef struct {
+    sub_mode_t mode;
+    uint32_t period;        // ms between samples
+    uint32_t next;          // ms, next sample due
+    bool sent;              // last[] is what the host has
+    uint8_t last[SUB_VALUE_MAX];
+} sub_state_t;
+
+static const sub_topic_t *topics;
+static uint8_t n_topics;
+static sched_clock_t now;
+static sub_state_t state[SUB_TOPICS_MAX];
+static sub_stats_t stats[SUB_TOPICS_MAX];
+
+
+void SUB_Init(const sub_topic_t *list, uint8_t count, sched_clock_t clock) {
+    topics = list;
+    n_topics = (count > SUB_TOPICS_MAX) ? SUB_TOPICS_MAX : count;
+    now = clock;
+    memset(state, 0, sizeof(state));
+    memset(stats, 0, sizeof(stats));
+}
+
+
+/*Subscribe one topic; the first sample is due at once*/
+const char *SUB_Set(uint8_t topic, sub_mode_t mode, uint32_t period_ms) {
+    crit_t c;
+
+    if (topic >= n_topics) {
+        return "topic";
+    }
+    if (mode == SUB_ON_CHANGE && period_ms == 0) {
+        period_ms = SUB_CHANGE_MS;
+    }
+    if (mode != SUB_OFF && (period_ms < SUB_MIN_MS || period_ms > SUB_MAX_MS)) {
+        return "range";
+    }
+    CRIT_Enter(&c, SUB_CEILING);
+    state[topic].mode = mode;
+    state[topic].period = period_ms;
+    state[topic].next = now();
+    state[topic].sent = false;
+    CRIT_Exit(&c);
+    return NULL;
+}
+
+
+/*sub [<topic|all> <ms|change|off> [ms]], see sub.h*/
+const char *SUB_Command(uint8_t argc, char *argv[]) {
+    sub_mode_t mode;
+    uint32_t ms = 0;
+    uint8_t first = 0, last = n_topics;
+
+    if (argc == 1) {
+        SUB_Dump(CMD_Printf);
+        return NULL;
+    }
+    if (argc < 3) {
+        return "arguments";
+    }
+    if (strcmp(argv[1], "all") != 0) {
+        for (first = 0; first < n_topics && strcmp(argv[1], topics[first].name) != 0; first++) {
+        }
+        if (first == n_topics) {
+            return "topic";
+        }
+        last = first + 1;
+    }
+    if (strcmp(argv[2], "off") == 0 && argc == 3) {
+        mode = SUB_OFF;
+    } else if (strcmp(argv[2], "change") == 0) {
+        mode = SUB_ON_CHANGE;
+        if (argc > 3 && !CMD_ParseU32(argv[3], &ms)) {
+            return "range";
+        }
+    } else if (argc == 3 && CMD_ParseU32(argv[2], &ms)) {
+        mode = ms ? SUB_PERIODIC : SUB_OFF;
+    } else {
+        return "arguments";
+    }
+    // Checked for one topic, so "all" is applied whole or not at all
+    const char *err = SUB_Set(first, mode, ms);
+    for (uint8_t i = first + 1; i < last && err == NULL; i++) {
+        err = SUB_Set(i, mode, ms);
+    }
+    return err;
+}
+
+
+/*Make the on-change topics in topic_mask due now; true if any is*/
+bool SUB_Changed(uint32_t topic_mask) {
+    bool due = false;
+    crit_t c;
+
+    CRIT_Enter(&c, SUB_CEILING);
+    uint32_t t = now();
+    for (uint8_t i = 0; i < n_topics; i++) {
+        if ((topic_mask & (1UL << i)) && state[i].mode == SUB_ON_CHANGE) {
+            state[i].next = t;
+            due = true;
+        }
+    }
+    CRIT_Exit(&c);
+    return due;
+}
+
+
+/*Sample one topic and send it if its mode asks for it*/
+static void run(uint8_t i) {
+    uint8_t value[SUB_VALUE_MAX];
+    sub_state_t *s = &state[i];
+    bool send;
+    crit_t c;
+
+    stats[i].samples++;
+    if (!topics[i].sample(value)) {
+        stats[i].failed++;
+        return;
+    }
+    CRIT_Enter(&c, SUB_CEILING);
+    send = s->mode != SUB_ON_CHANGE || !s->sent || memcmp(value, s->last, topics[i].size) != 0;
+    if (send) {
+        memcpy(s->last, value, topics[i].size);
+        s->sent = true;
+    }
+    CRIT_Exit(&c);
+    if (send) {
+        topics[i].emit(value);
+        stats[i].sent++;
+    } else {
+        stats[i].unchanged++;
+    }
+}
+
+
+/*Sample every due topic; returns ms until the next is due, 0 if none is on*/
+uint32_t SUB_Poll(void) {
+    uint32_t wait = 0;
+    crit_t c;
+
+    for (uint8_t i = 0; i < n_topics; i++) {
+        CRIT_Enter(&c, SUB_CEILING);
+        uint32_t t = now();
+        bool due = state[i].mode != SUB_OFF && (int32_t)(t - state[i].next) >= 0;
+        if (due) {
+            state[i].next = t + state[i].period;
+        }
+        CRIT_Exit(&c);
+        if (due) {
+            run(i);
+        }
+    }
+
+    // Samplers take time, and SUB_Changed may have run meanwhile
+    CRIT_Enter(&c, SUB_CEILING);
+    uint32_t t = now();
+    for (uint8_t i = 0; i < n_topics; i++) {
+        if (state[i].mode == SUB_OFF) {
+            continue;
+        }
+        int32_t left = (int32_t)(state[i].next - t);
+        uint32_t ms = (left > 0) ? (uint32_t)left : 1;
+        if (wait == 0 || ms < wait) {
+            wait = ms;
+        }
+    }
+    CRIT_Exit(&c);
+    return wait;
+}
+
+
+/*Topics that are not off, bit n for topic n*/
+uint32_t SUB_Active(void) {
+    uint32_t mask = 0;
+
+    for (uint8_t i = 0; i < n_topics; i++) {
+        if (state[i].mode != SUB_OFF) {
+            mask |= 1UL << i;
+        }
+    }
+    return mask;
+}
+
+
+const sub_stats_t *SUB_Stats(uint8_t topic) {
+    return (topic < n_topics) ? &stats[topic] : NULL;
+}
+
+
+void SUB_Dump(sched_print_t print) {
+    char how[20];
+
+    for (uint8_t i = 0; i < n_topics; i++) {
+        const sub_state_t *s = &state[i];
+        // As the "sub" command takes it: off, <ms> or change <ms>
+        if (s->mode == SUB_OFF) {
+            FMT_Format(how, sizeof(how), "off");
+        } else {
+            FMT_Format(how, sizeof(how), "%s%lu", (s->mode == SUB_ON_CHANGE) ? "change " : "",
+                       (unsigned long)s->period);
+        }
+        print("sub %s %s: %lu samples, %lu failed, %lu sent, %lu unchanged\r\n",
+              topics[i].name, how,
+              (unsigned long)stats[i].samples, (unsigned long)stats[i].failed,
+              (unsigned long)stats[i].sent, (unsigned long)stats[i].unchanged);
+    }
+}
@@ -0,0 +1,150 @@
+#include "supervisor.h"
+#include <string.h>
+
+#ifndef PDT_HOST
+#include "main.h"
+#endif
+
+typedef struct {
+    uint32_t budget;        // 0 = run time not checked
+    uint32_t window;        // 0 = not required for feeding
+    uint32_t last_checkin;
+    bool starving;
+    supervisor_stats_t stats;
+} watch_t;
+
+static watch_t watch[SCHED_MAX_TASKS];
+static uint32_t required;       // tasks that must check in before a feed
+static uint32_t checked;        // tasks that checked in since the last feed
+static uint32_t feeds;
+static sched_id_t last_over_id = SCHED_NO_TASK;
+static bool wdg_reset;          // the last reset came from the IWDG
+static sched_clock_t now_fn;
+static supervisor_feed_t feed_fn;
+
+
+void SUPERVISOR_Init(sched_clock_t clock, supervisor_feed_t feed) {
+    memset(watch, 0, sizeof(watch));
+    required = 0;
+    checked = 0;
+    feeds = 0;
+    last_over_id = SCHED_NO_TASK;
+    now_fn = clock;
+    feed_fn = feed;
+}
+
+
+/*Supervise a task: run time budget in stat clock units, check-in window in ms*/
+void SUPERVISOR_Watch(sched_id_t id, uint32_t budget, uint32_t window_ms) {
+    if (id >= SCHED_MAX_TASKS) {
+        return;
+    }
+    watch[id].budget = budget;
+    watch[id].window = window_ms;
+    watch[id].last_checkin = now_fn();
+    if (window_ms) {
+        required |= (1u << id);
+    } else {
+        required &= ~(1u << id);
+    }
+}
+
+
+/*Scheduler run hook: account the run and check the task in*/
+void SUPERVISOR_TaskDone(sched_id_t id, uint32_t run) {
+    if (id >= SCHED_MAX_TASKS) {
+        return;
+    }
+    watch_t *w = &watch[id];
+    if (run > w->stats.worst) {
+        w->stats.worst = run;
+    }
+    if (w->budget && run > w->budget) {
+        w->stats.overruns++;
+        w->stats.last_over = run;
+        last_over_id = id;
+    }
+    w->last_checkin = now_fn();
+    w->starving = false;
+    checked |= (1u << id);
+}
+
+
+/*Feed the watchdog if every required task has checked in. Returns true if fed.*/
+bool SUPERVISOR_Poll(void) {
+    uint32_t now = now_fn();
+    for (sched_id_t id = 0; id < SCHED_MAX_TASKS; id++) {
+        watch_t *w = &watch[id];
+        if (!(required & (1u << id)) || w->starving) {
+            continue;
+        }
+        if (now - w->last_checkin > w->window) {
+            w->starving = true;     // count once per episode
+            w->stats.starved++;
+        }
+    }
+
+    if ((checked & required) != required || feed_fn == NULL) {
+        return false;
+    }
+    feed_fn();
+    checked = 0;
+    feeds++;
+    return true;
+}
+
+
+const supervisor_stats_t *SUPERVISOR_Stats(sched_id_t id) {
+    return (id < SCHED_MAX_TASKS) ? &watch[id].stats : NULL;
+}
+
+
+/*Print feed count, reset cause and per-task overruns*/
+void SUPERVISOR_Dump(sched_print_t print) {
+    print("supervisor: %lu feeds, last reset %s\r\n",
+          (unsigned long)feeds, wdg_reset ? "IWDG" : "normal");
+    if (last_over_id != SCHED_NO_TASK) {
+        print("  last overrun: %s %lu\r\n", SCHED_Name(last_over_id),
+              (unsigned long)watch[last_over_id].stats.last_over);
+    }
+    print("  %-10s %8s %8s %8s %7s\r\n", "task", "budget", "worst", "overruns", "starved");
+    for (sched_id_t id = 0; id < SCHED_MAX_TASKS; id++) {
+        const watch_t *w = &watch[id];
+        if (!w->budget && !w->window) {
+            continue;
+        }
+        print("  %-10s %8lu %8lu %8lu %7lu\r\n", SCHED_Name(id),
+              (unsigned long)w->budget, (unsigned long)w->stats.worst,
+              (unsigned long)w->stats.overruns, (unsigned long)w->stats.starved);
+    }
+}
+
+
+#ifndef PDT_HOST
+/*Start the IWDG (LSI ~32 kHz / 32 = ~1 ms per count); it cannot be stopped*/
+void SUPERVISOR_IwdgStart(uint32_t timeout_ms) {
+    wdg_reset = (RCC->CSR & RCC_CSR_IWDGRSTF) != 0;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+#ifdef DEBUG
+    // Don't reset the target while halted in the debugger
+    DBGMCU->APB1FZ |= DBGMCU_APB1_FZ_DBG_IWDG_STOP;
+#endif
+
+    if (timeout_ms > IWDG_RLR_RL) {
+        timeout_ms = IWDG_RLR_RL;
+    }
+    IWDG->KR = 0xCCCC;              // start (enables LSI)
+    IWDG->KR = 0x5555;              // unlock PR/RLR
+    IWDG->PR = IWDG_PR_PR_1 | IWDG_PR_PR_0;  // /32
+    IWDG->RLR = timeout_ms;
+    while (IWDG->SR & (IWDG_SR_PVU | IWDG_SR_RVU)) {
+    }
+    IWDG->KR = 0xAAAA;
+}
+
+
+void SUPERVISOR_IwdgFeed(void) {
+    IWDG->KR = 0xAAAA;
+}
+#endif
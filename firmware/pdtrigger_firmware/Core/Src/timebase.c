@@ -0,0 +1,73 @@
+#include "timebase.h"
+
+#ifdef PDT_HOST
+
+void TIMEBASE_Init(void) {
+}
+
+
+void TIMEBASE_Reclock(void) {
+}
+
+
+uint32_t TIMEBASE_Micros(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000U);
+}
+
+#else
+
+static TIM_HandleTypeDef htim5;
+
+
+/*TIM5 kernel clock: APB1 timers run at 2x PCLK1 when APB1 is divided*/
+static uint32_t tim5_clock(void) {
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1) {
+        pclk1 *= 2;
+    }
+    return pclk1;
+}
+
+
+/*Start TIM5 as a 1 MHz free-running counter and enable the DWT cycle counter*/
+void TIMEBASE_Init(void) {
+    // SystemInit already started CYCCNT at reset; don't zero it (boot profile)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    htim5.Instance = TIM5;
+    htim5.Init.Prescaler = tim5_clock() / 1000000U - 1;
+    htim5.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim5.Init.Period = 0xFFFFFFFF;
+    htim5.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim5.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    if (HAL_TIM_Base_Init(&htim5) != HAL_OK) {
+        Error_Handler();
+    }
+    if (HAL_TIM_Base_Start(&htim5) != HAL_OK) {
+        Error_Handler();
+    }
+}
+
+
+/*Re-derive the prescaler after a system clock change, keeping the count*/
+void TIMEBASE_Reclock(void) {
+    uint32_t cnt = TIM5->CNT;
+    TIM5->PSC = tim5_clock() / 1000000U - 1;
+    TIM5->EGR = TIM_EGR_UG;     // load PSC now (this also zeroes CNT)
+    TIM5->CNT = cnt;
+}
+
+
+uint32_t TIMEBASE_Micros(void) {
+    return TIM5->CNT;
+}
+
+#endif
+
+
+uint32_t TIMEBASE_CyclesToNs(uint32_t cycles) {
+    return (uint32_t)(((uint64_t)cycles * 1000U) / TIMEBASE_CYCLES_PER_US);
+}
@@ -0,0 +1,261 @@
+#include "tlm.h"
+
+#ifdef PDT_TLM
+
+#include "crit.h"
+#include "timebase.h"
+
+#ifdef PDT_RTOS
+#include "app_rtos.h"
+#else
+#include "uarttx.h"
+#endif
+
+#ifdef PDT_HOST
+#define TLM_CEILING     1
+#define tlm_ms()        ((uint32_t)(TIMEBASE_Micros() / 1000U))
+#else
+#include "main.h"
+#define TLM_CEILING     PRIO_LOG
+#define tlm_ms()        HAL_GetTick()
+extern UART_HandleTypeDef huart2;
+#endif
+
+static uint8_t seq;
+static tlm_stats_t stats;
+
+// STATE encoder: last value per field, see tlm.h
+static const uint8_t field_size[TLM_FIELDS] = { 1, 1, 1, 2, 1, 4, 4, 4, 4, 4 };
+static uint32_t state[TLM_FIELDS];
+static uint16_t state_valid;        // fields recorded at least once
+static uint16_t state_dirty;        // changed since the last frame that carried them
+static uint16_t state_live;         // 'live' at the last flush
+static volatile bool key_due = true;
+static uint32_t key_at;             // ms of the last keyframe
+
+// CRC-16/CCITT-FALSE, one nibble at a time: 32 bytes of table
+static const uint16_t crc_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+
+uint16_t TLM_Crc16(uint16_t crc, const uint8_t *p, uint16_t len) {
+    while (len--) {
+        crc = (uint16_t)(crc << 4) ^ crc_nibble[(crc >> 12) ^ (*p >> 4)];
+        crc = (uint16_t)(crc << 4) ^ crc_nibble[(crc >> 12) ^ (*p & 0x0F)];
+        p++;
+    }
+    return crc;
+}
+
+
+// COBS encoder state: 'code' points at the pending length byte
+typedef struct {
+    uint8_t *out;
+    uint8_t *code;
+} cobs_t;
+
+static void cobs_put(cobs_t *c, uint8_t b) {
+    if (b != 0) {
+        *c->out++ = b;
+    }
+    if (b == 0 || c->out - c->code == 0xFF) {
+        *c->code = (uint8_t)(c->out - c->code);
+        c->code = c->out++;
+    }
+}
+
+
+/*Build one wire frame (COBS, delimiter included) into 'wire', which must
+  hold TLM_WIRE_MAX bytes; returns its length*/
+uint16_t TLM_Encode(uint8_t *wire, tlm_msg_t type, uint8_t seq_no,
+                    const uint8_t *payload, uint16_t len) {
+    cobs_t c = { wire + 1, wire };
+    uint8_t hdr[2] = { (uint8_t)type, seq_no };
+    uint16_t crc = TLM_Crc16(0xFFFF, hdr, 2);
+
+    crc = TLM_Crc16(crc, payload, len);
+    cobs_put(&c, hdr[0]);
+    cobs_put(&c, hdr[1]);
+    for (uint16_t i = 0; i < len; i++) {
+        cobs_put(&c, payload[i]);
+    }
+    cobs_put(&c, (uint8_t)crc);
+    cobs_put(&c, (uint8_t)(crc >> 8));
+    *c.code = (uint8_t)(c.out - c.code);
+    *c.out++ = 0;
+    return (uint16_t)(c.out - wire);
+}
+
+
+/*Frame and queue one message; false if the UART path refused it*/
+bool TLM_Send(tlm_msg_t type, const uint8_t *payload, uint16_t len) {
+    uint8_t wire[TLM_WIRE_MAX];
+    uint8_t s;
+    bool ok = true;
+    crit_t c;
+
+    if (len > TLM_PAYLOAD_MAX) {
+        return false;
+    }
+#ifndef PDT_HOST
+    if (huart2.gState == HAL_UART_STATE_RESET) {
+        return false;   // boot fast path: UART not brought up yet
+    }
+#endif
+    CRIT_Enter(&c, TLM_CEILING);
+    s = seq++;
+    CRIT_Exit(&c);
+
+    uint16_t n = TLM_Encode(wire, type, s, payload, len);
+#ifdef PDT_RTOS
+    ok = APP_RTOS_Log((const char *)wire, n);
+#else
+    ok = UARTTX_Write((const char *)wire, n) == n;
+#endif
+    CRIT_Enter(&c, TLM_CEILING);
+    if (ok) {
+        stats.frames++;
+        stats.bytes += n;
+    } else {
+        stats.dropped++;
+    }
+    CRIT_Exit(&c);
+    return ok;
+}
+
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+    p = put16(p, (uint16_t)v);
+    return put16(p, (uint16_t)(v >> 16));
+}
+
+
+void TLM_Hello(void) {
+    uint8_t msg[6];
+    uint8_t build = 0;
+
+#ifdef PDT_RTOS
+    build |= TLM_BUILD_RTOS;
+#endif
+#ifdef PDT_ISR_ONLY
+    build |= TLM_BUILD_ISR_ONLY;
+#endif
+#ifdef DEBUG
+    build |= TLM_BUILD_DEBUG;
+#endif
+    msg[0] = TLM_SCHEMA;
+    msg[1] = build;
+    put32(&msg[2], tlm_ms());
+    TLM_Send(TLM_MSG_HELLO, msg, sizeof(msg));
+    key_due = true;         // a host that starts at this HELLO gets the full state next
+}
+
+
+void TLM_Status(uint8_t flags, uint8_t pdo_index, uint8_t pdo_target, uint16_t mv) {
+    uint8_t msg[9];
+    uint8_t *p = put32(msg, tlm_ms());
+
+    *p++ = flags;
+    *p++ = pdo_index;
+    *p++ = pdo_target;
+    put16(p, mv);
+    TLM_Send(TLM_MSG_STATUS, msg, sizeof(msg));
+}
+
+
+void TLM_Event(tlm_event_t event, uint8_t arg, uint16_t mv) {
+    uint8_t msg[8];
+    uint8_t *p = put32(msg, tlm_ms());
+
+    *p++ = (uint8_t)event;
+    *p++ = arg;
+    put16(p, mv);
+    TLM_Send(TLM_MSG_EVENT, msg, sizeof(msg));
+}
+
+
+/*Record a field's current value; it goes out with the next flush if it
+  differs from what was sent last*/
+void TLM_State(tlm_field_t f, uint32_t value) {
+    uint16_t bit = (uint16_t)TLM_FIELD(f);
+
+    if (!(state_valid & bit) || state[f] != value) {
+        state[f] = value;
+        state_dirty |= bit;
+    }
+    state_valid |= bit;
+}
+
+
+/*Send the changed fields among 'live' (TLM_FIELD bits of the subscribed
+  topics), or all of them when a keyframe is due. A frame the UART path
+  refuses leaves its fields dirty for the next one.*/
+void TLM_StateFlush(uint32_t live) {
+    uint8_t msg[6 + 4 * TLM_FIELDS];
+    uint32_t t = tlm_ms();
+    bool key = key_due || (t - key_at) >= TLM_KEY_MS;
+    key_due = false;        // a HELLO from now on asks for the next one
+    uint16_t mask = key ? (uint16_t)live : (uint16_t)((state_dirty | (live & ~state_live)) & live);
+
+    state_live = live;
+    mask &= state_valid;
+    if (mask == 0) {
+        key_due = key_due || key;
+        return;
+    }
+    uint8_t *p = put16(put32(msg, t), (uint16_t)(mask | (key ? TLM_STATE_KEY : 0)));
+    for (uint8_t f = 0; f < TLM_FIELDS; f++) {
+        if (!(mask & TLM_FIELD(f))) {
+            continue;
+        }
+        switch (field_size[f]) {
+        case 1: *p++ = (uint8_t)state[f]; break;
+        case 2: p = put16(p, (uint16_t)state[f]); break;
+        default: p = put32(p, state[f]); break;
+        }
+    }
+    if (!TLM_Send(TLM_MSG_STATE, msg, (uint16_t)(p - msg))) {
+        key_due = key_due || key;
+        return;
+    }
+    state_dirty &= (uint16_t)~mask;
+    stats.states++;
+    if (key) {
+        key_at = t;
+        stats.keyframes++;
+    }
+}
+
+
+/*Log text, split into TLM_PAYLOAD_MAX frames*/
+void TLM_Text(const char *buf, uint16_t len) {
+    while (len) {
+        uint16_t n = (len > TLM_PAYLOAD_MAX) ? TLM_PAYLOAD_MAX : len;
+        TLM_Send(TLM_MSG_TEXT, (const uint8_t *)buf, n);
+        buf += n;
+        len -= n;
+    }
+}
+
+
+const tlm_stats_t *TLM_Stats(void) {
+    return &stats;
+}
+
+
+void TLM_Dump(sched_print_t print) {
+    print("tlm schema %u: %lu frames, %lu bytes, %lu dropped, %lu state (%lu key)\r\n", TLM_SCHEMA,
+          (unsigned long)stats.frames, (unsigned long)stats.bytes,
+          (unsigned long)stats.dropped, (unsigned long)stats.states,
+          (unsigned long)stats.keyframes);
+}
+
+#endif /* PDT_TLM */
@@ -0,0 +1,274 @@
+#include "uarttx.h"
+#include "crit.h"
+#include "timebase.h"
+#include <string.h>
+
+#ifdef PDT_HOST
+#define TX_CEILING      1
+#else
+#include "main.h"
+#include "cmd.h"
+#include "link.h"
+#define TX_CEILING      PRIO_LOG
+extern UART_HandleTypeDef huart2;
+#endif
+
+#define RING_MASK       (UARTTX_RING_SIZE - 1)
+
+static char ring[UARTTX_RING_SIZE];
+static uint32_t head;               // free-running; writers only
+static uint32_t tail;               // free-running; advanced when a chunk starts
+static char dma_buf[UARTTX_CHUNK];  // the chunk in flight
+static volatile uint16_t inflight;  // bytes in dma_buf, 0 = DMA idle
+static volatile bool suspended;
+static uarttx_policy_t policy;
+static uarttx_stats_t stats;
+
+static const char *const policy_names[] = { "drop-newest", "drop-oldest", "block" };
+
+#ifdef PDT_HOST
+static uint32_t sim_baud = 115200;
+static FILE *sim_out;
+static uint32_t sim_start;
+
+static bool tx_start(uint16_t len) {
+    sim_start = TIMEBASE_Micros();
+    return true;
+}
+
+/*Complete the chunk once the wire would have carried it (8N1: 10 bits per byte)*/
+static void tx_service(void) {
+    if (inflight == 0) {
+        return;
+    }
+    uint64_t need_us = (uint64_t)inflight * 10U * 1000000U / sim_baud;
+    if (TIMEBASE_Elapsed(sim_start) >= need_us) {
+        if (sim_out != NULL) {
+            fwrite(dma_buf, 1, inflight, sim_out);
+        }
+        UARTTX_TxDone();
+    }
+}
+
+static bool tx_can_wait(void) {
+    return true;
+}
+
+void UARTTX_SimInit(uint32_t baud, FILE *out) {
+    sim_baud = baud;
+    sim_out = out;
+}
+#else
+static bool tx_start(uint16_t len) {
+    return HAL_UART_Transmit_DMA(&huart2, (uint8_t *)dma_buf, len) == HAL_OK;
+}
+
+static void tx_service(void) {
+}
+
+/*True if the DMA interrupt can preempt the caller, so waiting terminates*/
+static bool tx_can_wait(void) {
+    uint32_t basepri = __get_BASEPRI() >> (8U - __NVIC_PRIO_BITS);
+    if (__get_PRIMASK() || (basepri != 0 && basepri <= PRIO_LOG)) {
+        return false;
+    }
+    uint32_t ipsr = __get_IPSR();
+    if (ipsr == 0) {
+        return true;
+    }
+    return NVIC_GetPriority((IRQn_Type)((int32_t)ipsr - 16)) > PRIO_LOG;
+}
+#endif
+
+
+/*Move the next chunk into dma_buf and start it; caller holds the ring*/
+static void kick(void) {
+    uint32_t used = head - tail;
+    if (inflight || suspended || used == 0) {
+        return;
+    }
+    uint16_t n = (used > UARTTX_CHUNK) ? UARTTX_CHUNK : (uint16_t)used;
+    uint32_t at = tail & RING_MASK;
+    uint32_t first = UARTTX_RING_SIZE - at;
+    if (first >= n) {
+        memcpy(dma_buf, &ring[at], n);
+    } else {
+        memcpy(dma_buf, &ring[at], first);
+        memcpy(dma_buf + first, ring, n - first);
+    }
+    inflight = n;
+    if (tx_start(n)) {
+        tail += n;
+    } else {
+        inflight = 0;   // UART busy (being re-initialised); next write retries
+    }
+}
+
+
+void UARTTX_Init(uarttx_policy_t p) {
+    head = tail = 0;
+    inflight = 0;
+    suspended = false;
+    policy = p;
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+void UARTTX_SetPolicy(uarttx_policy_t p) {
+    policy = p;
+}
+
+
+/*Queue 'len' bytes; returns how many were accepted*/
+uint16_t UARTTX_Write(const char *buf, uint16_t len) {
+    crit_t c;
+    bool waited = false;
+    bool can_wait = tx_can_wait();  // before raising BASEPRI ourselves
+
+    if (len > UARTTX_RING_SIZE) {
+        stats.dropped += len - UARTTX_RING_SIZE;
+        buf += len - UARTTX_RING_SIZE;      // the tail end is the newest
+        len = UARTTX_RING_SIZE;
+    }
+
+    for (;;) {
+        CRIT_Enter(&c, TX_CEILING);
+        tx_service();
+        uint32_t room = UARTTX_RING_SIZE - (head - tail);
+        if (room >= len) {
+            break;
+        }
+        if (policy == UARTTX_DROP_OLDEST) {
+            stats.dropped += len - room;
+            tail += len - room;
+            break;
+        }
+        if (policy == UARTTX_DROP_NEWEST || !can_wait) {
+            stats.dropped += len;
+            CRIT_Exit(&c);
+            return 0;
+        }
+        kick();
+        CRIT_Exit(&c);
+        if (!waited) {
+            stats.blocked++;
+            waited = true;
+        }
+    }
+
+    uint32_t at = head & RING_MASK;
+    uint32_t first = UARTTX_RING_SIZE - at;
+    if (first >= len) {
+        memcpy(&ring[at], buf, len);
+    } else {
+        memcpy(&ring[at], buf, first);
+        memcpy(ring, buf + first, len - first);
+    }
+    head += len;
+    stats.written += len;
+    if (head - tail > stats.high_water) {
+        stats.high_water = (uint16_t)(head - tail);
+    }
+    kick();
+    CRIT_Exit(&c);
+    return len;
+}
+
+
+/*Bytes queued or in flight*/
+uint32_t UARTTX_Pending(void) {
+    crit_t c;
+    CRIT_Enter(&c, TX_CEILING);
+    tx_service();
+    uint32_t n = (head - tail) + inflight;
+    CRIT_Exit(&c);
+    return n;
+}
+
+
+/*Wait until everything written so far is on the wire (e.g. before a reset)*/
+void UARTTX_Flush(void) {
+    if (!tx_can_wait()) {
+        return;
+    }
+    while (UARTTX_Pending()) {
+    }
+}
+
+
+/*Let the chunk in flight finish and hold the rest, so USART2 can be
+  re-initialised (clock switch). Waits at most one chunk time.*/
+void UARTTX_Suspend(void) {
+    suspended = true;
+    while (inflight && tx_can_wait()) {
+        tx_service();
+    }
+}
+
+
+void UARTTX_Resume(void) {
+    crit_t c;
+    CRIT_Enter(&c, TX_CEILING);
+    suspended = false;
+    kick();
+    CRIT_Exit(&c);
+}
+
+
+static void chunk_done(bool ok) {
+    if (ok) {
+        stats.sent += inflight;
+    } else {
+        stats.errors++;
+        stats.dropped += inflight;
+    }
+    inflight = 0;
+    kick();
+}
+
+
+/*Transfer complete (USART2 TC interrupt, PRIO_LOG): start the next chunk*/
+void UARTTX_TxDone(void) {
+    chunk_done(true);
+}
+
+#ifndef PDT_HOST
+/*DMA done and the last stop bit is out*/
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    if (huart == &huart2) {
+        UARTTX_TxDone();
+    }
+}
+
+
+/*A DMA transfer error aborts the transmit; drop the chunk and go on*/
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    if (huart == &huart2 && inflight && huart->gState == HAL_UART_STATE_READY) {
+        chunk_done(false);
+    }
+    if (huart == &huart2 && (huart->ErrorCode & (HAL_UART_ERROR_FE | HAL_UART_ERROR_NE))) {
+        LINK_RxError();     // what a rate mismatch looks like
+    }
+    CMD_RxError(huart);     // RX errors stop DMA reception
+}
+#endif
+
+
+const uarttx_stats_t *UARTTX_Stats(void) {
+    return &stats;
+}
+
+
+/*Print throughput and loss counters*/
+void UARTTX_Dump(sched_print_t print) {
+    crit_t c;
+    CRIT_Enter(&c, TX_CEILING);
+    uarttx_stats_t s = stats;
+    uint32_t queued = head - tail;
+    CRIT_Exit(&c);
+    print("uart tx (%s): %lu written, %lu sent, %lu dropped, %lu blocked, %lu errors\r\n",
+          policy_names[policy], (unsigned long)s.written, (unsigned long)s.sent,
+          (unsigned long)s.dropped, (unsigned long)s.blocked, (unsigned long)s.errors);
+    print("  queued %lu, high water %u/%u\r\n",
+          (unsigned long)queued, s.high_water, UARTTX_RING_SIZE);
+}
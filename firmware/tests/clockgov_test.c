@@ -0,0 +1,158 @@
+// clockgov_test - clockgov.c on a virtual clock with a stubbed clock switch:
+// CLOCKGOV_Decide on its own, then bursts through CLOCKGOV_Request and
+// CLOCKGOV_Update as the idle path drives them, and the accounting.
+
+#include "clockgov.h"
+#include "test.h"
+
+static uint32_t vt;
+static int applied;                 // successful switches seen by the stub
+static clk_state_t hw;              // what the stub last switched to
+static bool fail;                   // the next switches fail
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static bool apply(clk_state_t next) {
+    if (fail) {
+        return false;
+    }
+    hw = next;
+    applied++;
+    return true;
+}
+
+static void reset(void) {
+    vt = 0xFFFFFF00u;               // wraps during most cases
+    applied = 0;
+    hw = CLK_LOW;
+    fail = false;
+    CLOCKGOV_Init(apply, clock_ms, CLK_LOW);
+}
+
+/*The idle path: re-evaluate every millisecond*/
+static void step(uint32_t ms) {
+    while (ms--) {
+        vt++;
+        CLOCKGOV_Update();
+    }
+}
+
+/*Milliseconds until the governor drops back to low, at most 'limit'*/
+static uint32_t time_to_low(uint32_t limit) {
+    uint32_t t = 0;
+    while (CLOCKGOV_State() == CLK_HIGH && t < limit) {
+        step(1);
+        t++;
+    }
+    return t;
+}
+
+
+static void test_decide(void) {
+    uint32_t t = 0xFFFFFFF0u;
+
+    // Inside a burst: high, whatever the state
+    CHECK_EQ(CLOCKGOV_Decide(CLK_LOW, t, t + 1, 0), CLK_HIGH);
+    CHECK_EQ(CLOCKGOV_Decide(CLK_HIGH, t, t + 100, t), CLK_HIGH);
+    // Burst over, dwell not: stays high; but never raises a low clock
+    CHECK_EQ(CLOCKGOV_Decide(CLK_HIGH, t + 10, t, t), CLK_HIGH);
+    CHECK_EQ(CLOCKGOV_Decide(CLK_LOW, t + 10, t, t), CLK_LOW);
+    CHECK_EQ(CLOCKGOV_Decide(CLK_HIGH, t + CLOCKGOV_MIN_HIGH_MS - 1, t, t), CLK_HIGH);
+    CHECK_EQ(CLOCKGOV_Decide(CLK_HIGH, t + CLOCKGOV_MIN_HIGH_MS, t, t), CLK_LOW);
+    // Burst ending exactly now is over
+    CHECK_EQ(CLOCKGOV_Decide(CLK_HIGH, t + 200, t + 200, t), CLK_LOW);
+    CHECK_EQ(CLOCKGOV_Decide(CLK_LOW, t, t, t), CLK_LOW);
+}
+
+
+static void test_ramps_up_at_once(void) {
+    reset();
+    step(5);
+    CHECK_EQ(CLOCKGOV_State(), CLK_LOW);
+    CHECK_EQ(applied, 0);
+    CLOCKGOV_Request(BURST_NEGOTIATION, 200);
+    CHECK_EQ(CLOCKGOV_State(), CLK_HIGH);   // in the call, not at the next update
+    CHECK_EQ(hw, CLK_HIGH);
+    CHECK_EQ(applied, 1);
+    CLOCKGOV_Request(BURST_NEGOTIATION, 10); // already high: no second switch
+    CHECK_EQ(applied, 1);
+}
+
+
+/*Down only once both the hold and the minimum dwell have passed*/
+static void test_hold_and_dwell(void) {
+    reset();
+    CLOCKGOV_Request(BURST_TELEMETRY, 10);  // shorter than the dwell
+    CHECK_EQ(time_to_low(1000), CLOCKGOV_MIN_HIGH_MS);
+
+    reset();
+    CLOCKGOV_Request(BURST_TELEMETRY, 200); // longer than the dwell
+    CHECK_EQ(time_to_low(1000), 200);
+    CHECK_EQ(hw, CLK_LOW);
+    CHECK_EQ(applied, 2);
+
+    reset();
+    CLOCKGOV_Request(BURST_TELEMETRY, 0);   // a zero hold still gets the dwell
+    CHECK_EQ(CLOCKGOV_State(), CLK_HIGH);
+    CHECK_EQ(time_to_low(1000), CLOCKGOV_MIN_HIGH_MS);
+}
+
+
+static void test_overlapping_bursts(void) {
+    reset();
+    CLOCKGOV_Request(BURST_NEGOTIATION, 100);
+    step(60);
+    CLOCKGOV_Request(BURST_TELEMETRY, 100); // extends to 160
+    step(60);
+    CLOCKGOV_Request(BURST_NEGOTIATION, 10); // inside the hold: no shorter
+    CHECK_EQ(time_to_low(1000), 40);
+    CHECK_EQ(applied, 2);                   // one up, one down
+}
+
+
+static void test_accounting(void) {
+    const clockgov_stats_t *st;
+
+    reset();
+    step(100);                              // low
+    CLOCKGOV_Request(BURST_NEGOTIATION, 200);
+    step(300);                              // 200 high, 100 low
+    CLOCKGOV_Request(BURST_TELEMETRY, 20);
+    CLOCKGOV_Request(BURST_TELEMETRY, 20);
+    step(100);                              // 50 high (dwell), 50 low
+    st = CLOCKGOV_Stats();
+    CHECK_EQ(st->switches, 4);
+    CHECK_EQ(st->failures, 0);
+    CHECK_EQ(st->bursts[BURST_NEGOTIATION], 1);
+    CHECK_EQ(st->bursts[BURST_TELEMETRY], 2);
+    CHECK_EQ(st->time_ms[CLK_HIGH], 200 + CLOCKGOV_MIN_HIGH_MS);
+    // Time in the current state is added when it is left
+    CHECK_EQ(st->time_ms[CLK_LOW], 100 + 100);
+
+    // A switch that fails leaves the state and the time alone, and is
+    // retried by the next update
+    fail = true;
+    CLOCKGOV_Request(BURST_NEGOTIATION, 100);
+    CHECK_EQ(CLOCKGOV_State(), CLK_LOW);
+    CHECK_EQ(st->failures, 1);
+    CHECK_EQ(st->bursts[BURST_NEGOTIATION], 2);
+    step(1);
+    CHECK_EQ(st->failures, 2);
+    fail = false;
+    step(1);
+    CHECK_EQ(CLOCKGOV_State(), CLK_HIGH);
+    CHECK_EQ(st->switches, 5);
+    CHECK_EQ(st->time_ms[CLK_LOW], 100 + 100 + 50 + 2);
+}
+
+
+int main(void) {
+    test_decide();
+    test_ramps_up_at_once();
+    test_hold_and_dwell();
+    test_overlapping_bursts();
+    test_accounting();
+    return TEST_Done("clockgov_test");
+}
@@ -0,0 +1,252 @@
+// cmd_test - cmd.c fed a recorded RX stream the way the UART delivers it:
+// cut at every byte into two RX events, one event per byte, several lines
+// merged into one event, over-long lines and a ring that overflows
+// because CMD_Poll ran late. Replies are captured and compared whole.
+
+#include "cmd.h"
+#include "test.h"
+#include <stdarg.h>
+#include <string.h>
+
+static char out[2048];
+static size_t out_len;
+static char seen[512];          // what the handlers were called with
+
+static void reply(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    out_len += (size_t)vsnprintf(&out[out_len], sizeof(out) - out_len, fmt, args);
+    va_end(args);
+}
+
+static void note(const char *s) {
+    strncat(seen, s, sizeof(seen) - strlen(seen) - 1);
+}
+
+static const char *cmd_pdo(uint8_t argc, char *argv[]) {
+    uint32_t v;
+    char buf[16];
+
+    if (!CMD_ParseU32(argv[1], &v) || v > 4) {
+        return "range";
+    }
+    snprintf(buf, sizeof(buf), "pdo%u;", (unsigned)v);
+    note(buf);
+    return NULL;
+}
+
+static const char *cmd_rate(uint8_t argc, char *argv[]) {
+    note("rate ");
+    note(argv[1]);
+    note(" ");
+    note(argv[2]);
+    note(";");
+    return NULL;
+}
+
+static const char *cmd_status(uint8_t argc, char *argv[]) {
+    note("status;");
+    CMD_Printf("pdo %u/%u\r\n", 0, 0);
+    return NULL;
+}
+
+static const cmd_t table[] = {
+    { "pdo",    cmd_pdo,    1, 1, "<index>" },
+    { "rate",   cmd_rate,   2, 2, "<stream> <ms>" },
+    { "status", cmd_status, 0, 0, "" },
+};
+
+static void clear(void) {
+    out_len = 0;
+    out[0] = '\0';
+    seen[0] = '\0';
+}
+
+static void reset(void) {
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    clear();
+}
+
+static void feed(const char *s) {
+    CMD_Feed((const uint8_t *)s, (uint16_t)strlen(s));
+}
+
+// A session as a terminal and a script send it: CR, LF and CRLF endings,
+// runs of blanks, an empty line, and the usual mistakes
+static const char session[] = "pdo 2\r\nrate  vbus\t50\nstatus\r\n\r\nbogus 1\rpdo 9\npdo\n";
+static const char session_seen[] = "pdo2;rate vbus 50;status;";
+static const char session_out[] = "ok\r\nok\r\npdo 0/0\r\nok\r\nerr unknown command\r\n"
+                                  "err range\r\nerr arguments\r\n";
+
+
+static void test_parse_u32(void) {
+    uint32_t v = 0;
+
+    CHECK(CMD_ParseU32("123", &v) && v == 123);
+    CHECK(CMD_ParseU32("0x1F", &v) && v == 31);
+    CHECK(CMD_ParseU32("0XfF", &v) && v == 255);
+    CHECK(CMD_ParseU32("4294967295", &v) && v == 4294967295u);
+    CHECK(CMD_ParseU32("0xFFFFFFFF", &v) && v == 4294967295u);
+    CHECK(!CMD_ParseU32("", &v));
+    CHECK(!CMD_ParseU32("12a", &v));
+    CHECK(!CMD_ParseU32("0x", &v));
+    CHECK(!CMD_ParseU32("-1", &v));
+    CHECK(!CMD_ParseU32("4294967296", &v));
+    CHECK(!CMD_ParseU32("0x100000000", &v));
+}
+
+
+/*The session split into two RX events at every byte*/
+static void test_split_frames(void) {
+    int bad = 0;
+
+    for (size_t cut = 0; cut <= strlen(session); cut++) {
+        reset();
+        CMD_Feed((const uint8_t *)session, (uint16_t)cut);
+        CMD_Poll();
+        CMD_Feed((const uint8_t *)&session[cut], (uint16_t)(strlen(session) - cut));
+        CMD_Poll();
+        bad += strcmp(seen, session_seen) != 0 || strcmp(out, session_out) != 0;
+    }
+    CHECK_EQ(bad, 0);
+
+    // One RX event per byte, polled after each
+    reset();
+    for (const char *p = session; *p; p++) {
+        CMD_Feed((const uint8_t *)p, 1);
+        CMD_Poll();
+    }
+    CHECK(strcmp(seen, session_seen) == 0);
+    CHECK(strcmp(out, session_out) == 0);
+    CHECK_EQ(CMD_Stats()->lines, 3);
+    CHECK_EQ(CMD_Stats()->rejected, 3);
+    CHECK_EQ(CMD_Stats()->bytes, strlen(session));
+}
+
+
+/*Several lines in one RX event, or polled late: all run, in order*/
+static void test_merged_frames(void) {
+    reset();
+    feed("pdo 1\npdo 2\npdo 3\n");
+    CMD_Poll();
+    CHECK(strcmp(seen, "pdo1;pdo2;pdo3;") == 0);
+    CHECK(strcmp(out, "ok\r\nok\r\nok\r\n") == 0);
+
+    // A line only runs once its end has arrived
+    clear();
+    feed("pdo 4\npd");
+    CMD_Poll();
+    CHECK(strcmp(seen, "pdo4;") == 0);
+    feed("o 0\r");
+    CMD_Poll();
+    CHECK(strcmp(seen, "pdo4;pdo0;") == 0);
+    CMD_Poll();                                 // nothing new: nothing runs
+    CHECK_EQ(CMD_Stats()->lines, 5);
+}
+
+
+static void test_too_long(void) {
+    char longest[CMD_LINE_MAX + 2];
+
+    // CMD_LINE_MAX - 1 characters still fit
+    reset();
+    memset(longest, 'a', sizeof(longest));
+    memcpy(longest, "rate ", 5);
+    longest[25] = ' ';
+    strcpy(&longest[CMD_LINE_MAX - 1], "\n");
+    feed(longest);
+    CMD_Poll();
+    CHECK(strcmp(out, "ok\r\n") == 0);
+
+    // One more is discarded whole, however many events it takes, and the
+    // next line runs
+    clear();
+    strcpy(&longest[CMD_LINE_MAX - 1], "a");
+    feed(longest);
+    CMD_Poll();
+    CHECK_EQ(out_len, 0);
+    for (int i = 0; i < 100; i++) {
+        feed("x");
+        CMD_Poll();
+    }
+    feed("\r\npdo 4\n");
+    CMD_Poll();
+    CHECK(strcmp(out, "err too long\r\nok\r\n") == 0);
+    CHECK(strcmp(seen, "pdo4;") == 0);
+
+    // Too many words is an argument error, not a truncated command
+    clear();
+    feed("rate a b c d e f\n");
+    CMD_Poll();
+    CHECK(strcmp(out, "err arguments\r\n") == 0);
+    CHECK_EQ(seen[0], '\0');
+}
+
+
+/*CMD_Poll late enough for the ring to fill: the lines that fit run, the one
+  cut by the overflow is refused, and the stream is back in step after it*/
+static void test_overflow_recovery(void) {
+    reset();
+    for (int i = 0; i < 20; i++) {
+        feed("pdo 1\r\n");                      // 140 bytes into 128
+    }
+    CHECK_EQ(CMD_Stats()->overflows, 20 * 7 - CMD_RING_SIZE);
+    CMD_Poll();
+    CHECK_EQ(CMD_Stats()->lines, CMD_RING_SIZE / 7);
+    clear();
+    feed("pdo 2\npdo 0\n");                     // the rest of the cut line, then a new one
+    CMD_Poll();
+    CHECK(strcmp(out, "err overflow\r\nok\r\n") == 0);
+    CHECK(strcmp(seen, "pdo0;") == 0);
+
+    // Lost at a line start: it is the next line that cannot be trusted
+    reset();
+    for (int i = 0; i < CMD_RING_SIZE / 8; i++) {
+        feed("pdo 3\r\n\n");                    // exactly fills the ring
+    }
+    feed("pdo 4\n");                            // lost whole
+    CMD_Poll();
+    clear();
+    feed(" 1\npdo 2\n");
+    CMD_Poll();
+    CHECK(strcmp(out, "err overflow\r\nok\r\n") == 0);
+    CHECK(strcmp(seen, "pdo2;") == 0);
+
+    // Overflowing again after recovering is reported again
+    reset();
+    for (int i = 0; i < 20; i++) {
+        feed("pdo 1\r\n");
+    }
+    CMD_Poll();
+    feed("\n");
+    CMD_Poll();
+    for (int i = 0; i < 20; i++) {
+        feed("pdo 1\r\n");
+    }
+    CMD_Poll();
+    clear();
+    feed("\n");
+    CMD_Poll();
+    CHECK(strcmp(out, "err overflow\r\n") == 0);
+    CHECK_EQ(CMD_Stats()->overflows, 2 * (20 * 7 - CMD_RING_SIZE));
+}
+
+
+static void test_help(void) {
+    reset();
+    feed("help\n");
+    CMD_Poll();
+    CHECK(strcmp(out, "pdo <index>\r\nrate <stream> <ms>\r\nstatus \r\nok\r\n") == 0);
+}
+
+
+int main(void) {
+    test_parse_u32();
+    test_split_frames();
+    test_merged_frames();
+    test_too_long();
+    test_overflow_recovery();
+    test_help();
+    return TEST_Done("cmd_test");
+}
@@ -0,0 +1,194 @@
+// cmdtag_test - pipelined requests in cmd.c: line_tag's parsing of "#<id>",
+// dispatch with the tag taken off the words, replies prefixed per request,
+// and CMD_Defer/CMD_Complete answering out of order. Run under ASan and
+// UBSan like the rest, which is what the edge cases of the tag and word
+// splitting are here for.
+
+#include "cmd.h"
+#include "test.h"
+#include <stdarg.h>
+#include <string.h>
+
+static char out[2048];
+static size_t out_len;
+static cmd_token_t slow_token, slower_token;
+static int failures_seen;
+
+static void reply(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    out_len += (size_t)vsnprintf(&out[out_len], sizeof(out) - out_len, fmt, args);
+    va_end(args);
+}
+
+/*As main.c's dump_print: output for a deferred request, after its handler*/
+static void later(const cmd_token_t *token, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    CMD_Vprintf(token, fmt, args);
+    va_end(args);
+}
+
+static const char *cmd_slow(uint8_t argc, char *argv[]) {
+    return CMD_Defer(&slow_token);
+}
+
+static const char *cmd_slower(uint8_t argc, char *argv[]) {
+    return CMD_Defer(&slower_token);
+}
+
+static const char *cmd_info(uint8_t argc, char *argv[]) {
+    CMD_Printf("a=%s\r\n", argv[1]);
+    CMD_Printf("n=%u\r\n", argc);
+    return NULL;
+}
+
+static const cmd_t table[] = {
+    { "slow",   cmd_slow,   0, 0, "" },
+    { "slower", cmd_slower, 0, 0, "" },
+    { "info",   cmd_info,   1, 4, "<x> ..." },
+};
+
+/*Send a line and check the reply to it, whole*/
+static void expect(const char *line, const char *want, int at) {
+    out_len = 0;
+    out[0] = '\0';
+    CMD_Feed((const uint8_t *)line, (uint16_t)strlen(line));
+    CMD_Poll();
+    if (strcmp(out, want) != 0) {
+        printf("line %d: sent \"%s\"\n  got  \"%s\"\n  want \"%s\"\n", at, line, out, want);
+        failures_seen++;
+    }
+}
+
+#define EXPECT(line, want)  expect(line, want, __LINE__)
+
+
+static void test_tagged_replies(void) {
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    EXPECT("#2 info x\r\n", "#2 | a=x\r\n#2 | n=2\r\n#2 ok\r\n");
+    EXPECT("info y\n", "a=y\r\nn=2\r\nok\r\n");
+    EXPECT("#5\tinfo z\n", "#5 | a=z\r\n#5 | n=2\r\n#5 ok\r\n");
+    EXPECT("#9 nope\n", "#9 err unknown command\r\n");
+    EXPECT("#6 help\n", "#6 | slow \r\n#6 | slower \r\n#6 | info <x> ...\r\n#6 ok\r\n");
+    EXPECT("#0 info 0\n", "#0 | a=0\r\n#0 | n=2\r\n#0 ok\r\n");
+}
+
+
+/*What is and is not a tag*/
+static void test_line_tag(void) {
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    EXPECT("#7\n", "#7 err arguments\r\n");         // a tag and nothing else
+    EXPECT("#\n", "err tag\r\n");
+    EXPECT("# info x\n", "err tag\r\n");
+    EXPECT("#x info x\n", "err tag\r\n");
+    EXPECT("#12x info x\n", "err tag\r\n");
+    EXPECT("#4294967295 info x\n", "#4294967295 | a=x\r\n#4294967295 | n=2\r\n#4294967295 ok\r\n");
+    EXPECT("#4294967296 info x\n", "err tag\r\n");  // does not fit 32 bits
+    EXPECT("#12345678901 info x\n", "err tag\r\n"); // more digits than any id
+    EXPECT("#00000000001 info x\n", "err tag\r\n");
+    EXPECT("#0000000001 info x\n", "#1 | a=x\r\n#1 | n=2\r\n#1 ok\r\n");
+    EXPECT("info #3\n", "a=#3\r\nn=2\r\nok\r\n");  // only at the start of a line
+}
+
+
+/*The tag is not one of the words a command may have*/
+static void test_word_limits(void) {
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    EXPECT("info 1 2 3 4\n", "a=1\r\nn=5\r\nok\r\n");
+    EXPECT("info 1 2 3 4 5\n", "err arguments\r\n");
+    EXPECT("#3 info 1 2 3 4\n", "#3 | a=1\r\n#3 | n=5\r\n#3 ok\r\n");
+    EXPECT("#3 info 1 2 3 4 5\n", "#3 err arguments\r\n");
+    EXPECT("#3 info 1 2 3 4 5 6 7 8 9\n", "#3 err arguments\r\n");
+    EXPECT("#3 slow 1\n", "#3 err arguments\r\n");
+}
+
+
+/*Discarded lines still answer under their tag*/
+static void test_discarded(void) {
+    char line[CMD_LINE_MAX + 16];
+    uint8_t fill[CMD_RING_SIZE];
+
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    memset(line, 'y', sizeof(line));
+    memcpy(line, "#5 info ", 8);
+    strcpy(&line[CMD_LINE_MAX + 8], "\n");
+    EXPECT(line, "#5 err too long\r\n");
+    memcpy(line, "#4294967295 info ", 17);
+    EXPECT(line, "#4294967295 err too long\r\n");
+
+    // The tag itself cut off by the overflow: answered untagged
+    for (int i = 0; i < CMD_RING_SIZE / 8; i++) {
+        CMD_Feed((const uint8_t *)"#1 info\n", 8);
+    }
+    CMD_Feed((const uint8_t *)"#2 ", 3);            // lost
+    CMD_Poll();
+    EXPECT("info x\n#8 info x\n", "err overflow\r\n#8 | a=x\r\n#8 | n=2\r\n#8 ok\r\n");
+
+    for (int i = 0; i < CMD_RING_SIZE / 8; i++) {
+        CMD_Feed((const uint8_t *)"#1 info\n", 8);
+    }
+    CMD_Poll();
+    CMD_Feed((const uint8_t *)"#44 in", 6);
+    memset(fill, 'y', sizeof(fill));
+    CMD_Feed(fill, sizeof(fill));                   // fills up, the rest is lost
+    CMD_Poll();
+    EXPECT("\n", "#44 err overflow\r\n");
+}
+
+
+/*Deferred requests answer later, in any order, while others run*/
+static void test_defer(void) {
+    CMD_Init(table, sizeof(table) / sizeof(table[0]), reply);
+    EXPECT("#1 slow\r\n#2 info x\r\n", "#2 | a=x\r\n#2 | n=2\r\n#2 ok\r\n");
+    CHECK(slow_token.live);
+    CHECK(slow_token.tagged);
+    CHECK_EQ(slow_token.id, 1);
+    EXPECT("#3 slower\n", "");
+
+    out_len = 0;
+    later(&slower_token, "part %d\r\n", 1);
+    later(&slow_token, "part %d\r\n", 2);
+    CMD_Complete(&slower_token, "timeout");
+    CMD_Complete(&slow_token, NULL);
+    CHECK(strcmp(out, "#3 | part 1\r\n#1 | part 2\r\n#3 err timeout\r\n#1 ok\r\n") == 0);
+    CHECK(!slow_token.live);
+
+    // A spent token answers nothing, however often it is completed
+    out_len = 0;
+    out[0] = '\0';
+    CMD_Complete(&slow_token, "again");
+    CMD_Complete(&slow_token, NULL);
+    CHECK_EQ(out_len, 0);
+
+    // Untagged: the same, without prefixes
+    EXPECT("slow\n", "");
+    out_len = 0;
+    later(&slow_token, "late\r\n");
+    CMD_Complete(&slow_token, "timeout");
+    CHECK(strcmp(out, "late\r\nerr timeout\r\n") == 0);
+
+    // The tag of the deferred request does not leak into the next one
+    EXPECT("#77 slow\ninfo q\n", "a=q\r\nn=2\r\nok\r\n");
+    out_len = 0;
+    CMD_Complete(&slow_token, NULL);
+    CHECK(strcmp(out, "#77 ok\r\n") == 0);
+
+    const cmd_stats_t *st = CMD_Stats();
+    CHECK_EQ(st->deferred, 4);
+    CHECK_EQ(st->lines, 4);
+    CHECK_EQ(st->rejected, 2);
+}
+
+
+int main(void) {
+    test_tagged_replies();
+    test_line_tag();
+    test_word_limits();
+    test_discarded();
+    test_defer();
+    CHECK_EQ(failures_seen, 0);
+    return TEST_Done("cmdtag_test");
+}
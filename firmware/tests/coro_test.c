@@ -0,0 +1,165 @@
+// coro_test - coro.h sequences resumed from a scheduler task on a virtual
+// clock, re-armed with CORO_Remaining the way main.c's pdo_task is.
+
+#include "coro.h"
+#include "test.h"
+
+#define EVT_GO      0x1
+#define WAIT_MS     50
+#define SLEEP_MS    10
+
+static uint32_t vt;
+static coro_t co;
+static coro_status_t last;
+static sched_id_t id;
+static int stage;               // how far the body got
+static int cond;
+static bool timed_out;
+static uint32_t at[4];          // when stages 1..3 were reached
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static coro_status_t seq(coro_t *c) {
+    CORO_BEGIN(c);
+    stage = 1;
+    at[0] = vt;
+    CORO_AWAIT_EVENT_TIMEOUT(c, EVT_GO, WAIT_MS);
+    timed_out = CORO_TIMED_OUT(c);
+    stage = 2;
+    at[1] = vt;
+    CORO_SLEEP(c, SLEEP_MS);
+    stage = 3;
+    at[2] = vt;
+    CORO_AWAIT(c, cond);
+    stage = 4;
+    CORO_END(c);
+}
+
+static void task(void *arg) {
+    last = seq(&co);
+    // A wait without a deadline is resumed by an event or by the test
+    if (last == CORO_RUNNING && CORO_Remaining(&co)) {
+        SCHED_Start(id, CORO_Remaining(&co));
+    }
+}
+
+/*Fresh scheduler and sequence, started at once*/
+static void start(void) {
+    vt = 0xFFFFFFE0u;           // waits span the clock wrap
+    SCHED_Init(clock_ms);
+    id = SCHED_AddOneShot("seq", task, NULL);
+    SCHED_Subscribe(id, EVT_GO);
+    CORO_Reset(&co);
+    stage = 0;
+    cond = 0;
+    timed_out = false;
+    SCHED_Start(id, 0);
+    while (SCHED_RunOnce()) {
+    }
+}
+
+static void step(uint32_t ms) {
+    while (ms--) {
+        vt++;
+        while (SCHED_RunOnce()) {
+        }
+    }
+}
+
+
+static void test_await_event(void) {
+    start();
+    step(20);
+    CHECK_EQ(stage, 1);
+    CHECK_EQ(last, CORO_RUNNING);
+    CHECK_EQ(CORO_Remaining(&co), WAIT_MS - 20);
+    SCHED_PostEvent(EVT_GO);
+    step(1);
+    CHECK_EQ(stage, 2);
+    CHECK(!timed_out);
+    CHECK_EQ(at[1] - at[0], 21);
+    step(SLEEP_MS - 1);
+    CHECK_EQ(stage, 2);
+    step(1);
+    CHECK_EQ(stage, 3);
+    CHECK_EQ(at[2] - at[1], SLEEP_MS);
+    cond = 1;
+    SCHED_Start(id, 0);
+    step(1);
+    CHECK_EQ(stage, 4);
+    CHECK_EQ(last, CORO_DONE);
+    CHECK(CORO_IsDone(&co));
+    CHECK_EQ(seq(&co), CORO_DONE);          // resuming a finished one is harmless
+    CHECK_EQ(stage, 4);
+}
+
+
+static void test_timeout(void) {
+    start();
+    step(WAIT_MS - 1);
+    CHECK_EQ(stage, 1);
+    step(1);
+    CHECK_EQ(stage, 2);
+    CHECK(timed_out);
+    CHECK_EQ(at[1] - at[0], WAIT_MS);
+    step(SLEEP_MS);
+    CHECK_EQ(stage, 3);
+    // An event that arrives after the timeout is not taken as the wake-up
+    SCHED_PostEvent(EVT_GO);
+    step(5);
+    CHECK_EQ(stage, 3);
+}
+
+
+static void test_cancel(void) {
+    start();
+    step(30);
+    CHECK_EQ(stage, 1);
+    CORO_Cancel(&co);
+    CHECK(!CORO_IsDone(&co));               // takes effect on the next resume
+    SCHED_PostEvent(EVT_GO);
+    step(1);
+    CHECK_EQ(last, CORO_CANCELLED);
+    CHECK_EQ(stage, 1);                     // nothing after the wait ran
+    CHECK(CORO_IsDone(&co));
+    step(100);
+    CHECK_EQ(stage, 1);
+    CHECK_EQ(seq(&co), CORO_DONE);
+}
+
+
+static void test_reset(void) {
+    start();
+    step(WAIT_MS + 3);                      // timed out, sleeping
+    CHECK_EQ(stage, 2);
+    CORO_Reset(&co);                        // restart mid-sequence
+    SCHED_Start(id, 0);
+    step(1);
+    CHECK_EQ(stage, 1);
+    CHECK(!CORO_TIMED_OUT(&co));
+    CHECK_EQ(CORO_Remaining(&co), WAIT_MS);
+    SCHED_PostEvent(EVT_GO);
+    step(1);
+    CHECK_EQ(stage, 2);
+    CHECK(!timed_out);
+
+    // Reset also clears a pending cancel
+    CORO_Cancel(&co);
+    CORO_Reset(&co);
+    SCHED_Start(id, 0);
+    step(1);
+    CHECK_EQ(last, CORO_RUNNING);
+    CHECK_EQ(stage, 1);
+}
+
+
+int main(void) {
+    test_await_event();
+    test_timeout();
+    test_cancel();
+    test_reset();
+    CHECK_EQ(sizeof(coro_t), 8);
+    return TEST_Done("coro_test");
+}
@@ -0,0 +1,291 @@
+// cypd3177_test - the CYPD3177 driver against a register model of the
+// controller, and the boot decision main.c makes after a reset: adopt the
+// contract the controller still holds (CYPD3177_LiveContract), or request
+// BOOT_PDO_INDEX again with CYPD3177_ChangePDO.
+//
+// The model keeps its state across an MCU reset, as the real part does
+// when only the STM32 resets. Its source offers 5, 9, 12 and 15 V.
+
+#include "cypd3177.h"
+#include "log.h"
+#include "test.h"
+#include <string.h>
+
+// main.c's sink PDO table
+static const uint32_t pdos[] = { 0x0001912C, 0x0002D12C, 0x0003C12C, 0x0004B12C, 0x0006412C };
+#define PDO_COUNT   (sizeof(pdos) / sizeof(pdos[0]))
+
+// Source capabilities, with the dual-role/USB bits a charger sets on PDO 0
+static const uint32_t source_caps[] = { 0x2601912C, 0x0002D12C, 0x0003C12C, 0x0004B12C };
+#define PDO_PPS_5V9     0xC1A0A03Cu      // augmented (PPS) 3.3-5.9 V
+
+I2C_HandleTypeDef hi2c3;
+
+static struct {
+    uint8_t regs[0x2000];
+    bool nack;                  // controller not answering
+    int writes;                 // register writes since the last MCU reset
+    uint8_t settle_mv100;       // VBUS the bus heads for, 100 mV units
+} model;
+
+static void put32(uint16_t reg, uint32_t v) {
+    memcpy(&model.regs[reg], &v, 4);    // the controller is little endian too
+}
+
+static uint32_t get32(uint16_t reg) {
+    uint32_t v;
+    memcpy(&v, &model.regs[reg], 4);
+    return v;
+}
+
+/*Contract on 'pdo'; VBUS follows on model_settle unless 'settled'*/
+static void model_contract(uint32_t pdo, bool settled) {
+    put32(CYPD_PD_STATUS_REG, CYPD_CONTRACT_STATE | CYPD_PE_STATE);
+    put32(CYPD_CURRENT_PDO_REG, pdo);
+    model.settle_mv100 = (uint8_t)(PDO_MV(pdo) / 100);
+    if (settled) {
+        model.regs[CYPD_BUS_VOLTAGE_REG] = model.settle_mv100;
+    }
+}
+
+static void model_settle(void) {
+    model.regs[CYPD_BUS_VOLTAGE_REG] = model.settle_mv100;
+}
+
+/*Cold attach: the controller negotiates its default 5 V on its own*/
+static void model_power_on(void) {
+    memset(&model, 0, sizeof(model));
+    model.regs[CYPD_DEVICE_MODE_REG] = CYPD_DEVICE_ACTIVE;
+    model_contract(source_caps[0], true);
+}
+
+/*Only the STM32 resets; the controller and the contract carry on*/
+static void mcu_reset(void) {
+    model.writes = 0;
+}
+
+/*SELECT_SINK_PDO: take the highest voltage the source offers among the
+  enabled sink PDOs written to data memory*/
+static void model_select(uint8_t mask) {
+    uint32_t best = 0;
+    if (get32(CYPD_WRITE_DATA_MEM_REG) != 0x534E4B50) {    // "SNKP"
+        return;
+    }
+    for (int s = 0; s < 2; s++) {
+        uint32_t snk = get32(CYPD_WRITE_DATA_MEM_REG + 4 + 4 * s);
+        if (!(mask & (1u << s))) {
+            continue;
+        }
+        for (unsigned c = 0; c < sizeof(source_caps) / sizeof(source_caps[0]); c++) {
+            if (PDO_MV(source_caps[c]) == PDO_MV(snk) && PDO_MV(snk) > PDO_MV(best)) {
+                best = source_caps[c];
+            }
+        }
+    }
+    if (best) {
+        model_contract(best, false);
+    }
+}
+
+static uint16_t unswap(uint16_t reg) {
+    return (uint16_t)((reg >> 8) | (reg << 8));
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t dev, uint16_t reg,
+                                   uint16_t reg_size, uint8_t *data, uint16_t size,
+                                   uint32_t timeout) {
+    reg = unswap(reg);
+    if (model.nack || dev != CYPD3177_I2C_ADDR || reg_size != I2C_MEMADD_SIZE_16BIT ||
+            reg + size > sizeof(model.regs)) {
+        return HAL_ERROR;
+    }
+    memcpy(data, &model.regs[reg], size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t dev, uint16_t reg,
+                                    uint16_t reg_size, uint8_t *data, uint16_t size,
+                                    uint32_t timeout) {
+    reg = unswap(reg);
+    if (model.nack || dev != CYPD3177_I2C_ADDR || reg_size != I2C_MEMADD_SIZE_16BIT ||
+            reg + size > sizeof(model.regs)) {
+        return HAL_ERROR;
+    }
+    model.writes++;
+    memcpy(&model.regs[reg], data, size);
+    if (reg == CYPD_SELECT_SINK_PDO_CMD) {
+        model_select(data[0]);
+    }
+    return HAL_OK;
+}
+
+// log.c stand-ins: every level on, output dropped
+uint8_t log_level[LOG_MODULES] = { LOG_LVL_TRACE, LOG_LVL_TRACE, LOG_LVL_TRACE, LOG_LVL_TRACE };
+
+void LOG_Printf(const char *fmt, ...) {
+}
+
+/*main.c's adopt_contract and boot fast path, minus the scheduler: the
+  index in effect after boot, and whether it was adopted*/
+static int boot(bool *adopted) {
+    bool on = false;
+    uint16_t vbus = 0;
+    int i = -1;
+
+    if (CYPD3177_Online(&on) == HAL_OK && on) {
+        i = CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus);
+    }
+    *adopted = (i >= 0);
+    if (i < 0) {
+        uint32_t req[2] = { pdos[0], pdos[0] };     // BOOT_PDO_INDEX
+        if (CYPD3177_ChangePDO(req) != HAL_OK) {
+            return -1;
+        }
+        i = 0;
+    }
+    return i;
+}
+
+/*A PDO change as pdo_change_seq makes it, settled*/
+static void request(uint8_t index) {
+    uint32_t req[2] = { pdos[0], pdos[index] };
+    CHECK_EQ(CYPD3177_ChangePDO(req), HAL_OK);
+    model_settle();
+}
+
+
+static void test_warm_reset_adopts(void) {
+    bool adopted;
+    uint16_t vbus = 0;
+
+    model_power_on();
+    request(2);
+    CHECK_EQ(PDO_MV(get32(CYPD_CURRENT_PDO_REG)), 12000);
+
+    mcu_reset();
+    CHECK_EQ(boot(&adopted), 2);
+    CHECK(adopted);
+    CHECK_EQ(model.writes, 0);              // nothing re-requested
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), 2);
+    CHECK_EQ(vbus, 12000);
+
+    // Several resets in a row keep it
+    mcu_reset();
+    CHECK_EQ(boot(&adopted), 2);
+    CHECK(adopted);
+    CHECK_EQ(model.writes, 0);
+}
+
+
+static void test_cold_boot_default(void) {
+    bool adopted;
+
+    model_power_on();                       // the controller's own 5 V contract
+    CHECK_EQ(boot(&adopted), 0);
+    CHECK(adopted);
+    CHECK_EQ(model.writes, 0);
+}
+
+
+static void test_no_contract_rerequests(void) {
+    bool adopted;
+
+    model_power_on();
+    put32(CYPD_PD_STATUS_REG, 0);           // attached, nothing negotiated yet
+    CHECK_EQ(boot(&adopted), 0);
+    CHECK(!adopted);
+    CHECK_EQ(model.writes, 2);              // data memory, then SELECT_SINK_PDO
+    CHECK_EQ(get32(CYPD_WRITE_DATA_MEM_REG), 0x534E4B50);
+    CHECK_EQ(get32(CYPD_WRITE_DATA_MEM_REG + 4), pdos[0]);
+    CHECK_EQ(model.regs[CYPD_SELECT_SINK_PDO_CMD], 0x03);
+    CHECK(get32(CYPD_PD_STATUS_REG) & CYPD_CONTRACT_STATE);
+}
+
+
+static void test_settling_rerequests(void) {
+    bool adopted;
+
+    model_power_on();
+    uint32_t req[2] = { pdos[0], pdos[3] };
+    CHECK_EQ(CYPD3177_ChangePDO(req), HAL_OK);  // 15 V agreed, VBUS still 5 V
+    mcu_reset();
+    CHECK_EQ(boot(&adopted), 0);
+    CHECK(!adopted);
+    CHECK(model.writes > 0);
+}
+
+
+/*Within 5% of the contract, on the 100 mV VBUS register*/
+static void test_vbus_tolerance(void) {
+    uint16_t vbus = 0;
+
+    model_power_on();
+    request(2);                             // 12 V: 11.4 .. 12.6 V
+    model.regs[CYPD_BUS_VOLTAGE_REG] = 114;
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), 2);
+    model.regs[CYPD_BUS_VOLTAGE_REG] = 113;
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), -1);
+    model.regs[CYPD_BUS_VOLTAGE_REG] = 126;
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), 2);
+    model.regs[CYPD_BUS_VOLTAGE_REG] = 127;
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), -1);
+}
+
+
+static void test_foreign_contracts(void) {
+    uint16_t vbus = 0;
+
+    model_power_on();
+    model_contract(0x0002312C, true);       // 7 V fixed: not in the table
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), -1);
+    model_contract(PDO_PPS_5V9, true);      // augmented: PDO_MV means nothing
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), -1);
+}
+
+
+static void test_controller_unavailable(void) {
+    bool adopted, on = true;
+
+    model_power_on();
+    model.regs[CYPD_DEVICE_MODE_REG] = 0;   // not in active mode
+    CHECK_EQ(CYPD3177_Online(&on), HAL_OK);
+    CHECK(!on);
+    boot(&adopted);
+    CHECK(!adopted);
+
+    model_power_on();
+    request(1);
+    model.nack = true;
+    uint16_t vbus = 0;
+    CHECK_EQ(CYPD3177_LiveContract(pdos, PDO_COUNT, &vbus), -1);
+    CHECK_EQ(boot(&adopted), -1);
+    CHECK(!adopted);
+    model.nack = false;
+    CHECK_EQ(boot(&adopted), 1);
+    CHECK(adopted);
+}
+
+
+/*A PDO the source does not offer leaves the controller on PDO 0*/
+static void test_unoffered_request(void) {
+    model_power_on();
+    request(4);                             // 20 V
+    CHECK_EQ(PDO_MV(get32(CYPD_CURRENT_PDO_REG)), 5000);
+    bool adopted;
+    mcu_reset();
+    CHECK_EQ(boot(&adopted), 0);
+    CHECK(adopted);
+}
+
+
+int main(void) {
+    test_warm_reset_adopts();
+    test_cold_boot_default();
+    test_no_contract_rerequests();
+    test_settling_rerequests();
+    test_vbus_tolerance();
+    test_foreign_contracts();
+    test_controller_unavailable();
+    test_unoffered_request();
+    return TEST_Done("cypd3177_test");
+}
@@ -0,0 +1,152 @@
+// defer_test - defer.c: order of the bottom halves, the full queue, and
+// producer threads standing in for ISRs posting while the consumer drains.
+// Posts go through post_or_run, the fallback main.c and cmd.c use: when the
+// queue is full the item runs inline, so it is never lost.
+
+#include "defer.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define PRODUCERS   4
+#define PER_THREAD  20000
+#define SEQ_BITS    24
+
+static uint32_t order[DEFER_DEPTH * 2];
+static int n_order;
+static _Atomic uint8_t handled[PRODUCERS][PER_THREAD];
+static uint32_t next_queued[PRODUCERS];     // consumer only
+static atomic_int inlined;
+static atomic_int finished;
+static int out_of_order;
+
+static void record(uint32_t arg) {
+    if (n_order < (int)(sizeof(order) / sizeof(order[0]))) {
+        order[n_order++] = arg;
+    }
+}
+
+/*As main.c's EXTI callback: queue it, or run it here if the queue is full*/
+static void post_or_run(defer_fn_t fn, uint32_t arg) {
+    if (!DEFER_Post(fn, arg)) {
+        fn(arg);
+    }
+}
+
+
+static void test_order(void) {
+    DEFER_Init();
+    n_order = 0;
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(DEFER_Post(record, i));
+    }
+    CHECK_EQ(n_order, 0);           // nothing runs until the bottom half
+    DEFER_Run();
+    CHECK_EQ(n_order, 5);
+    for (int i = 0; i < 5; i++) {
+        CHECK_EQ(order[i], i);
+    }
+    DEFER_Run();                    // empty: harmless
+    CHECK_EQ(n_order, 5);
+    CHECK_EQ(DEFER_Dropped(), 0);
+}
+
+
+static void test_full_runs_inline(void) {
+    DEFER_Init();
+    n_order = 0;
+    for (uint32_t i = 0; i < DEFER_DEPTH; i++) {
+        post_or_run(record, i);
+    }
+    CHECK_EQ(n_order, 0);
+    CHECK_EQ(DEFER_Dropped(), 0);
+
+    post_or_run(record, 100);       // full: runs now, ahead of the queue
+    CHECK_EQ(n_order, 1);
+    CHECK_EQ(order[0], 100);
+    CHECK_EQ(DEFER_Dropped(), 1);
+
+    DEFER_Run();
+    CHECK_EQ(n_order, DEFER_DEPTH + 1);
+    CHECK_EQ(order[1], 0);
+    CHECK_EQ(order[DEFER_DEPTH], DEFER_DEPTH - 1);
+
+    // Draining makes room again
+    CHECK(DEFER_Post(record, 200));
+    DEFER_Run();
+    CHECK_EQ(order[DEFER_DEPTH + 1], 200);
+}
+
+
+/*Bottom half: runs on the consumer, so queued items keep their order*/
+static void queued_item(uint32_t arg) {
+    uint32_t p = arg >> SEQ_BITS;
+    uint32_t seq = arg & ((1u << SEQ_BITS) - 1);
+    if (seq < next_queued[p]) {
+        out_of_order++;
+    }
+    next_queued[p] = seq + 1;
+    atomic_fetch_add(&handled[p][seq], 1);
+}
+
+/*Same item, run inline by the producer when the queue was full*/
+static void inline_item(uint32_t arg) {
+    atomic_fetch_add(&handled[arg >> SEQ_BITS][arg & ((1u << SEQ_BITS) - 1)], 1);
+    atomic_fetch_add(&inlined, 1);
+}
+
+static void *producer(void *arg) {
+    uint32_t p = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < PER_THREAD; i++) {
+        uint32_t item = (p << SEQ_BITS) | i;
+        if (!DEFER_Post(queued_item, item)) {
+            inline_item(item);
+        }
+        if ((i & 7) == 0) {
+            sched_yield();          // interrupts come in bursts, not flat out
+        }
+    }
+    atomic_fetch_add(&finished, 1);
+    return NULL;
+}
+
+
+static void test_concurrent_producers(void) {
+    pthread_t threads[PRODUCERS];
+
+    DEFER_Init();
+    for (uintptr_t p = 0; p < PRODUCERS; p++) {
+        pthread_create(&threads[p], NULL, producer, (void *)p);
+    }
+    while (atomic_load(&finished) < PRODUCERS) {
+        DEFER_Run();
+        sched_yield();
+    }
+    DEFER_Run();
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+    }
+
+    int lost = 0, twice = 0;
+    for (int p = 0; p < PRODUCERS; p++) {
+        for (int i = 0; i < PER_THREAD; i++) {
+            uint8_t n = atomic_load(&handled[p][i]);
+            lost += (n == 0);
+            twice += (n > 1);
+        }
+    }
+    CHECK_EQ(lost, 0);
+    CHECK_EQ(twice, 0);
+    CHECK_EQ(out_of_order, 0);
+    CHECK_EQ(atomic_load(&inlined), DEFER_Dropped());
+    printf("%d items, %d run inline\n", PRODUCERS * PER_THREAD, atomic_load(&inlined));
+}
+
+
+int main(void) {
+    test_order();
+    test_full_runs_inline();
+    test_concurrent_producers();
+    return TEST_Done("defer_test");
+}
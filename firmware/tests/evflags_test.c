@@ -0,0 +1,170 @@
+// evflags_test - evflags.c waits from a coroutine task on a virtual clock,
+// laid out as main.c's pdo_change_seq: wait for all of a set of flags, and
+// if that times out, for any of a fallback set.
+
+#include "evflags.h"
+#include "test.h"
+
+#define EVT_FLAGS   0x4
+#define F_A         0x01
+#define F_B         0x02
+#define F_C         0x04
+#define F_D         0x08
+#define ALL_MS      100
+#define ANY_MS      50
+
+static uint32_t vt;
+static evflags_t flags;
+static coro_t co;
+static sched_id_t id;
+static int stage;
+static int runs;
+static bool all_timed_out, any_timed_out;
+static uint32_t at[3];
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static coro_status_t seq(coro_t *c) {
+    CORO_BEGIN(c);
+    stage = 1;
+    at[0] = vt;
+    CORO_AWAIT_ALL(c, &flags, F_A | F_B, ALL_MS);
+    all_timed_out = CORO_TIMED_OUT(c);
+    stage = 2;
+    at[1] = vt;
+    if (all_timed_out) {
+        CORO_AWAIT_ANY(c, &flags, F_C | F_D, ANY_MS);
+        any_timed_out = CORO_TIMED_OUT(c);
+    }
+    stage = 3;
+    at[2] = vt;
+    CORO_END(c);
+}
+
+/*As main.c's pdo_task: woken by the flag event, re-armed for the deadline*/
+static void task(void *arg) {
+    runs++;
+    if (seq(&co) == CORO_RUNNING) {
+        SCHED_Start(id, CORO_Remaining(&co));
+    }
+}
+
+static void start(uint32_t preset) {
+    vt = 0xFFFFFFC0u;
+    SCHED_Init(clock_ms);
+    EVFLAGS_Init(&flags, EVT_FLAGS);
+    EVFLAGS_Set(&flags, preset);
+    id = SCHED_AddOneShot("seq", task, NULL);
+    SCHED_Subscribe(id, EVT_FLAGS);
+    CORO_Reset(&co);
+    stage = 0;
+    runs = 0;
+    all_timed_out = any_timed_out = false;
+    SCHED_Start(id, 0);
+    while (SCHED_RunOnce()) {
+    }
+}
+
+static void step(uint32_t ms) {
+    while (ms--) {
+        vt++;
+        while (SCHED_RunOnce()) {
+        }
+    }
+}
+
+
+static void test_wait_all(void) {
+    start(0);
+    CHECK_EQ(stage, 1);
+    step(10);
+    EVFLAGS_Set(&flags, F_A);
+    step(1);
+    CHECK_EQ(stage, 1);             // woken, but B is still missing
+    CHECK_EQ(runs, 2);
+    step(10);
+    EVFLAGS_Set(&flags, F_B);
+    step(1);
+    CHECK_EQ(stage, 3);
+    CHECK(!all_timed_out);
+    CHECK_EQ(at[1] - at[0], 22);
+    CHECK_EQ(runs, 3);              // no polling in between
+}
+
+
+static void test_already_set(void) {
+    start(F_A | F_B);
+    CHECK_EQ(stage, 3);             // straight through on the first run
+    CHECK(!all_timed_out);
+    CHECK_EQ(runs, 1);
+}
+
+
+static void test_all_times_out_then_any(void) {
+    start(0);
+    EVFLAGS_Set(&flags, F_A);
+    step(ALL_MS - 1);
+    CHECK_EQ(stage, 1);
+    step(1);
+    CHECK_EQ(stage, 2);
+    CHECK(all_timed_out);
+    CHECK_EQ(at[1] - at[0], ALL_MS);
+
+    step(20);
+    EVFLAGS_Set(&flags, F_D);       // either of C and D will do
+    step(1);
+    CHECK_EQ(stage, 3);
+    CHECK(!any_timed_out);
+    CHECK_EQ(at[2] - at[1], 21);
+}
+
+
+static void test_any_times_out(void) {
+    start(0);
+    step(ALL_MS);
+    CHECK_EQ(stage, 2);
+    EVFLAGS_Set(&flags, F_A | F_B); // too late for the first wait, not wanted by the second
+    step(ANY_MS - 1);
+    CHECK_EQ(stage, 2);
+    step(1);
+    CHECK_EQ(stage, 3);
+    CHECK(any_timed_out);
+    CHECK_EQ(at[2] - at[1], ANY_MS);
+}
+
+
+/*Only a bit going from clear to set wakes waiters*/
+static void test_wakeups(void) {
+    start(0);
+    int before = runs;
+    EVFLAGS_Set(&flags, F_C);
+    step(1);
+    CHECK_EQ(runs, before + 1);
+    CHECK_EQ(EVFLAGS_Set(&flags, F_C), F_C);   // already set: no wake-up
+    step(1);
+    CHECK_EQ(runs, before + 1);
+    CHECK_EQ(EVFLAGS_Clear(&flags, F_C), F_C); // clearing never wakes
+    step(1);
+    CHECK_EQ(runs, before + 1);
+    CHECK_EQ(EVFLAGS_Get(&flags), 0);
+
+    EVFLAGS_Put(&flags, F_A | F_B, true);
+    CHECK(EVFLAGS_All(&flags, F_A | F_B));
+    EVFLAGS_Put(&flags, F_A, false);
+    CHECK(!EVFLAGS_All(&flags, F_A | F_B));
+    CHECK(EVFLAGS_Any(&flags, F_A | F_B));
+    step(1);
+    CHECK_EQ(stage, 1);             // B alone does not end the wait
+}
+
+
+int main(void) {
+    test_wait_all();
+    test_already_set();
+    test_all_times_out_then_any();
+    test_any_times_out();
+    test_wakeups();
+    return TEST_Done("evflags_test");
+}
@@ -0,0 +1,173 @@
+// evq_test - evq.c on its C11 atomics path: FIFO order, overflow, position
+// wrap, and producer threads hammering one queue while the consumer checks
+// every record. Prints the throughput of the stress run.
+
+#include "evq.h"
+#include "test.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define PRODUCERS   4
+#define PER_THREAD  250000
+
+typedef struct {
+    uint32_t producer;
+    uint32_t seq;
+    uint32_t check;     // catches a torn or mixed-up record
+} rec_t;
+
+EVQ_DEFINE(small, uint32_t, 8);
+EVQ_DEFINE(big, rec_t, 64);
+
+static atomic_int finished;
+static atomic_uint refused;     // posts that found the queue full
+
+static uint32_t check_of(uint32_t producer, uint32_t seq) {
+    return (producer * 0x9E3779B9u) ^ seq ^ 0xA5A5A5A5u;
+}
+
+/*Start a queue at position 'base', as if that many records had passed*/
+static void init_at(evq_t *q, uint32_t base) {
+    EVQ_Init(q);
+    for (uint32_t i = 0; i <= q->mask; i++) {
+        atomic_store(&q->seq[(base + i) & q->mask], base + i);
+    }
+    atomic_store(&q->head, base);
+    atomic_store(&q->tail, base);
+}
+
+
+static void test_fifo_and_overflow(void) {
+    uint32_t v;
+
+    EVQ_Init(&small);
+    CHECK(!EVQ_Get(&small, &v));
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(EVQ_Post(&small, &i));
+    }
+    CHECK_EQ(EVQ_Depth(&small), 8);
+    v = 99;
+    CHECK(!EVQ_Post(&small, &v));           // full: dropped and counted
+    CHECK_EQ(small.stats.overflows, 1);
+    CHECK_EQ(small.stats.posted, 8);
+    CHECK_EQ(small.stats.depth_max, 8);
+    for (uint32_t i = 0; i < 8; i++) {
+        CHECK(EVQ_Get(&small, &v));
+        CHECK_EQ(v, i);
+    }
+    CHECK(!EVQ_Get(&small, &v));
+    CHECK_EQ(EVQ_Depth(&small), 0);
+}
+
+
+static void test_position_wrap(void) {
+    uint32_t v;
+
+    init_at(&small, 0xFFFFFFFCu);           // crosses 2^32 four records in
+    for (uint32_t round = 0; round < 3; round++) {
+        for (uint32_t i = 0; i < 6; i++) {
+            uint32_t x = round * 10 + i;
+            CHECK(EVQ_Post(&small, &x));
+        }
+        for (uint32_t i = 0; i < 6; i++) {
+            CHECK(EVQ_Get(&small, &v));
+            CHECK_EQ(v, round * 10 + i);
+        }
+    }
+    CHECK(!EVQ_Get(&small, &v));
+    CHECK_EQ(small.stats.overflows, 0);
+}
+
+
+/*A claimed slot that is not published yet holds the consumer up*/
+static void test_unpublished_slot(void) {
+    uint32_t v = 1;
+
+    EVQ_Init(&small);
+    atomic_store(&small.head, 1);           // a producer claimed slot 0...
+    CHECK(EVQ_Post(&small, &v));            // ...another one filled slot 1
+    CHECK(!EVQ_Get(&small, &v));
+    atomic_store(&small.seq[0], 1);         // the first one publishes
+    CHECK(EVQ_Get(&small, &v));
+    CHECK(EVQ_Get(&small, &v));
+    CHECK_EQ(v, 1);
+}
+
+
+static void *producer(void *arg) {
+    uint32_t p = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 0; i < PER_THREAD; ) {
+        rec_t r = { p, i, check_of(p, i) };
+        if (EVQ_Post(&big, &r)) {
+            i++;
+        } else {
+            atomic_fetch_add(&refused, 1);
+            sched_yield();
+        }
+    }
+    atomic_fetch_add(&finished, 1);
+    return NULL;
+}
+
+
+static void test_stress(void) {
+    pthread_t threads[PRODUCERS];
+    uint32_t next[PRODUCERS] = { 0 };
+    uint32_t got = 0, bad = 0;
+    struct timespec t0, t1;
+    rec_t r;
+
+    init_at(&big, 0xFFFF0000u);             // wraps during the run
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uintptr_t p = 0; p < PRODUCERS; p++) {
+        pthread_create(&threads[p], NULL, producer, (void *)p);
+    }
+    for (;;) {
+        bool done = atomic_load(&finished) == PRODUCERS;
+        bool any = false;
+        while (EVQ_Get(&big, &r)) {
+            any = true;
+            got++;
+            if (r.producer >= PRODUCERS || r.check != check_of(r.producer, r.seq) ||
+                    r.seq != next[r.producer]) {
+                bad++;
+                continue;
+            }
+            next[r.producer]++;
+        }
+        if (done && !any) {
+            break;
+        }
+        if (!any) {
+            sched_yield();
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int p = 0; p < PRODUCERS; p++) {
+        pthread_join(threads[p], NULL);
+    }
+
+    CHECK_EQ(got, PRODUCERS * PER_THREAD);
+    CHECK_EQ(bad, 0);
+    for (int p = 0; p < PRODUCERS; p++) {
+        CHECK_EQ(next[p], PER_THREAD);
+    }
+    CHECK_EQ(big.stats.posted, PRODUCERS * PER_THREAD);
+    CHECK_EQ(big.stats.overflows, atomic_load(&refused));
+    CHECK(big.stats.depth_max <= 64);
+
+    double s = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%u records from %d threads in %.3f s: %.2f M/s, %u refused, depth max %u\n",
+           got, PRODUCERS, s, got / s / 1e6, atomic_load(&refused), big.stats.depth_max);
+}
+
+
+int main(void) {
+    test_fifo_and_overflow();
+    test_position_wrap();
+    test_unpublished_slot();
+    test_stress();
+    return TEST_Done("evq_test");
+}
@@ -0,0 +1,110 @@
+// lowpower_test - the tick arithmetic of lowpower.c's tickless idle.
+//
+// LOWPOWER_SleepTicks is checked against a scheduler on a virtual clock.
+// The stretch and the early-wake credit are checked against a model of
+// the HAL tick: wall time in core clock counts, with a tick every
+// per_tick counts. After any sleep, woken at any count, the credited
+// ticks must equal the tick boundaries that really passed, and the
+// finishing reload must put the next tick back on the original grid.
+
+#include "lowpower.h"
+#include "test.h"
+#include <stdlib.h>
+
+static uint32_t vt;
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static void nop(void *arg) {
+}
+
+
+static void test_sleep_ticks(void) {
+    vt = 0xFFFFFFF0u;
+    SCHED_Init(clock_ms);
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 200);        // nothing armed: events only
+
+    sched_id_t a = SCHED_AddOneShot("a", nop, NULL);
+    sched_id_t b = SCHED_AddOneShot("b", nop, NULL);
+    SCHED_Start(a, 50);
+    SCHED_Start(b, 30);                             // across the clock wrap
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 30);
+    CHECK_EQ(LOWPOWER_SleepTicks(20), 20);          // clamped to the counter
+    vt += 29;
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 1);
+    vt += 5;                                        // overdue, not yet advanced
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 0);
+    while (SCHED_RunOnce()) {
+    }
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 16);
+    SCHED_PostEvent(1);                             // pending event: don't sleep
+    CHECK_EQ(LOWPOWER_SleepTicks(200), 0);
+}
+
+
+static void test_stretch_load(void) {
+    const uint32_t per_tick = 84000;                // 84 MHz, 1 ms tick
+    uint32_t max_ticks = LOWPOWER_LOAD_MAX / per_tick;
+
+    CHECK_EQ(LOWPOWER_StretchLoad(1000, 1, per_tick), 1000);
+    CHECK_EQ(LOWPOWER_StretchLoad(1000, 3, per_tick), 1000 + 2 * per_tick);
+    // The longest sleep the idle loop asks for still fits the counter...
+    CHECK_EQ(LOWPOWER_StretchLoad(per_tick - 1, max_ticks, per_tick),
+             max_ticks * per_tick - 1);
+    CHECK(LOWPOWER_StretchLoad(per_tick - 1, max_ticks, per_tick) <= LOWPOWER_LOAD_MAX);
+    // ...anything longer is clamped rather than wrapping
+    CHECK_EQ(LOWPOWER_StretchLoad(0, max_ticks + 10, per_tick), LOWPOWER_LOAD_MAX);
+    CHECK_EQ(LOWPOWER_StretchLoad(0, 100000, per_tick), LOWPOWER_LOAD_MAX);
+}
+
+
+static void test_credit(void) {
+    static const uint32_t rates[] = { 16000, 84000 };   // HSE idle, PLL burst
+    srand(1);
+
+    for (unsigned r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        uint32_t per_tick = rates[r];
+        uint32_t max_ticks = LOWPOWER_LOAD_MAX / per_tick;
+        uint64_t now = 12345;                       // wall time, counts
+        uint64_t hal_tick = now / per_tick;         // what uwTick should read
+        int bad = 0;
+
+        for (int i = 0; i < 20000; i++) {
+            uint32_t remain = per_tick - (uint32_t)(now % per_tick);
+            uint32_t ticks = 2 + (uint32_t)rand() % (max_ticks - 1);
+            uint32_t load = LOWPOWER_StretchLoad(remain, ticks, per_tick);
+            uint32_t slept = (uint32_t)rand() % load;   // woken early
+            uint32_t finish;
+
+            hal_tick += LOWPOWER_Credit(slept, remain, per_tick, &finish);
+            now += slept;
+            // Credited ticks are the boundaries that passed...
+            bad += hal_tick != now / per_tick;
+            // ...and the next one comes back on the grid
+            bad += (now + finish + 1) % per_tick != 0;
+            bad += finish >= per_tick;
+            now += (uint32_t)rand() % per_tick;     // awake a while
+            hal_tick = now / per_tick;
+        }
+        CHECK_EQ(bad, 0);
+    }
+
+    // Exact values, asleep from 100 counts before a boundary
+    uint32_t finish;
+    CHECK_EQ(LOWPOWER_Credit(99, 100, 1000, &finish), 0);
+    CHECK_EQ(finish, 0);
+    CHECK_EQ(LOWPOWER_Credit(100, 100, 1000, &finish), 1);
+    CHECK_EQ(finish, 999);
+    CHECK_EQ(LOWPOWER_Credit(2150, 100, 1000, &finish), 3);
+    CHECK_EQ(finish, 949);
+}
+
+
+int main(void) {
+    test_sleep_ticks();
+    test_stretch_load();
+    test_credit();
+    return TEST_Done("lowpower_test");
+}
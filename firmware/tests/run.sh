@@ -0,0 +1,90 @@
+#!/bin/sh
+# run.sh - build and run the host tests
+#
+# Each test is one C file in tests/, linked with the firmware modules it
+# exercises and built with -DPDT_HOST, so the same sources as on the
+# target run against a virtual clock and host stand-ins for the hardware.
+#
+# Usage:  tests/run.sh [test ...]
+#         (run from firmware/; with no arguments every test runs)
+#
+# Core/Inc is on the quote path only: its sched.h would otherwise stand in
+# for the system one that pthread.h includes.
+#
+# Environment: CC, CFLAGS (default: ASan and UBSan, which also catch the
+# out-of-bounds and overflow cases the tests drive).
+
+set -e
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all}
+INC=pdtrigger_firmware/Core/Inc
+SRC=pdtrigger_firmware/Core/Src
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+failed=0
+
+# t <test> "<extra flags>" <module.c ...>
+t() {
+    name=$1
+    defs=$2
+    shift 2
+    if [ -n "$only" ] && ! echo " $only " | grep -q " $name "; then
+        return 0
+    fi
+    srcs=""
+    for s in "$@"; do
+        srcs="$srcs $SRC/$s"
+    done
+    # shellcheck disable=SC2086
+    if ! $CC -std=gnu11 -Wall -Wextra -Wno-unused-parameter $CFLAGS -DPDT_HOST $defs \
+            -iquote $INC -Itests tests/$name.c $srcs -o "$tmp/$name" -lpthread; then
+        echo "FAIL $name (build)"
+        failed=1
+    elif ! "$tmp/$name" > "$tmp/$name.out" 2>&1; then
+        cat "$tmp/$name.out"
+        echo "FAIL $name"
+        failed=1
+    else
+        echo "ok   $(tail -n 1 "$tmp/$name.out")"
+    fi
+}
+
+only="$*"
+export TLM_CAPTURE="$tmp/tlm"
+
+t sched_test        ""  sched.c
+t lowpower_test     ""  lowpower.c sched.c
+t coro_test         ""  sched.c
+t supervisor_test   ""  supervisor.c sched.c
+t evq_test          ""  evq.c
+t defer_test        ""  defer.c evq.c
+t evflags_test      ""  evflags.c sched.c
+t cypd3177_test     ""  cypd3177.c
+t clockgov_test     ""  clockgov.c
+t uarttx_test       ""  uarttx.c
+t cmd_test          ""  cmd.c fmt.c
+t cmdtag_test       ""  cmd.c fmt.c
+t tlm_test          "-DPDT_TLM"  tlm.c
+
+# tlmdec on the stream tlm_test wrote: the lines it sent, minus the frame
+# it was started in and the one corrupted on the way
+if [ -z "$only" ] || echo " $only " | grep -q " tlm_test "; then
+    if [ ! -f "$tmp/tlm.bin" ]; then
+        :
+    elif ! ${CXX:-c++} -O1 -std=c++17 -o "$tmp/tlmdec" tools/tlmdec.cpp; then
+        echo "FAIL tlmdec (build)"
+        failed=1
+    elif ! "$tmp/tlmdec" "$tmp/tlm.bin" > "$tmp/tlm.out" ||
+            ! cmp -s "$tmp/tlm.txt" "$tmp/tlm.out"; then
+        diff "$tmp/tlm.txt" "$tmp/tlm.out" || true
+        echo "FAIL tlmdec"
+        failed=1
+    else
+        echo "ok   tlmdec: $(wc -l < "$tmp/tlm.out") lines as sent"
+    fi
+fi
+
+exit $failed
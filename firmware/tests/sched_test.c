@@ -0,0 +1,173 @@
+// sched_test - the timer wheel, ready mask and event wake-ups of sched.c
+// on a virtual millisecond clock, started just before the 32-bit wrap.
+
+#include "sched.h"
+#include "test.h"
+
+static uint32_t vt;
+static int runs[4];
+static uint32_t seen_events;
+static uint32_t ran_at[8];
+static uint8_t order[8];
+static uint8_t n_order;
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static void task(void *arg) {
+    int i = (int)(intptr_t)arg;
+    runs[i]++;
+    seen_events |= SCHED_Events();
+    if (n_order < sizeof(order)) {
+        ran_at[n_order] = vt;
+        order[n_order++] = (uint8_t)i;
+    }
+}
+
+static void reset(uint32_t t0) {
+    vt = t0;
+    SCHED_Init(clock_ms);
+    for (int i = 0; i < 4; i++) {
+        runs[i] = 0;
+    }
+    seen_events = 0;
+    n_order = 0;
+}
+
+static void run_all(void) {
+    while (SCHED_RunOnce()) {
+    }
+}
+
+/*Advance one tick at a time, running what became ready*/
+static void step(uint32_t ms) {
+    while (ms--) {
+        vt++;
+        run_all();
+    }
+}
+
+
+static void test_periodic_across_wrap(void) {
+    reset(0xFFFFFF00u);
+    SCHED_AddPeriodic("a", task, (void *)0, 10, 10);
+    SCHED_AddPeriodic("b", task, (void *)1, 100, 5);     // longer than the wheel
+    step(1000);
+    CHECK_EQ(runs[0], 100);
+    CHECK_EQ(runs[1], 10);
+    CHECK_EQ(SCHED_Stats(0)->late_max, 0);
+    CHECK_EQ(SCHED_Stats(0)->missed, 0);
+}
+
+
+static void test_missed_periods(void) {
+    reset(0);
+    SCHED_AddPeriodic("a", task, (void *)0, 10, 10);
+    vt += 35;                   // asleep through 3 deadlines, due at 10, 20, 30
+    run_all();
+    CHECK_EQ(runs[0], 1);
+    CHECK_EQ(SCHED_Stats(0)->late_last, 25);
+    CHECK_EQ(SCHED_Stats(0)->missed, 2);
+    step(5);                    // back on the original grid at 40
+    CHECK_EQ(runs[0], 2);
+    CHECK_EQ(ran_at[1], 40);
+}
+
+
+static void test_one_shot_and_priority(void) {
+    reset(0);
+    sched_id_t lo = SCHED_AddOneShot("lo", task, (void *)0);
+    sched_id_t hi = SCHED_AddOneShot("hi", task, (void *)1);
+    SCHED_Start(hi, 70);
+    SCHED_Start(lo, 70);
+    step(69);
+    CHECK_EQ(runs[0] + runs[1], 0);
+    CHECK(SCHED_IsArmed(lo));
+    step(1);
+    // Both due together: the lower id runs first
+    CHECK_EQ(n_order, 2);
+    CHECK_EQ(order[0], lo);
+    CHECK_EQ(order[1], hi);
+    CHECK(!SCHED_IsArmed(lo));
+    step(200);
+    CHECK_EQ(runs[0], 1);
+    CHECK_EQ(runs[1], 1);
+}
+
+
+static void test_events(void) {
+    reset(0);
+    sched_id_t id = SCHED_AddOneShot("ev", task, (void *)0);
+    SCHED_Subscribe(id, 0x5);
+    SCHED_PostEvent(0x2);       // not subscribed
+    run_all();
+    CHECK_EQ(runs[0], 0);
+    SCHED_PostEvent(0x1);
+    SCHED_PostEvent(0x4);       // both before the pass: one run sees both
+    run_all();
+    CHECK_EQ(runs[0], 1);
+    CHECK_EQ(seen_events, 0x5);
+    uint32_t ticks;
+    CHECK(!SCHED_NextDeadline(&ticks));     // nothing armed: wait for events
+}
+
+
+static void test_stop(void) {
+    reset(0);
+    sched_id_t id = SCHED_AddPeriodic("p", task, (void *)0, 10, 10);
+    vt += 10;
+    SCHED_Stop(id);             // due, not yet dispatched
+    step(100);
+    CHECK_EQ(runs[0], 0);
+    SCHED_SetPeriod(id, 20);
+    step(100);
+    CHECK_EQ(runs[0], 5);
+}
+
+
+/*Restarting a task that is already ready replaces its pending timer run*/
+static void test_restart_while_ready(void) {
+    reset(0);
+    sched_id_t a = SCHED_AddOneShot("a", task, (void *)0);
+    sched_id_t b = SCHED_AddOneShot("b", task, (void *)1);
+    SCHED_Start(b, 0);
+    SCHED_Start(b, 0);
+    run_all();
+    CHECK_EQ(runs[1], 1);
+
+    SCHED_Start(b, 0);          // ready now...
+    SCHED_Start(b, 10);         // ...then pushed back: runs once, at +10
+    run_all();
+    CHECK_EQ(runs[1], 1);
+    step(9);
+    CHECK_EQ(runs[1], 1);
+    step(1);
+    CHECK_EQ(runs[1], 2);
+    step(50);
+    CHECK_EQ(runs[1], 2);
+
+    // A pending event wake-up is kept; only the timer run is replaced
+    SCHED_Subscribe(b, 0x1);
+    SCHED_Start(a, 0);
+    SCHED_PostEvent(0x1);
+    SCHED_RunOnce();            // runs a; b is now ready on the event
+    CHECK_EQ(runs[0], 1);
+    SCHED_Start(b, 10);
+    run_all();
+    CHECK_EQ(runs[1], 3);
+    CHECK_EQ(seen_events, 0x1);
+    step(10);
+    CHECK_EQ(runs[1], 4);
+}
+
+
+int main(void) {
+    test_periodic_across_wrap();
+    test_missed_periods();
+    test_one_shot_and_priority();
+    test_events();
+    test_stop();
+    test_restart_while_ready();
+    return TEST_Done("sched_test");
+}
@@ -0,0 +1,135 @@
+// supervisor_test - supervisor.c driven by sched.c on a virtual clock, with
+// a stubbed IWDG feed: a required task that stalls stops the feed, and the
+// watchdog would then reset the part.
+
+#include "sched.h"
+#include "supervisor.h"
+#include "test.h"
+
+#define PERIOD_MS   100
+#define WINDOW_MS   300             // as main.c: CHECKIN_PERIODS * STATUS_PERIOD_MS
+#define BUDGET      5
+
+static uint32_t vt;
+static uint32_t fed_at;             // last feed, on the virtual clock
+static int feeds;
+static uint32_t longest_gap;        // longest time the watchdog went unfed
+static uint32_t busy[SCHED_MAX_TASKS];  // run time to burn on the next run
+
+static uint32_t clock_ms(void) {
+    return vt;
+}
+
+static void feed(void) {
+    feeds++;
+    fed_at = vt;
+}
+
+static void task(void *arg) {
+    sched_id_t id = SCHED_Current();
+    vt += busy[id];                 // the stat clock is the same clock
+    busy[id] = 0;
+}
+
+static void reset(void) {
+    vt = 0xFFFFF000u;
+    fed_at = vt;
+    feeds = 0;
+    longest_gap = 0;
+    for (int i = 0; i < SCHED_MAX_TASKS; i++) {
+        busy[i] = 0;
+    }
+    SCHED_Init(clock_ms);
+    SUPERVISOR_Init(clock_ms, feed);
+    SCHED_SetRunHook(SUPERVISOR_TaskDone);
+}
+
+/*The main loop: run what is ready, then let the supervisor feed*/
+static void step(uint32_t ms) {
+    while (ms--) {
+        vt++;
+        while (SCHED_RunOnce()) {
+        }
+        SUPERVISOR_Poll();
+        if (vt - fed_at > longest_gap) {
+            longest_gap = vt - fed_at;
+        }
+    }
+}
+
+
+static void test_healthy_feeds(void) {
+    reset();
+    sched_id_t a = SCHED_AddPeriodic("a", task, NULL, PERIOD_MS, PERIOD_MS);
+    SUPERVISOR_Watch(a, BUDGET, WINDOW_MS);
+    sched_id_t b = SCHED_AddPeriodic("b", task, NULL, PERIOD_MS, PERIOD_MS / 2);
+    SUPERVISOR_Watch(b, BUDGET, WINDOW_MS);
+    step(10 * PERIOD_MS);
+    CHECK_EQ(feeds, 10);            // once both have run in each period
+    CHECK(longest_gap <= PERIOD_MS);
+    CHECK_EQ(SUPERVISOR_Stats(a)->starved, 0);
+    CHECK_EQ(SUPERVISOR_Stats(b)->overruns, 0);
+}
+
+
+static void test_stall_stops_feed(void) {
+    reset();
+    sched_id_t a = SCHED_AddPeriodic("a", task, NULL, PERIOD_MS, PERIOD_MS);
+    SUPERVISOR_Watch(a, BUDGET, WINDOW_MS);
+    sched_id_t b = SCHED_AddPeriodic("b", task, NULL, PERIOD_MS, PERIOD_MS / 2);
+    SUPERVISOR_Watch(b, BUDGET, WINDOW_MS);
+    step(5 * PERIOD_MS);
+    int before = feeds;
+
+    SCHED_Stop(b);                  // stops being scheduled, as if hung
+    step(SUPERVISOR_IWDG_MS * 2);
+    CHECK(feeds <= before + 1);     // at most the check-in it already made
+    CHECK(vt - fed_at > SUPERVISOR_IWDG_MS);   // the IWDG would have fired
+    CHECK_EQ(SUPERVISOR_Stats(b)->starved, 1); // once per episode
+    CHECK_EQ(SUPERVISOR_Stats(a)->starved, 0);
+
+    // Running again ends the episode and feeding resumes
+    SCHED_SetPeriod(b, PERIOD_MS);
+    step(2 * PERIOD_MS);
+    CHECK(vt - fed_at <= PERIOD_MS);
+    CHECK_EQ(SUPERVISOR_Stats(b)->starved, 1);
+}
+
+
+static void test_optional_task(void) {
+    reset();
+    sched_id_t a = SCHED_AddPeriodic("a", task, NULL, PERIOD_MS, PERIOD_MS);
+    SUPERVISOR_Watch(a, BUDGET, WINDOW_MS);
+    sched_id_t o = SCHED_AddOneShot("o", task, NULL);
+    SUPERVISOR_Watch(o, BUDGET, 0);     // budget only, never runs
+    step(10 * PERIOD_MS);
+    CHECK_EQ(feeds, 10);
+    CHECK_EQ(SUPERVISOR_Stats(o)->starved, 0);
+}
+
+
+static void test_overrun(void) {
+    reset();
+    sched_id_t a = SCHED_AddPeriodic("a", task, NULL, PERIOD_MS, PERIOD_MS);
+    SUPERVISOR_Watch(a, BUDGET, WINDOW_MS);
+    step(PERIOD_MS);
+    busy[a] = BUDGET;               // on budget: fine
+    step(PERIOD_MS);
+    CHECK_EQ(SUPERVISOR_Stats(a)->overruns, 0);
+    busy[a] = BUDGET + 20;
+    step(PERIOD_MS);
+    CHECK_EQ(SUPERVISOR_Stats(a)->overruns, 1);
+    CHECK_EQ(SUPERVISOR_Stats(a)->last_over, BUDGET + 20);
+    CHECK_EQ(SUPERVISOR_Stats(a)->worst, BUDGET + 20);
+    // A slow run that finishes still checks in
+    CHECK(vt - fed_at <= PERIOD_MS);
+}
+
+
+int main(void) {
+    test_healthy_feeds();
+    test_stall_stops_feed();
+    test_optional_task();
+    test_overrun();
+    return TEST_Done("supervisor_test");
+}
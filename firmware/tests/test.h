@@ -0,0 +1,42 @@
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+/*
+ * Host test support. CHECK and CHECK_EQ report a failed expectation with
+ * its line and carry on, so one run shows every failure; TEST_Done prints
+ * the count and gives main its exit status. Tests run on a virtual clock
+ * where they need time, so they are exact and do not sleep.
+ */
+
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        test_checks++;                                                      \
+        if (!(cond)) {                                                      \
+            test_failures++;                                                \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                      \
+    do {                                                                    \
+        long long a_ = (long long)(a), b_ = (long long)(b);                 \
+        test_checks++;                                                      \
+        if (a_ != b_) {                                                     \
+            test_failures++;                                                \
+            printf("%s:%d: %s == %lld, expected %s == %lld\n", __FILE__,    \
+                   __LINE__, #a, a_, #b, b_);                               \
+        }                                                                   \
+    } while (0)
+
+/*Summary line; returns the exit status*/
+static inline int TEST_Done(const char *name) {
+    printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif
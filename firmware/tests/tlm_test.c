@@ -0,0 +1,403 @@
+// tlm_test - tlm.c frames taken apart again by a decoder that follows
+// tools/tlmdec.cpp: COBS, CRC-16/CCITT-FALSE (computed bit by bit here, not
+// with tlm.c's nibble table), seq and the STATE delta encoding. The stream
+// is cut, corrupted and started mid-frame to check the decoder resyncs at
+// the next delimiter.
+//
+// With TLM_CAPTURE set, the stream of test_capture is also written to
+// $TLM_CAPTURE.bin, and what tlmdec should print for it to
+// $TLM_CAPTURE.txt; run.sh feeds the one to tlmdec and compares.
+
+#include "tlm.h"
+#include "crit.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CAP_MAX     8192
+#define KWIRE_MAX   256         // tlmdec's kWireMax
+
+static uint8_t cap[CAP_MAX];
+static size_t cap_len;
+static bool refuse;             // the UART path is full
+static uint32_t vt_ms;
+
+// uarttx.c, timebase.c and crit.c stand-ins: capture the wire, virtual clock
+crit_stats_t crit_stats[CRIT_LEVELS];
+
+uint16_t UARTTX_Write(const char *buf, uint16_t len) {
+    if (refuse || cap_len + len > CAP_MAX) {
+        return 0;
+    }
+    memcpy(&cap[cap_len], buf, len);
+    cap_len += len;
+    return len;
+}
+
+uint32_t TIMEBASE_Micros(void) {
+    return vt_ms * 1000U;
+}
+
+typedef struct {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t payload[TLM_PAYLOAD_MAX];
+    uint16_t len;
+} frame_t;
+
+typedef struct {
+    frame_t f[64];
+    int frames;
+    int errors;                 // COBS, CRC, runt or oversize after sync
+    int skipped;                // anything before the first delimiter
+    bool synced;
+} rx_t;
+
+static uint16_t crc_bitwise(const uint8_t *p, size_t n) {
+    uint16_t crc = 0xFFFF;
+    while (n--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int b = 0; b < 8; b++) {
+            crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+/*One frame between delimiters; false if it does not check out*/
+static bool unframe(const uint8_t *w, size_t n, frame_t *f) {
+    uint8_t buf[KWIRE_MAX];
+    size_t len = 0, i = 0;
+
+    if (n > KWIRE_MAX) {
+        return false;
+    }
+    while (i < n) {
+        uint8_t code = w[i++];
+        size_t run = (size_t)code - 1;
+        if (code == 0 || i + run > n) {
+            return false;
+        }
+        memcpy(&buf[len], &w[i], run);
+        len += run;
+        i += run;
+        if (code != 0xFF && i < n) {
+            buf[len++] = 0;
+        }
+    }
+    if (len < 4 || len - 4 > TLM_PAYLOAD_MAX ||
+            crc_bitwise(buf, len - 2) != (uint16_t)(buf[len - 2] | buf[len - 1] << 8)) {
+        return false;
+    }
+    f->type = buf[0];
+    f->seq = buf[1];
+    f->len = (uint16_t)(len - 4);
+    memcpy(f->payload, &buf[2], f->len);
+    return true;
+}
+
+/*Split a byte stream at the delimiters, as tlmdec's Decoder::feed does*/
+static void receive(rx_t *rx, const uint8_t *p, size_t n) {
+    size_t start = 0;
+
+    memset(rx, 0, sizeof(*rx));
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] != 0) {
+            continue;
+        }
+        if (i > start) {
+            frame_t *f = &rx->f[rx->frames < 63 ? rx->frames : 63];
+            if (unframe(&p[start], i - start, f)) {
+                rx->frames++;
+            } else if (rx->synced) {
+                rx->errors++;
+            } else {
+                rx->skipped++;
+            }
+        }
+        rx->synced = true;
+        start = i + 1;
+    }
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+
+static void test_crc_check_value(void) {
+    uint8_t data[300];
+
+    CHECK_EQ(TLM_Crc16(0xFFFF, (const uint8_t *)"123456789", 9), 0x29B1);
+    CHECK_EQ(crc_bitwise((const uint8_t *)"123456789", 9), 0x29B1);
+    // Chained over pieces as TLM_Encode does, and against the bitwise CRC
+    srand(1);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)rand();
+    }
+    CHECK_EQ(TLM_Crc16(TLM_Crc16(0xFFFF, data, 2), &data[2], sizeof(data) - 2),
+             crc_bitwise(data, sizeof(data)));
+    CHECK_EQ(TLM_Crc16(0xFFFF, data, 0), 0xFFFF);
+}
+
+
+/*Every payload length, zeros anywhere: no 0x00 inside a frame, and the
+  frame decodes to what went in*/
+static void test_encode_round_trip(void) {
+    uint8_t wire[TLM_WIRE_MAX], payload[TLM_PAYLOAD_MAX];
+    frame_t f;
+    int bad = 0;
+
+    for (int pattern = 0; pattern < 4; pattern++) {
+        for (uint16_t len = 0; len <= TLM_PAYLOAD_MAX; len++) {
+            for (uint16_t i = 0; i < len; i++) {
+                payload[i] = pattern == 0 ? 0 : pattern == 1 ? 0xFF :
+                             pattern == 2 ? (uint8_t)i : (uint8_t)(i % 3 ? 0 : i);
+            }
+            uint16_t n = TLM_Encode(wire, TLM_MSG_TEXT, (uint8_t)len, payload, len);
+            bad += (n != 2 + len + 2 + 2 || wire[n - 1] != 0);
+            for (uint16_t i = 0; i + 1 < n; i++) {
+                bad += (wire[i] == 0);
+            }
+            if (!unframe(wire, n - 1u, &f) || f.type != TLM_MSG_TEXT || f.seq != (uint8_t)len ||
+                    f.len != len || memcmp(f.payload, payload, len) != 0) {
+                bad++;
+            }
+        }
+    }
+    CHECK_EQ(bad, 0);
+
+    // A header or CRC byte of 0x00 is escaped like any other
+    uint16_t n = TLM_Encode(wire, (tlm_msg_t)0, 0, NULL, 0);
+    CHECK(unframe(wire, n - 1u, &f));
+    CHECK_EQ(f.type, 0);
+    CHECK_EQ(f.len, 0);
+}
+
+
+static void test_send_round_trip(void) {
+    static const char text[] = "VBUS: 9000 mV\r\na log line long enough to take a "
+                               "second TEXT frame, 0123456789\r\n";
+    char got[sizeof(text)] = "";
+    rx_t rx;
+
+    cap_len = 0;
+    vt_ms = 1234;
+    uint32_t frames = TLM_Stats()->frames, bytes = TLM_Stats()->bytes;
+    TLM_Hello();
+    TLM_Event(TLM_EV_PDO_DONE, 2, 12000);
+    TLM_Status(TLM_ST_ONLINE | TLM_ST_VBUS_OK, 2, 2, 11980);
+    TLM_Text(text, sizeof(text) - 1);
+    CHECK_EQ(TLM_Stats()->frames - frames, 5);
+    CHECK_EQ(TLM_Stats()->bytes - bytes, cap_len);
+
+    receive(&rx, cap, cap_len);
+    CHECK_EQ(rx.frames, 5);
+    CHECK_EQ(rx.errors, 0);
+    CHECK_EQ(rx.skipped, 0);
+    for (int i = 1; i < rx.frames; i++) {
+        CHECK_EQ(rx.f[i].seq, (uint8_t)(rx.f[0].seq + i));
+    }
+    frame_t *f = rx.f;
+    CHECK_EQ(f[0].type, TLM_MSG_HELLO);
+    CHECK_EQ(f[0].payload[0], TLM_SCHEMA);
+    CHECK_EQ(get32(&f[0].payload[2]), 1234);
+    CHECK_EQ(f[1].type, TLM_MSG_EVENT);
+    CHECK_EQ(get32(f[1].payload), 1234);
+    CHECK_EQ(f[1].payload[4], TLM_EV_PDO_DONE);
+    CHECK_EQ(f[1].payload[5], 2);
+    CHECK_EQ(get16(&f[1].payload[6]), 12000);
+    CHECK_EQ(f[2].type, TLM_MSG_STATUS);
+    CHECK_EQ(f[2].payload[4], TLM_ST_ONLINE | TLM_ST_VBUS_OK);
+    CHECK_EQ(get16(&f[2].payload[7]), 11980);
+    CHECK_EQ(f[3].type, TLM_MSG_TEXT);
+    CHECK_EQ(f[3].len, TLM_PAYLOAD_MAX);
+    CHECK_EQ(f[4].type, TLM_MSG_TEXT);
+    memcpy(got, f[3].payload, f[3].len);
+    memcpy(&got[f[3].len], f[4].payload, f[4].len);
+    CHECK(strcmp(got, text) == 0);
+
+    // A refused frame is counted and still uses up its seq
+    uint8_t last = f[4].seq;
+    refuse = true;
+    uint32_t dropped = TLM_Stats()->dropped;
+    CHECK(!TLM_Send(TLM_MSG_TEXT, (const uint8_t *)"x", 1));
+    CHECK_EQ(TLM_Stats()->dropped - dropped, 1);
+    refuse = false;
+    cap_len = 0;
+    TLM_Event(TLM_EV_PD_INTR, 1, 0);
+    receive(&rx, cap, cap_len);
+    CHECK_EQ(rx.f[0].seq, (uint8_t)(last + 2));
+    CHECK(!TLM_Send(TLM_MSG_TEXT, cap, TLM_PAYLOAD_MAX + 1));
+}
+
+
+/*A receiver that starts anywhere, loses bytes or sees one flipped is back
+  in sync at the next delimiter, and loses only the frame it was in*/
+static void test_resync(void) {
+    uint8_t s[CAP_MAX];
+    size_t first, n;
+    rx_t rx;
+
+    cap_len = 0;
+    for (int i = 0; i < 6; i++) {
+        TLM_Event(TLM_EV_PDO_REQUEST, (uint8_t)i, 9000);
+    }
+    first = (size_t)((uint8_t *)memchr(cap, 0, cap_len) - cap) + 1;
+    n = cap_len;
+    memcpy(s, cap, n);
+
+    // Started mid-frame: the partial frame is skipped, not an error
+    for (size_t k = 1; k < first - 1; k++) {
+        receive(&rx, &s[k], n - k);
+        CHECK_EQ(rx.frames, 5);
+        CHECK_EQ(rx.errors, 0);
+        CHECK_EQ(rx.skipped, 1);
+        CHECK_EQ(rx.f[0].payload[5], 1);
+    }
+
+    // One flipped bit in every position of the third frame
+    int missed = 0;
+    for (size_t k = 2 * first; k < 3 * first - 1; k++) {
+        for (int bit = 0; bit < 8; bit++) {
+            s[k] ^= (uint8_t)(1u << bit);
+            receive(&rx, s, n);
+            s[k] ^= (uint8_t)(1u << bit);
+            // A flip to 0x00 splits the frame in two bad halves
+            missed += !(rx.frames == 5 && rx.f[2].payload[5] == 3 &&
+                        rx.errors >= 1 && rx.errors <= 2);
+        }
+    }
+    CHECK_EQ(missed, 0);
+
+    // Bytes lost from the middle of a frame (a ring drop): it fails its
+    // CRC or framing, the frames around it are intact
+    for (size_t cut = 1; first + 3 + cut < 2 * first - 1; cut++) {
+        size_t m = first + 3;
+        memcpy(s, cap, m);
+        memcpy(&s[m], &cap[first + 3 + cut], n - first - 3 - cut);
+        m += n - first - 3 - cut;
+        receive(&rx, s, m);
+        CHECK_EQ(rx.frames, 5);
+        CHECK_EQ(rx.errors, 1);
+        CHECK_EQ(rx.f[1].payload[5], 2);
+    }
+    memcpy(s, cap, n);
+
+    // Idle fill between frames is not a frame
+    memmove(&s[first + 2], &s[first], n - first);
+    s[first] = s[first + 1] = 0;
+    receive(&rx, s, n + 2);
+    CHECK_EQ(rx.frames, 6);
+    CHECK_EQ(rx.errors, 0);
+}
+
+
+/*STATE: keyframe, then only what changed, nothing when nothing did*/
+static void test_state_delta(void) {
+    uint32_t live = TLM_FIELD(TLM_F_FLAGS) | TLM_FIELD(TLM_F_VBUS) | TLM_FIELD(TLM_F_PD);
+    rx_t rx;
+
+    cap_len = 0;
+    vt_ms = 10000;
+    TLM_Hello();                    // next flush is a keyframe
+    TLM_State(TLM_F_FLAGS, TLM_ST_ONLINE);
+    TLM_State(TLM_F_VBUS, 5000);
+    TLM_State(TLM_F_PD, 0x12345678);
+    TLM_State(TLM_F_CMD_LINES, 7);  // not subscribed
+    TLM_StateFlush(live);
+    vt_ms += 100;
+    TLM_State(TLM_F_FLAGS, TLM_ST_ONLINE);
+    TLM_State(TLM_F_VBUS, 9000);
+    TLM_StateFlush(live);
+    vt_ms += 100;
+    TLM_State(TLM_F_VBUS, 9000);
+    TLM_StateFlush(live);           // unchanged: nothing sent
+
+    receive(&rx, cap, cap_len);
+    CHECK_EQ(rx.frames, 3);
+    frame_t *k = &rx.f[1], *d = &rx.f[2];
+    CHECK_EQ(k->type, TLM_MSG_STATE);
+    CHECK_EQ(get16(&k->payload[4]), live | TLM_STATE_KEY);
+    CHECK_EQ(k->len, 6 + 1 + 2 + 4);
+    CHECK_EQ(k->payload[6], TLM_ST_ONLINE);
+    CHECK_EQ(get16(&k->payload[7]), 5000);
+    CHECK_EQ(get32(&k->payload[9]), 0x12345678);
+    CHECK_EQ(get16(&d->payload[4]), TLM_FIELD(TLM_F_VBUS));
+    CHECK_EQ(d->len, 6 + 2);
+    CHECK_EQ(get16(&d->payload[6]), 9000);
+
+    // A refused delta stays dirty; a subscription brings its field in
+    cap_len = 0;
+    TLM_State(TLM_F_VBUS, 12000);
+    refuse = true;
+    TLM_StateFlush(live);
+    refuse = false;
+    TLM_StateFlush(live | TLM_FIELD(TLM_F_CMD_LINES));
+    vt_ms += TLM_KEY_MS;
+    TLM_StateFlush(live);           // keyframe is due again
+    receive(&rx, cap, cap_len);
+    CHECK_EQ(rx.frames, 2);
+    CHECK_EQ(get16(&rx.f[0].payload[4]), TLM_FIELD(TLM_F_VBUS) | TLM_FIELD(TLM_F_CMD_LINES));
+    CHECK_EQ(get16(&rx.f[0].payload[6]), 12000);
+    CHECK_EQ(get32(&rx.f[0].payload[8]), 7);
+    CHECK_EQ(get16(&rx.f[1].payload[4]), live | TLM_STATE_KEY);
+}
+
+
+/*A stream for tlmdec, and the lines it should print for it*/
+static void test_capture(void) {
+    const char *path = getenv("TLM_CAPTURE");
+    char name[512];
+    FILE *bin, *txt;
+
+    if (path == NULL) {
+        return;
+    }
+    cap_len = 0;
+    TLM_Event(TLM_EV_PDO_DONE, 1, 9000);    // cut below: tlmdec starts mid-frame
+    size_t skip = 3;
+    vt_ms = 20000;
+    TLM_Hello();
+    TLM_State(TLM_F_FLAGS, TLM_ST_ONLINE | TLM_ST_CONTRACT);
+    TLM_State(TLM_F_VBUS, 9000);
+    TLM_StateFlush(TLM_FIELD(TLM_F_FLAGS) | TLM_FIELD(TLM_F_VBUS));
+    TLM_Text("pd: ok\r\n", 8);
+    size_t bad = cap_len;
+    TLM_Text("lost\r\n", 6);                // corrupted below
+    cap[bad + 2] ^= 0x40;
+    vt_ms += 5;
+    TLM_Event(TLM_EV_PDO_REQUEST, 2, 12000);
+
+    snprintf(name, sizeof(name), "%s.bin", path);
+    bin = fopen(name, "wb");
+    snprintf(name, sizeof(name), "%s.txt", path);
+    txt = fopen(name, "w");
+    CHECK(bin != NULL && txt != NULL);
+    if (bin == NULL || txt == NULL) {
+        return;
+    }
+    fwrite(&cap[skip], 1, cap_len - skip, bin);
+    fprintf(txt, "%10u hello schema=%u build=\n", 20000u, TLM_SCHEMA);
+    fprintf(txt, "%10u state key flags=0x%02X vbus=%u\n", 20000u,
+            TLM_ST_ONLINE | TLM_ST_CONTRACT, 9000u);
+    fprintf(txt, "pd: ok\r\n");
+    fprintf(txt, "%10u event pdo_request arg=2 mv=12000\n", 20005u);
+    fclose(bin);
+    fclose(txt);
+}
+
+
+int main(void) {
+    test_crc_check_value();
+    test_encode_round_trip();
+    test_send_round_trip();
+    test_resync();
+    test_state_delta();
+    test_capture();
+    return TEST_Done("tlm_test");
+}
@@ -0,0 +1,181 @@
+// uarttx_test - uarttx.c against its simulated UART on a virtual clock: the
+// ring overfilled under each policy, with the counters, the bytes that reach
+// the wire, and the time the wire takes to drain at 115200 baud checked.
+
+#include "uarttx.h"
+#include "crit.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BAUD        115200U
+#define MSG_LEN     100
+#define MSGS        20
+#define TOTAL       (MSG_LEN * MSGS)
+
+static uint32_t vt_us;
+static uint32_t spin_us;        // what each look at the clock costs
+static char src[TOTAL];
+static FILE *wire_file;
+static char *wire;
+static size_t wire_len;
+
+// crit.c and timebase.c stand-ins: the virtual clock only moves when the
+// test moves it, or by spin_us per read while a writer waits for room
+crit_stats_t crit_stats[CRIT_LEVELS];
+
+uint32_t TIMEBASE_Micros(void) {
+    vt_us += spin_us;
+    return vt_us;
+}
+
+static void reset(uarttx_policy_t policy) {
+    if (wire_file != NULL) {
+        fclose(wire_file);
+        free(wire);
+    }
+    wire_file = open_memstream(&wire, &wire_len);
+    vt_us = 0xFFFF0000u;            // wraps while draining
+    spin_us = 0;
+    UARTTX_SimInit(BAUD, wire_file);
+    UARTTX_Init(policy);
+}
+
+/*Write the whole of src, MSG_LEN at a time; returns the messages accepted*/
+static int overfill(void) {
+    int accepted = 0;
+    for (int i = 0; i < MSGS; i++) {
+        accepted += UARTTX_Write(&src[i * MSG_LEN], MSG_LEN) == MSG_LEN;
+    }
+    return accepted;
+}
+
+/*Run the clock until the wire is idle; returns how long that took*/
+static uint32_t drain(void) {
+    uint32_t start = vt_us;
+    spin_us = 0;
+    while (UARTTX_Pending()) {
+        vt_us++;
+    }
+    fflush(wire_file);
+    return vt_us - start;
+}
+
+/*Time 'n' bytes take on the wire: 10 bits each*/
+static uint32_t wire_us(uint32_t n) {
+    return (uint32_t)((uint64_t)n * 10U * 1000000U / BAUD);
+}
+
+/*Each chunk may complete up to a microsecond early (whole microseconds) or
+  late (polled every microsecond)*/
+static bool near(uint32_t us, uint32_t n) {
+    uint32_t chunks = (n + UARTTX_CHUNK - 1) / UARTTX_CHUNK;
+    return us + chunks >= wire_us(n) && us <= wire_us(n) + chunks;
+}
+
+
+/*A write that does not fit is refused whole; what was queued goes out*/
+static void test_drop_newest(void) {
+    reset(UARTTX_DROP_NEWEST);
+    // Ring plus the chunk already in flight: 10 messages fit, not 11
+    CHECK_EQ(overfill(), 10);
+    CHECK_EQ(UARTTX_Pending(), 10 * MSG_LEN);
+
+    const uarttx_stats_t *st = UARTTX_Stats();
+    CHECK_EQ(st->written, 10 * MSG_LEN);
+    CHECK_EQ(st->dropped, 10 * MSG_LEN);
+    CHECK_EQ(st->blocked, 0);
+    CHECK_EQ(st->high_water, 10 * MSG_LEN - UARTTX_CHUNK);
+    CHECK_EQ(st->sent, 0);
+
+    uint32_t t = drain();
+    CHECK(near(t, 10 * MSG_LEN));
+    CHECK_EQ(st->sent, 10 * MSG_LEN);
+    CHECK_EQ(wire_len, 10 * MSG_LEN);
+    CHECK(memcmp(wire, src, 10 * MSG_LEN) == 0);
+}
+
+
+/*Every write is taken; the oldest queued bytes make room. The chunk in
+  flight is not in the ring and always completes.*/
+static void test_drop_oldest(void) {
+    uint32_t kept = UARTTX_CHUNK + UARTTX_RING_SIZE;
+
+    reset(UARTTX_DROP_OLDEST);
+    CHECK_EQ(overfill(), MSGS);
+    CHECK_EQ(UARTTX_Pending(), kept);
+
+    const uarttx_stats_t *st = UARTTX_Stats();
+    CHECK_EQ(st->written, TOTAL);
+    CHECK_EQ(st->dropped, TOTAL - kept);
+    CHECK_EQ(st->blocked, 0);
+    CHECK_EQ(st->high_water, UARTTX_RING_SIZE);
+
+    uint32_t t = drain();
+    CHECK(near(t, kept));
+    CHECK_EQ(st->sent, kept);
+    CHECK_EQ(st->written, st->sent + st->dropped);
+    CHECK_EQ(wire_len, kept);
+    CHECK(memcmp(wire, src, UARTTX_CHUNK) == 0);
+    CHECK(memcmp(&wire[UARTTX_CHUNK], &src[TOTAL - UARTTX_RING_SIZE], UARTTX_RING_SIZE) == 0);
+}
+
+
+/*Writers wait for the wire: nothing is lost, and the wire never idles, so
+  the writes and the drain together take as long as the bytes do*/
+static void test_block(void) {
+    uint32_t start;
+
+    reset(UARTTX_BLOCK);
+    start = vt_us;
+    spin_us = 1;
+    CHECK_EQ(overfill(), MSGS);
+
+    const uarttx_stats_t *st = UARTTX_Stats();
+    CHECK_EQ(st->written, TOTAL);
+    CHECK_EQ(st->dropped, 0);
+    CHECK_EQ(st->blocked, MSGS - 10);      // every write after the ring filled
+    CHECK(st->high_water > UARTTX_RING_SIZE - MSG_LEN);
+    CHECK(st->high_water <= UARTTX_RING_SIZE);
+    // The last write waited for room, not for the wire
+    CHECK(UARTTX_Pending() > UARTTX_RING_SIZE - UARTTX_CHUNK);
+
+    drain();
+    CHECK(near(vt_us - start, TOTAL));
+    CHECK_EQ(st->sent, TOTAL);
+    CHECK_EQ(wire_len, TOTAL);
+    CHECK(memcmp(wire, src, TOTAL) == 0);
+}
+
+
+/*A write longer than the ring keeps its newest bytes, under any policy*/
+static void test_longer_than_ring(void) {
+    static char big[UARTTX_RING_SIZE + 300];
+
+    for (size_t i = 0; i < sizeof(big); i++) {
+        big[i] = (char)(i * 7);
+    }
+    reset(UARTTX_DROP_NEWEST);
+    CHECK_EQ(UARTTX_Write(big, sizeof(big)), UARTTX_RING_SIZE);
+    CHECK_EQ(UARTTX_Stats()->dropped, 300);
+    CHECK(near(drain(), UARTTX_RING_SIZE));
+    CHECK_EQ(wire_len, UARTTX_RING_SIZE);
+    CHECK(memcmp(wire, &big[300], UARTTX_RING_SIZE) == 0);
+}
+
+
+int main(void) {
+    for (int i = 0; i < TOTAL; i++) {
+        src[i] = (char)('A' + i / MSG_LEN);
+        if (i % MSG_LEN >= MSG_LEN - 3) {
+            src[i] = (char)('0' + i % 10);    // tell the copies apart
+        }
+    }
+    test_drop_newest();
+    test_drop_oldest();
+    test_block();
+    test_longer_than_ring();
+    fclose(wire_file);
+    free(wire);
+    return TEST_Done("uarttx_test");
+}
@@ -0,0 +1,222 @@
+// baudneg - negotiate a faster USART2 rate with the firmware.
+//
+// The device always boots at 115200. This asks it for a higher rate with
+// "baud <rate>", waits for the "ok" that still travels at 115200,
+// switches the local port and confirms with "ping" at the new rate. A
+// device that isn't confirmed within LINK_CONFIRM_MS goes back to 115200
+// by itself, and so does this tool, so a failed attempt leaves both ends
+// at the base rate (see Core/Inc/link.h). Text replies only: with
+// -DPDT_TLM they travel in frames, use tlmdec -b afterwards instead.
+//
+// Build:  g++ -O2 -std=c++17 -o baudneg baudneg.cpp
+// Usage:  baudneg [-r rate] [-f] [-v] /dev/ttyACM0
+//         baudneg [-r rate] [-f] [-v] -e "./linksim"
+//
+//   -r rate   rate to ask for (default 2000000)
+//   -e cmd    run cmd as the device on a pseudo-terminal instead
+//             (tools/linksim.c is the firmware's side built for the host)
+//   -f        afterwards, return to 115200 without telling the device and
+//             check that its error-rate fallback brings it back too
+//   -v        print the device's other output to stderr
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "serial.hpp"
+
+namespace {
+
+using pdt::set_baud;
+
+constexpr long kBaseBaud = 115200;          // LINK_BASE_BAUD
+constexpr int kSwitchMs = 20;               // LINK_SWITCH_MS
+constexpr int kConfirmMs = 1000;            // LINK_CONFIRM_MS
+constexpr int kCheckMs = 250;               // LINK_CHECK_MS
+constexpr int kPingMs = 100;                // reply wait per ping
+
+bool verbose = false;
+
+void sleep_ms(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// Line-oriented view of the port: replies are "ok" and "err <reason>",
+// anything else is log output
+class Port {
+public:
+    explicit Port(int fd) : fd_(fd) {}
+
+    bool baud(long rate) {
+        in_.clear();
+        return set_baud(fd_, rate);
+    }
+
+    bool send(const std::string &cmd) {
+        std::string s = cmd + "\r\n";
+        return write(fd_, s.data(), s.size()) == (ssize_t)s.size();
+    }
+
+    // Next reply within ms, "" on timeout
+    std::string reply(int ms) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        for (;;) {
+            std::string l;
+            while (next_line(l)) {
+                if (l == "ok" || l.compare(0, 4, "err ") == 0) {
+                    return l;
+                }
+                if (verbose && !l.empty()) {
+                    std::fprintf(stderr, "  | %s\n", l.c_str());
+                }
+            }
+            int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                end - std::chrono::steady_clock::now()).count();
+            if (left <= 0) {
+                return "";
+            }
+            struct pollfd p = { fd_, POLLIN, 0 };
+            if (poll(&p, 1, left) <= 0 || (p.revents & POLLIN) == 0) {
+                if (p.revents & (POLLHUP | POLLERR)) {
+                    return "";
+                }
+                continue;
+            }
+            char buf[256];
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n <= 0) {
+                return "";
+            }
+            in_.append(buf, (size_t)n);
+        }
+    }
+
+    // "ping" until it is answered, for up to ms
+    bool ping(int ms) {
+        for (int t = 0; t < ms; t += kPingMs) {
+            if (send("ping") && reply(kPingMs) == "ok") {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    bool next_line(std::string &l) {
+        size_t i = in_.find_first_of("\r\n");
+        if (i == std::string::npos) {
+            return false;
+        }
+        l = in_.substr(0, i);
+        in_.erase(0, i + 1);
+        return true;
+    }
+
+    int fd_;
+    std::string in_;
+};
+
+int negotiate(Port &port, long rate) {
+    if (!port.baud(kBaseBaud)) {
+        std::fprintf(stderr, "cannot set %ld baud\n", kBaseBaud);
+        return 1;
+    }
+    if (!port.ping(3 * kPingMs)) {
+        // Left fast by an earlier session?
+        if (port.baud(rate) && port.ping(3 * kPingMs)) {
+            std::printf("already at %ld baud\n", rate);
+            return 0;
+        }
+        std::fprintf(stderr, "no answer at %ld baud\n", kBaseBaud);
+        return 1;
+    }
+
+    port.send("baud " + std::to_string(rate));
+    std::string r = port.reply(500);
+    if (r != "ok") {
+        std::fprintf(stderr, "baud %ld refused: %s\n", rate, r.empty() ? "no reply" : r.c_str());
+        return 1;
+    }
+    if (!port.baud(rate)) {
+        std::fprintf(stderr, "this port cannot do %ld baud\n", rate);
+    } else {
+        sleep_ms(2 * kSwitchMs);
+        if (port.ping(kConfirmMs - 4 * kSwitchMs)) {
+            std::printf("link at %ld baud\n", rate);
+            return 0;
+        }
+    }
+
+    // The device gives up at kConfirmMs on its own
+    sleep_ms(kConfirmMs);
+    port.baud(kBaseBaud);
+    std::fprintf(stderr, "%ld baud not confirmed, %s at %ld\n", rate,
+                 port.ping(3 * kPingMs) ? "back" : "no answer", kBaseBaud);
+    return 1;
+}
+
+// Talk at the base rate to a device left fast: its RX errors must bring it back
+int check_fallback(Port &port) {
+    port.baud(kBaseBaud);
+    if (port.ping(kConfirmMs + 4 * kCheckMs)) {
+        std::printf("device fell back to %ld baud\n", kBaseBaud);
+        return 0;
+    }
+    std::fprintf(stderr, "device did not fall back\n");
+    return 1;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long rate = 2000000;
+    const char *sim = nullptr;
+    bool fallback = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:e:fv")) != -1) {
+        switch (opt) {
+        case 'r': rate = std::strtol(optarg, nullptr, 10); break;
+        case 'e': sim = optarg; break;
+        case 'f': fallback = true; break;
+        case 'v': verbose = true; break;
+        default:
+            std::fprintf(stderr, "usage: %s [-r rate] [-f] [-v] tty | -e cmd\n", argv[0]);
+            return 2;
+        }
+    }
+
+    int fd;
+    pid_t pid = -1;
+    if (sim != nullptr) {
+        fd = pdt::spawn_on_pty(sim, &pid);
+    } else if (optind < argc) {
+        fd = open(argv[optind], O_RDWR | O_NOCTTY);
+    } else {
+        std::fprintf(stderr, "usage: %s [-r rate] [-f] [-v] tty | -e cmd\n", argv[0]);
+        return 2;
+    }
+    if (fd < 0) {
+        std::fprintf(stderr, "%s: %s\n", sim ? sim : argv[optind], std::strerror(errno));
+        return 1;
+    }
+
+    Port port(fd);
+    int rc = negotiate(port, rate);
+    if (rc == 0 && fallback) {
+        rc = check_fallback(port);
+    }
+    close(fd);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return rc;
+}
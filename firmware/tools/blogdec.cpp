@@ -0,0 +1,382 @@
+// blogdec - decode the PDT_BLOG binary log stream back into text.
+//
+// The firmware sends (varint id, varint args...) records; the format
+// strings only exist in the .blog_fmt section of the firmware ELF (see
+// Core/Inc/blog.h). This tool reads that section and formats on the host.
+//
+// Build:  g++ -O2 -std=c++17 -o blogdec blogdec.cpp
+// Usage:  blogdec [-b baud] [-s] firmware.elf [capture|-|/dev/ttyACM0]
+//
+//   -b baud   configure a serial device as raw 8N1 at this rate
+//   -s        print byte counts and decode throughput to stderr at the end
+//
+// The decoder is a byte-at-a-time state machine, so captures can be fed
+// in arbitrary chunks, and a record's format is parsed once and cached.
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+struct Section {
+    uint64_t addr = 0;
+    std::vector<char> data;
+};
+
+template <typename T>
+T get(const std::vector<char> &f, size_t off) {
+    T v{};
+    if (off + sizeof(T) <= f.size()) {
+        std::memcpy(&v, f.data() + off, sizeof(T));
+    }
+    return v;
+}
+
+// Minimal little-endian ELF32/ELF64 section lookup
+bool load_section(const char *path, const char *want, Section &out) {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> f((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (f.size() < 64 || std::memcmp(f.data(), "\x7f" "ELF", 4) != 0 || f[5] != 1) {
+        std::fprintf(stderr, "%s: not a little-endian ELF file\n", path);
+        return false;
+    }
+    bool is64 = f[4] == 2;
+    uint64_t shoff = is64 ? get<uint64_t>(f, 0x28) : get<uint32_t>(f, 0x20);
+    uint16_t shentsize = get<uint16_t>(f, is64 ? 0x3A : 0x2E);
+    uint16_t shnum = get<uint16_t>(f, is64 ? 0x3C : 0x30);
+    uint16_t shstrndx = get<uint16_t>(f, is64 ? 0x3E : 0x32);
+
+    auto sh = [&](uint16_t i, uint64_t &name, uint64_t &addr, uint64_t &off, uint64_t &size) {
+        size_t b = shoff + (size_t)i * shentsize;
+        name = get<uint32_t>(f, b);
+        addr = is64 ? get<uint64_t>(f, b + 0x10) : get<uint32_t>(f, b + 0x0C);
+        off = is64 ? get<uint64_t>(f, b + 0x18) : get<uint32_t>(f, b + 0x10);
+        size = is64 ? get<uint64_t>(f, b + 0x20) : get<uint32_t>(f, b + 0x14);
+    };
+    uint64_t n, a, strtab, s;
+    sh(shstrndx, n, a, strtab, s);
+    for (uint16_t i = 0; i < shnum; i++) {
+        uint64_t off, size;
+        sh(i, n, a, off, size);
+        if (strtab + n < f.size() && std::strcmp(f.data() + strtab + n, want) == 0 &&
+            off + size <= f.size()) {
+            out.addr = a;
+            out.data.assign(f.begin() + off, f.begin() + off + size);
+            return true;
+        }
+    }
+    std::fprintf(stderr, "%s: no %s section (built without PDT_BLOG?)\n", path, want);
+    return false;
+}
+
+// A format string split into literals and integer conversions
+struct Format {
+    enum Kind { LIT, SIGNED, UNSIGNED, CHAR, MILLIVOLT };
+    struct Part {
+        Kind kind;
+        std::string text;   // literal, or the conversion spec without length modifier
+        unsigned decimals = 3;  // MILLIVOLT: digits after the point
+    };
+    std::vector<Part> parts;
+    unsigned nargs = 0;
+    bool ok = true;
+};
+
+Format compile(const char *s) {
+    Format fmt;
+    std::string lit;
+    while (*s) {
+        if (*s != '%') {
+            lit += *s++;
+            continue;
+        }
+        if (s[1] == '%') {
+            lit += '%';
+            s += 2;
+            continue;
+        }
+        std::string spec = "%";
+        s++;
+        while (*s && std::strchr("-+ #0", *s)) spec += *s++;
+        while (*s >= '0' && *s <= '9') spec += *s++;
+        std::string prec;
+        if (*s == '.') {
+            prec += *s++;
+            while (*s >= '0' && *s <= '9') prec += *s++;
+        }
+        while (*s == 'l' || *s == 'h') s++;     // every argument is 32 bits on the wire
+        Format::Kind kind;
+        switch (*s) {
+        case 'd': case 'i':             kind = Format::SIGNED; break;
+        case 'u': case 'x': case 'X':
+        case 'o':                       kind = Format::UNSIGNED; break;
+        case 'c':                       kind = Format::CHAR; break;
+        case 'V':                       kind = Format::MILLIVOLT; break;
+        default:                        fmt.ok = false; return fmt;
+        }
+        s++;
+        if (!lit.empty()) {
+            fmt.parts.push_back({Format::LIT, lit});
+            lit.clear();
+        }
+        if (kind == Format::MILLIVOLT) {
+            // fmt.c's %V: volts, rounded to 0..3 decimals, padded like %s
+            unsigned d = prec.size() > 1 ? (unsigned)std::atoi(prec.c_str() + 1) : 3;
+            fmt.parts.push_back({kind, spec + "s", d > 3 ? 3 : d});
+        } else {
+            fmt.parts.push_back({kind, spec + prec + s[-1]});
+        }
+        fmt.nargs++;
+    }
+    if (!lit.empty()) {
+        fmt.parts.push_back({Format::LIT, lit});
+    }
+    return fmt;
+}
+
+// Millivolts as volts with 'decimals' digits, rounded half up
+std::string volts(uint32_t mv, unsigned decimals) {
+    static const uint32_t unit[4] = { 1000, 100, 10, 1 };
+    uint64_t q = mv / unit[decimals] + (mv % unit[decimals] >= unit[decimals] / 2 && decimals < 3);
+    std::string s = std::to_string(q);
+    if (decimals > 0) {
+        s.insert(0, decimals + 1 > s.size() ? decimals + 1 - s.size() : 0, '0');
+        s.insert(s.size() - decimals, ".");
+    }
+    return s;
+}
+
+class Decoder {
+public:
+    explicit Decoder(Section sec) : sec_(std::move(sec)) {}
+
+    void feed(const uint8_t *p, size_t n, std::string &out) {
+        for (size_t i = 0; i < n; i++) {
+            byte(p[i], out);
+        }
+    }
+
+    uint64_t records = 0, errors = 0;
+
+private:
+    enum State { ID, ARG, TEXT_LEN, TEXT };
+
+    void byte(uint8_t b, std::string &out) {
+        if (state_ == TEXT) {
+            out += (char)b;
+            if (--left_ == 0) {
+                state_ = ID;
+                records++;
+            }
+            return;
+        }
+        acc_ |= (uint32_t)(b & 0x7F) << shift_;
+        shift_ += 7;
+        if (b & 0x80) {
+            if (shift_ > 28) {      // not a 32-bit varint: resync on the next byte
+                errors++;
+                reset_varint();
+                state_ = ID;
+            }
+            return;
+        }
+        uint32_t v = acc_;
+        reset_varint();
+
+        switch (state_) {
+        case ID:
+            if (v == 0) {
+                state_ = TEXT_LEN;
+                return;
+            }
+            fmt_ = lookup(v);
+            if (fmt_ == nullptr) {
+                errors++;
+                out += "<?id " + std::to_string(v) + ">\n";
+                return;
+            }
+            args_.clear();
+            if (fmt_->nargs == 0) {
+                emit(out);
+            } else {
+                state_ = ARG;
+            }
+            return;
+        case ARG:
+            args_.push_back(v);
+            if (args_.size() == fmt_->nargs) {
+                emit(out);
+                state_ = ID;
+            }
+            return;
+        case TEXT_LEN:
+            left_ = v;
+            state_ = v ? TEXT : ID;
+            return;
+        case TEXT:
+            return;
+        }
+    }
+
+    void reset_varint() {
+        acc_ = 0;
+        shift_ = 0;
+    }
+
+    const Format *lookup(uint32_t id) {
+        auto it = cache_.find(id);
+        if (it != cache_.end()) {
+            return it->second.ok ? &it->second : nullptr;
+        }
+        uint64_t off = (uint64_t)id - 1 - sec_.addr;
+        Format f;
+        if (off >= sec_.data.size() ||
+            std::memchr(sec_.data.data() + off, 0, sec_.data.size() - off) == nullptr) {
+            f.ok = false;
+        } else {
+            f = compile(sec_.data.data() + off);
+        }
+        auto r = cache_.emplace(id, std::move(f));
+        return r.first->second.ok ? &r.first->second : nullptr;
+    }
+
+    void emit(std::string &out) {
+        char buf[64];
+        size_t a = 0;
+        for (const auto &p : fmt_->parts) {
+            int n = 0;
+            switch (p.kind) {
+            case Format::LIT:
+                out += p.text;
+                continue;
+            case Format::SIGNED:
+                n = std::snprintf(buf, sizeof(buf), p.text.c_str(), (int)(int32_t)args_[a++]);
+                break;
+            case Format::UNSIGNED:
+                n = std::snprintf(buf, sizeof(buf), p.text.c_str(), (unsigned)args_[a++]);
+                break;
+            case Format::CHAR:
+                n = std::snprintf(buf, sizeof(buf), p.text.c_str(), (int)(args_[a++] & 0xFF));
+                break;
+            case Format::MILLIVOLT:
+                n = std::snprintf(buf, sizeof(buf), p.text.c_str(),
+                                  volts(args_[a++], p.decimals).c_str());
+                break;
+            }
+            if (n > 0) {
+                out.append(buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+            }
+        }
+        records++;
+    }
+
+    Section sec_;
+    std::unordered_map<uint32_t, Format> cache_;
+    State state_ = ID;
+    uint32_t acc_ = 0;
+    unsigned shift_ = 0;
+    uint32_t left_ = 0;
+    const Format *fmt_ = nullptr;
+    std::vector<uint32_t> args_;
+};
+
+bool set_baud(int fd, long baud) {
+    static const struct { long rate; speed_t code; } rates[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+        {115200, B115200}, {230400, B230400}, {460800, B460800},
+        {921600, B921600}, {1000000, B1000000}, {2000000, B2000000},
+    };
+    struct termios t;
+    if (tcgetattr(fd, &t) != 0) {
+        return false;
+    }
+    for (const auto &r : rates) {
+        if (r.rate == baud) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, r.code);
+            cfsetospeed(&t, r.code);
+            return tcsetattr(fd, TCSANOW, &t) == 0;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long baud = 0;
+    bool stats = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s")) != -1) {
+        switch (opt) {
+        case 'b': baud = std::strtol(optarg, nullptr, 10); break;
+        case 's': stats = true; break;
+        default:
+            std::fprintf(stderr, "usage: %s [-b baud] [-s] firmware.elf [capture|-|tty]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (optind >= argc) {
+        std::fprintf(stderr, "usage: %s [-b baud] [-s] firmware.elf [capture|-|tty]\n", argv[0]);
+        return 2;
+    }
+    Section sec;
+    if (!load_section(argv[optind], ".blog_fmt", sec)) {
+        return 1;
+    }
+    int fd = 0;
+    if (optind + 1 < argc && std::strcmp(argv[optind + 1], "-") != 0) {
+        fd = open(argv[optind + 1], O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            std::fprintf(stderr, "%s: %s\n", argv[optind + 1], std::strerror(errno));
+            return 1;
+        }
+    }
+    if (baud && !set_baud(fd, baud)) {
+        std::fprintf(stderr, "cannot set %ld baud on the input\n", baud);
+        return 1;
+    }
+
+    Decoder dec(std::move(sec));
+    std::vector<uint8_t> buf(1 << 16);
+    std::string out;
+    uint64_t in_bytes = 0, out_bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (;;) {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        in_bytes += (uint64_t)n;
+        dec.feed(buf.data(), (size_t)n, out);
+        out_bytes += out.size();
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);    // live output from a serial port
+        out.clear();
+    }
+    if (stats) {
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::fprintf(stderr, "%llu bytes in, %llu bytes of text (%.1fx), %llu records, "
+                     "%llu errors, %.1f MB/s\n",
+                     (unsigned long long)in_bytes, (unsigned long long)out_bytes,
+                     in_bytes ? (double)out_bytes / (double)in_bytes : 0.0,
+                     (unsigned long long)dec.records, (unsigned long long)dec.errors,
+                     s > 0 ? (double)in_bytes / s / 1e6 : 0.0);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+// fmtbench - check fmt.c against the C library and time both.
+//
+// Every case is a format string the firmware uses, with typical
+// arguments. Each one is first formatted by FMT_Format and by snprintf
+// and the outputs compared; %V, which the C library lacks, is checked
+// against fixed strings instead. Then each formatter runs every case in
+// a loop, and the time per call is printed, in TSC cycles on x86.
+//
+// The host's vsnprintf is glibc's, not newlib-nano's. Both share the
+// general-purpose design, but the numbers are only a guide to the
+// target's; tools/fmtsize.sh compares code size on the target.
+//
+// Build (from firmware/, with F=pdtrigger_firmware/Core):
+//         gcc -O2 -I$F/Inc -o fmtbench tools/fmtbench.c $F/Src/fmt.c
+// Usage:  fmtbench [iterations]
+
+#include "fmt.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+typedef size_t (*format_fn)(char *buf, size_t size, const char *fmt, va_list args);
+
+static size_t libc_vformat(char *buf, size_t size, const char *fmt, va_list args) {
+    int n = vsnprintf(buf, size, fmt, args);
+    return (n < 0) ? 0 : ((size_t)n < size ? (size_t)n : size - 1);
+}
+
+static size_t call(format_fn fn, char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    size_t n = fn(buf, size, fmt, args);
+    va_end(args);
+    return n;
+}
+
+// One case, through either formatter
+static void run_case(format_fn fn, unsigned i, char *buf, size_t size) {
+    switch (i) {
+    case 0:
+        call(fn, buf, size, "PD event: 0x%02X\r\n", 0x03);
+        break;
+    case 1:
+        call(fn, buf, size, ">> Requested PDO[%u], V=%u mV\r\n", 3U, 15000U);
+        break;
+    case 2:
+        call(fn, buf, size, "%-10s %6lu %9lu %8lu %9lu %6lu\r\n", "pd_int", 1234UL, 56UL,
+             789UL, 12UL, 0UL);
+        break;
+    case 3:
+        call(fn, buf, size, "uart tx (%s): %lu written, %lu sent, %lu dropped, %lu blocked, "
+             "%lu errors\r\n", "drop-newest", 123456UL, 123400UL, 56UL, 0UL, 0UL);
+        break;
+    case 4:
+        call(fn, buf, size, "pdo %u/%u vbus %u mV%s%s%s%s\r\n", 2U, 2U, 12012U, " online",
+             " contract", " vbus_ok", "");
+        break;
+    case 5:
+        call(fn, buf, size, "PD status: 0x%08lX\r\n", 0x00000400UL);
+        break;
+    case 6:
+        call(fn, buf, size, "  %2u%s %lu, %lu\r\n", 5U, "", 42UL, 1680UL);
+        break;
+    default:
+        call(fn, buf, size, "#%lu | %s", 17UL, "sub vbus every 100 ms\r\n");
+        break;
+    }
+}
+#define CASES   8
+
+static int failures;
+
+static void expect(const char *got, const char *want) {
+    if (strcmp(got, want) != 0) {
+        printf("mismatch: got \"%s\", want \"%s\"\n", got, want);
+        failures++;
+    }
+}
+
+// Same output as the C library for everything the C library also knows
+static void check(void) {
+    static const struct { const char *fmt; long v; } ints[] = {
+        {"%d", 0}, {"%d", -1}, {"%d", 2147483647L}, {"%d", -2147483647L - 1},
+        {"%5d", -42}, {"%-5d|", -42}, {"%05d", -42}, {"%u", 4294967295UL},
+        {"%x", 0xBEEF}, {"%X", 0xBEEF}, {"%08X", 0xBEEF}, {"%-6x|", 0xAB}, {"%2u", 123},
+        {"%c", 'A'}, {"%3c|", 'B'}, {"%-3c|", 'C'}, {"100%%", 0},
+    };
+    static const struct { const char *fmt; const char *s; } strs[] = {
+        {"%s", "abc"}, {"%-10s|", "abc"}, {"%8s", "abc"}, {"%.2s", "abc"}, {"%s", ""},
+        {"%2s", "abcdef"},
+    };
+    char a[128], b[128];
+
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        FMT_Format(a, sizeof(a), ints[i].fmt, (int)ints[i].v);
+        snprintf(b, sizeof(b), ints[i].fmt, (int)ints[i].v);
+        expect(a, b);
+    }
+    for (size_t i = 0; i < sizeof(strs) / sizeof(strs[0]); i++) {
+        FMT_Format(a, sizeof(a), strs[i].fmt, strs[i].s);
+        snprintf(b, sizeof(b), strs[i].fmt, strs[i].s);
+        expect(a, b);
+    }
+    for (unsigned i = 0; i < CASES; i++) {
+        run_case(FMT_Vformat, i, a, sizeof(a));
+        run_case(libc_vformat, i, b, sizeof(b));
+        expect(a, b);
+    }
+    FMT_Format(a, sizeof(a), "%lu %ld", 4000000000UL, -5L);
+    snprintf(b, sizeof(b), "%lu %ld", 4000000000UL, -5L);
+    expect(a, b);
+
+    // Truncation: always terminated, length is what was written
+    size_t n = FMT_Format(a, 6, "%s", "truncated");
+    expect(a, "trunc");
+    if (n != 5) {
+        printf("truncated length %zu, want 5\n", n);
+        failures++;
+    }
+    FMT_Format(a, sizeof(a), "%q %");
+    expect(a, "%q %");
+
+    // Millivolts
+    FMT_Format(a, sizeof(a), "%V %V %V %.1V %.0V %.2V %7V|%-7V|", 9000U, 5U, 20000U, 9050U,
+               14500U, 12345U, 5000U, 5000U);
+    expect(a, "9.000 0.005 20.000 9.1 15 12.35   5.000|5.000  |");
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench(const char *name, format_fn fn, long iters) {
+    char buf[128];
+    double t0 = now_ns();
+#ifdef HAVE_TSC
+    unsigned long long c0 = __rdtsc();
+#endif
+    for (long i = 0; i < iters; i++) {
+        for (unsigned c = 0; c < CASES; c++) {
+            run_case(fn, c, buf, sizeof(buf));
+        }
+        __asm__ volatile("" : : "r"(buf) : "memory");
+    }
+    double calls = (double)iters * CASES;
+    printf("%-10s %8.1f ns/call", name, (now_ns() - t0) / calls);
+#ifdef HAVE_TSC
+    printf(" %8.1f cycles/call", (double)(__rdtsc() - c0) / calls);
+#endif
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    long iters = (argc > 1) ? strtol(argv[1], NULL, 10) : 200000;
+
+    check();
+    if (failures) {
+        printf("%d mismatches\n", failures);
+        return 1;
+    }
+    printf("output matches the C library, %d cases timed\n", CASES);
+    bench("vsnprintf", libc_vformat, iters);
+    bench("fmt", FMT_Vformat, iters);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#!/bin/sh
+# fmtsize.sh - flash and stack cost of fmt.c against newlib's vsnprintf
+#
+# Links the same small program three times: with no formatter, with
+# FMT_Vformat (Core/Src/fmt.c) and with vsnprintf, and prints the
+# text+data of each, relative to the first. Then the stack use of
+# fmt.c's functions, from -fstack-usage.
+#
+# The comparison only means something against newlib-nano on the target,
+# so CC must be an arm-none-eabi compiler that has nano.specs; the script
+# refuses to run with anything else rather than print host numbers. The
+# toolchain used is printed with the results.
+#
+# Usage:  tools/fmtsize.sh
+#         (run from firmware/)
+#
+# Environment: CC, SIZE, OPT (default -O0, as the Debug build),
+# ARCH_FLAGS, LDFLAGS.
+
+set -e
+
+CC=${CC:-arm-none-eabi-gcc}
+SIZE=${SIZE:-arm-none-eabi-size}
+OPT=${OPT:--O0}
+ARCH_FLAGS=${ARCH_FLAGS:--mcpu=cortex-m4 -mthumb -mfpu=fpv4-sp-d16 -mfloat-abi=hard --specs=nano.specs}
+LDFLAGS=${LDFLAGS:---specs=nosys.specs -Wl,--gc-sections}
+PRJ=pdtrigger_firmware
+CFLAGS="-std=gnu11 $OPT -ffunction-sections -fdata-sections -I$PRJ/Core/Inc $ARCH_FLAGS"
+
+target=$($CC -dumpmachine 2>/dev/null || true)
+case $target in
+arm-none-eabi*) ;;
+"")
+    echo "fmtsize: $CC not found; no target numbers without the ARM toolchain" >&2
+    exit 1
+    ;;
+*)
+    echo "fmtsize: $CC targets $target, not arm-none-eabi" >&2
+    exit 1
+    ;;
+esac
+nano=$($CC -print-file-name=nano.specs)
+if [ "$nano" = nano.specs ]; then
+    echo "fmtsize: $CC has no newlib-nano (nano.specs not found)" >&2
+    exit 1
+fi
+echo "$($CC --version | head -n 1), $nano"
+echo
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# One call with the conversions the firmware uses
+cat > "$tmp/prog.c" <<'EOF'
+#include <stdarg.h>
+#include <stdio.h>
+#include "fmt.h"
+
+char buf[96];
+
+static size_t format(const char *fmt, ...) {
+    size_t n = 0;
+    va_list args;
+
+    va_start(args, fmt);
+#if defined(USE_FMT)
+    n = FMT_Vformat(buf, sizeof(buf), fmt, args);
+#elif defined(USE_LIBC)
+    n = (size_t)vsnprintf(buf, sizeof(buf), fmt, args);
+#endif
+    va_end(args);
+    return n;
+}
+
+int main(void) {
+    return (int)format("%-10s %8lu 0x%02X %d %c\r\n", "pd_int", 1UL, 2U, -3, 'x');
+}
+EOF
+
+# shellcheck disable=SC2086
+$CC $CFLAGS -fstack-usage -c $PRJ/Core/Src/fmt.c -o "$tmp/fmt.o"
+
+ref=""
+printf '%-12s %8s %8s\n' formatter bytes delta
+for cfg in none:-DUSE_NONE fmt:-DUSE_FMT vsnprintf:-DUSE_LIBC; do
+    name=${cfg%%:*}
+    defs=${cfg#*:}
+    # shellcheck disable=SC2086
+    $CC $CFLAGS $defs "$tmp/prog.c" "$tmp/fmt.o" $LDFLAGS -o "$tmp/$name.elf"
+    # text + data is what ends up in flash
+    bytes=$($SIZE "$tmp/$name.elf" | awk 'NR == 2 { print $1 + $2 }')
+    [ -z "$ref" ] && ref=$bytes
+    printf '%-12s %8d %+8d\n' "$name" "$bytes" $((bytes - ref))
+done
+
+echo
+echo "fmt.c stack (bytes per frame):"
+sed 's/^[^:]*:[0-9]*:[0-9]*:/    /' "$tmp/fmt.su"
@@ -0,0 +1,357 @@
+// linksim - the device end of the serial link, on the host.
+//
+// Runs the firmware's cmd.c, link.c and uarttx.c (built with -DPDT_HOST)
+// on stdin/stdout, which baudneg -e and rpcdemo -e connect to a
+// pseudo-terminal. The pty carries the line settings the host made on
+// its end: while those differ from the simulated USART2's rate, every
+// byte the host sends is lost as a framing error and every byte the
+// device sends arrives garbled, as on a real wire.
+//
+// Besides baud and ping it knows "status", "dump", "sub" (sub.c, with
+// the firmware's topics and text lines, on simulated readings) and
+// "pdo <index>", which, like the firmware's, is answered only once the
+// (simulated) change is done.
+//
+// Build (from firmware/, with F=pdtrigger_firmware/Core):
+//         gcc -O2 -DPDT_HOST -I$F/Inc -o linksim tools/linksim.c $F/Src/cmd.c
+//             $F/Src/link.c $F/Src/uarttx.c $F/Src/crit.c $F/Src/timebase.c
+//             $F/Src/sub.c $F/Src/fmt.c
+// Usage:  baudneg -e "./linksim [-m max] [-d ms]" [-r rate]
+//
+//   -m max    highest rate the simulated UART can be programmed for
+//   -d ms     hold received bytes this long, like a USB serial adapter's
+//             latency timer
+
+#define _GNU_SOURCE
+#include "cmd.h"
+#include "fmt.h"
+#include "link.h"
+#include "log.h"
+#include "sub.h"
+#include "uarttx.h"
+#include "timebase.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+uint8_t log_level[LOG_MODULES] = { LOG_LVL_INFO, LOG_LVL_INFO, LOG_LVL_INFO, LOG_LVL_INFO };
+
+#define PDO_CHANGE_MS   300     // request to VBUS settled
+#define RX_HOLD_MAX     1024
+
+static FILE *wire;
+static uint32_t uart_rate;
+static uint32_t max_rate = LINK_MAX_BAUD;
+static uint32_t hold_ms;
+
+
+/*Rate the host set on its end of the pty, 0 if unknown*/
+static uint32_t line_rate(void) {
+    static const struct { speed_t code; uint32_t rate; } rates[] = {
+        {B9600, 9600}, {B19200, 19200}, {B38400, 38400}, {B57600, 57600},
+        {B115200, 115200}, {B230400, 230400}, {B460800, 460800},
+        {B921600, 921600}, {B1000000, 1000000}, {B2000000, 2000000},
+    };
+    struct termios t;
+
+    if (tcgetattr(STDIN_FILENO, &t) != 0) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        if (rates[i].code == cfgetispeed(&t)) {
+            return rates[i].rate;
+        }
+    }
+    return 0;
+}
+
+
+/*What the simulated TX pin puts on the pty*/
+static ssize_t wire_write(void *cookie, const char *buf, size_t len) {
+    if (line_rate() == uart_rate) {
+        return write(STDOUT_FILENO, buf, len);
+    }
+    char junk[256];
+    size_t n = (len > sizeof(junk)) ? sizeof(junk) : len;
+    for (size_t i = 0; i < n; i++) {
+        junk[i] = (char)(buf[i] | 0x80);    // never a line end
+    }
+    return write(STDOUT_FILENO, junk, n);
+}
+
+
+static bool sim_apply(uint32_t rate) {
+    if (rate > max_rate) {
+        return false;
+    }
+    uart_rate = rate;
+    UARTTX_SimInit(rate, wire);
+    return true;
+}
+
+
+static uint32_t sim_ms(void) {
+    return TIMEBASE_Micros() / 1000U;
+}
+
+
+void LOG_Printf(const char *fmt, ...) {
+    char buf[128];
+    va_list args;
+
+    va_start(args, fmt);
+    size_t n = FMT_Vformat(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    UARTTX_Write(buf, (uint16_t)n);
+}
+
+
+/*Statistics go to stderr; stdout is the wire*/
+static void print_err(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
+
+
+static uint32_t link_at;            // ms of the next LINK_Poll, 0 = idle
+
+static const char *cmd_baud(uint8_t argc, char *argv[]) {
+    uint32_t rate;
+    const char *err;
+
+    if (argc == 1) {
+        LINK_Dump(CMD_Printf);
+        return NULL;
+    }
+    if (!CMD_ParseU32(argv[1], &rate)) {
+        return "range";
+    }
+    err = LINK_Request(rate);
+    if (err == NULL) {
+        link_at = sim_ms() + LINK_SWITCH_MS;
+    }
+    return err;
+}
+
+static const char *cmd_ping(uint8_t argc, char *argv[]) {
+    return NULL;
+}
+
+enum { TOPIC_VBUS, TOPIC_TYPEC, TOPIC_PD, TOPIC_CONTRACT, TOPIC_COUNTERS };
+
+static uint32_t sub_at;             // ms of the next SUB_Poll, 0 = nothing subscribed
+static uint8_t pdo_index;
+static uint8_t pdo_target;
+static uint32_t pdo_done_at;        // 0 = no change running
+static cmd_token_t pdo_waiter;
+
+static const char *cmd_pdo(uint8_t argc, char *argv[]) {
+    uint32_t index;
+
+    if (!CMD_ParseU32(argv[1], &index) || index >= 5) {
+        return "range";
+    }
+    CMD_Complete(&pdo_waiter, "superseded");
+    pdo_target = (uint8_t)index;
+    pdo_done_at = sim_ms() + PDO_CHANGE_MS;
+    if (SUB_Changed(1UL << TOPIC_CONTRACT)) {
+        sub_at = sim_ms();
+    }
+    return CMD_Defer(&pdo_waiter);
+}
+
+static const char *cmd_status(uint8_t argc, char *argv[]) {
+    CMD_Printf("pdo %u/%u%s\r\n", pdo_index, pdo_target, pdo_done_at ? " changing" : "");
+    return NULL;
+}
+
+static const char *cmd_dump(uint8_t argc, char *argv[]) {
+    CMD_Dump(CMD_Printf);
+    LINK_Dump(CMD_Printf);
+    SUB_Dump(CMD_Printf);
+    return NULL;
+}
+
+static const char *cmd_sub(uint8_t argc, char *argv[]) {
+    const char *err = SUB_Command(argc, argv);
+
+    if (err == NULL) {
+        sub_at = sim_ms();
+    }
+    return err;
+}
+
+
+// Topics as in main.c; the readings are made up, the lines are the firmware's
+static const uint16_t pdo_mv[5] = { 5000, 9000, 12000, 15000, 20000 };
+
+static bool vbus_topic(uint8_t *value) {
+    uint16_t mv = (uint16_t)(pdo_mv[pdo_index] - 40 + rand() % 80);    // ADC noise
+
+    memcpy(value, &mv, sizeof(mv));
+    return true;
+}
+
+static void vbus_emit(const uint8_t *value) {
+    uint16_t mv;
+
+    memcpy(&mv, value, sizeof(mv));
+    LOG_Printf("VBUS: %V V\r\n", mv);
+}
+
+static bool typec_topic(uint8_t *value) {
+    value[0] = 0x45;        // attached, CC1, source, 3 A
+    return true;
+}
+
+static void typec_emit(const uint8_t *value) {
+    LOG_Printf("Type-C status: 0x%02X\r\n", value[0]);
+}
+
+static bool pd_topic(uint8_t *value) {
+    uint32_t st = 0x00000400;   // explicit contract
+
+    memcpy(value, &st, sizeof(st));
+    return true;
+}
+
+static void pd_emit(const uint8_t *value) {
+    uint32_t st;
+
+    memcpy(&st, value, sizeof(st));
+    LOG_Printf("PD status: 0x%08lX\r\n", (unsigned long)st);
+}
+
+static bool contract_topic(uint8_t *value) {
+    value[0] = pdo_done_at ? 0x0B : 0x07;
+    value[1] = pdo_index;
+    value[2] = pdo_target;
+    return true;
+}
+
+static void contract_emit(const uint8_t *value) {
+    LOG_Printf("Contract: PDO[%u] target PDO[%u] flags 0x%02X\r\n", value[1], value[2], value[0]);
+}
+
+static bool counters_topic(uint8_t *value) {
+    uint32_t c[4] = { 0, CMD_Stats()->lines, UARTTX_Stats()->dropped, LINK_Stats()->rx_errors };
+
+    memcpy(value, c, sizeof(c));
+    return true;
+}
+
+static void counters_emit(const uint8_t *value) {
+    uint32_t c[4];
+
+    memcpy(c, value, sizeof(c));
+    LOG_Printf("Counters: %lu PD events, %lu commands, %lu TX dropped, %lu RX errors\r\n",
+               (unsigned long)c[0], (unsigned long)c[1], (unsigned long)c[2], (unsigned long)c[3]);
+}
+
+static const sub_topic_t topics[] = {
+    [TOPIC_VBUS]     = { "vbus",     2,  vbus_topic,     vbus_emit },
+    [TOPIC_TYPEC]    = { "typec",    1,  typec_topic,    typec_emit },
+    [TOPIC_PD]       = { "pd",       4,  pd_topic,       pd_emit },
+    [TOPIC_CONTRACT] = { "contract", 3,  contract_topic, contract_emit },
+    [TOPIC_COUNTERS] = { "counters", 16, counters_topic, counters_emit },
+};
+
+static const cmd_t commands[] = {
+    { "baud",   cmd_baud,   0, 1, "[rate]" },
+    { "dump",   cmd_dump,   0, 1, "[what]" },
+    { "ping",   cmd_ping,   0, 0, "" },
+    { "pdo",    cmd_pdo,    1, 1, "<index>" },
+    { "status", cmd_status, 0, 0, "" },
+    { "sub",    cmd_sub,    0, 3, "[<topic|all> <ms|change [ms]|off>]" },
+};
+
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "m:d:")) != -1) {
+        switch (opt) {
+        case 'm': max_rate = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'd': hold_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "usage: %s [-m max] [-d ms]\n", argv[0]);
+            return 2;
+        }
+    }
+    cookie_io_functions_t io = { .write = wire_write };
+    wire = fopencookie(NULL, "w", io);
+    setvbuf(wire, NULL, _IONBF, 0);
+    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+    UARTTX_Init(UARTTX_BLOCK);
+    CMD_Init(commands, sizeof(commands) / sizeof(commands[0]), LOG_Printf);
+    LINK_Init(sim_apply, sim_ms);
+    sim_apply(LINK_BASE_BAUD);
+    SUB_Init(topics, sizeof(topics) / sizeof(topics[0]), sim_ms);
+    SUB_Set(TOPIC_VBUS, SUB_PERIODIC, 100);
+    SUB_Set(TOPIC_CONTRACT, SUB_ON_CHANGE, 0);
+    sub_at = sim_ms();
+
+    static uint8_t held[RX_HOLD_MAX];
+    static uint32_t held_at[RX_HOLD_MAX];
+    uint32_t held_len = 0;
+
+    for (;;) {
+        uint8_t buf[64];
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            break;      // host closed the pty
+        }
+        if (n > 0 && line_rate() != uart_rate) {
+            for (ssize_t i = 0; i < n; i++) {
+                LINK_RxError();
+            }
+        } else if (n > 0) {
+            for (ssize_t i = 0; i < n && held_len < RX_HOLD_MAX; i++) {
+                held[held_len] = buf[i];
+                held_at[held_len++] = sim_ms();
+            }
+        }
+        uint32_t due = 0;
+        while (due < held_len && sim_ms() - held_at[due] >= hold_ms) {
+            due++;
+        }
+        if (due) {
+            uint16_t fed = CMD_Feed(held, (uint16_t)due);
+            memmove(held, held + due, held_len - due);
+            memmove(held_at, held_at + due, (held_len - due) * sizeof(held_at[0]));
+            held_len -= due;
+            (void)fed;      // counted as overflow by cmd
+        }
+        CMD_Poll();
+        if (pdo_done_at != 0 && (int32_t)(sim_ms() - pdo_done_at) >= 0) {
+            pdo_done_at = 0;
+            pdo_index = pdo_target;
+            CMD_Complete(&pdo_waiter, NULL);
+            if (SUB_Changed(1UL << TOPIC_CONTRACT)) {
+                sub_at = sim_ms();
+            }
+        }
+        if (sub_at != 0 && (int32_t)(sim_ms() - sub_at) >= 0) {
+            uint32_t next = SUB_Poll();
+            sub_at = next ? sim_ms() + next : 0;
+        }
+        if (link_at != 0 && (int32_t)(sim_ms() - link_at) >= 0) {
+            uint32_t next = LINK_Poll();
+            link_at = next ? sim_ms() + next : 0;
+        }
+        UARTTX_Pending();
+        usleep(500);
+    }
+    LINK_Dump(print_err);
+    SUB_Dump(print_err);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#!/bin/sh
+# logsize.sh - flash cost of each log level configuration (Core/Inc/log.h)
+#
+# Compiles pdtrigger_firmware/Core/Src once per configuration with the
+# Debug build's flags and prints the summed text+data of the objects,
+# relative to the first configuration.
+#
+# Usage:  tools/logsize.sh ["name:-DLOG_LEVEL_x=n ..." ...]
+#         (run from firmware/; with no arguments a standard set is used)
+#
+# Environment: CC, SIZE, OPT (default -O0, as the Debug build),
+# ARCH_FLAGS, EXTRA_CFLAGS (e.g. -DPDT_RTOS or -DPDT_BLOG).
+
+set -e
+
+CC=${CC:-arm-none-eabi-gcc}
+SIZE=${SIZE:-arm-none-eabi-size}
+OPT=${OPT:--O0}
+ARCH_FLAGS=${ARCH_FLAGS:--mcpu=cortex-m4 -mthumb -mfpu=fpv4-sp-d16 -mfloat-abi=hard --specs=nano.specs}
+PRJ=pdtrigger_firmware
+CFLAGS="-std=gnu11 -DDEBUG -DUSE_HAL_DRIVER -DSTM32F401xC $OPT -ffunction-sections -fdata-sections
+ -I$PRJ/Core/Inc -I$PRJ/Drivers/STM32F4xx_HAL_Driver/Inc -I$PRJ/Drivers/STM32F4xx_HAL_Driver/Inc/Legacy
+ -I$PRJ/Drivers/CMSIS/Device/ST/STM32F4xx/Include -I$PRJ/Drivers/CMSIS/Include $ARCH_FLAGS $EXTRA_CFLAGS"
+
+if [ $# -eq 0 ]; then
+    set -- "trace:-DLOG_LEVEL_DEFAULT=5" \
+           "debug-build:" \
+           "release:-DLOG_LEVEL_I2C=2" \
+           "no-i2c:-DLOG_LEVEL_I2C=0" \
+           "warn:-DLOG_LEVEL_DEFAULT=2 -DLOG_LEVEL_I2C=2" \
+           "off:-DLOG_LEVEL_DEFAULT=0 -DLOG_LEVEL_I2C=0"
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+ref=""
+printf '%-12s %8s %8s  %s\n' config bytes delta flags
+for cfg in "$@"; do
+    name=${cfg%%:*}
+    defs=${cfg#*:}
+    mkdir -p "$tmp/$name"
+    for src in $PRJ/Core/Src/*.c; do
+        case $src in *sysmem.c|*syscalls.c) continue;; esac
+        # shellcheck disable=SC2086
+        $CC $CFLAGS $defs -c "$src" -o "$tmp/$name/$(basename "$src" .c).o"
+    done
+    # text + data is what ends up in flash
+    bytes=$($SIZE -t "$tmp/$name"/*.o | awk 'END { print $1 + $2 }')
+    [ -z "$ref" ] && ref=$bytes
+    printf '%-12s %8d %+8d  %s\n' "$name" "$bytes" $((bytes - ref)) "$defs"
+done
@@ -0,0 +1,301 @@
+// rpc.hpp - pipelined requests to the firmware's command interface.
+//
+//   pdt::Rpc rpc(fd);
+//   auto change = rpc.call("pdo 2", 3000ms);     // answered once VBUS is there
+//   auto status = rpc.call("status");            // answered meanwhile
+//   pdt::Reply r = status.get();
+//
+// Each call goes out as "#<id> <command>" and its reply is matched by id,
+// so replies may arrive in any order (see Core/Inc/cmd.h). A reader
+// thread owns the port's input: it collects "#<id> | <text>" lines into
+// the reply and completes it on "#<id> ok" or "#<id> err <reason>", or
+// with "timeout" once the call's own deadline has passed; a reply that
+// comes after that is dropped. Untagged lines (log output) go to the
+// on_log callback.
+//
+// At most 'window' calls are outstanding at a time, the rest wait here,
+// so a burst of calls can't overrun the device's 128-byte RX ring. A
+// deferred call ("pdo") holds its slot until it is answered.
+//
+// Completion is through a std::future or a callback. Callbacks run on the
+// reader thread and may issue further calls.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace pdt {
+
+struct Reply {
+    uint32_t id = 0;
+    bool ok = false;
+    std::string error;                  // the device's reason, "timeout" or "closed"
+    std::vector<std::string> lines;     // what the request printed
+    std::chrono::microseconds elapsed{0};   // call to completion
+};
+
+class Rpc {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(const Reply &)>;
+
+    struct Stats {
+        uint64_t calls = 0;
+        uint64_t ok = 0;
+        uint64_t errors = 0;
+        uint64_t timeouts = 0;
+        uint64_t late = 0;              // replies to calls already timed out
+    };
+
+    explicit Rpc(int fd, size_t window = 4) : fd_(fd), window_(window ? window : 1) {
+        reader_ = std::thread([this] { run(); });
+    }
+
+    ~Rpc() {
+        stop_ = true;
+        reader_.join();
+        std::vector<Call> left;
+        {
+            std::lock_guard<std::mutex> l(mu_);
+            for (auto &c : inflight_) {
+                left.push_back(std::move(c.second));
+            }
+            for (auto &c : queue_) {
+                left.push_back(std::move(c));
+            }
+            inflight_.clear();
+            queue_.clear();
+        }
+        for (auto &c : left) {
+            finish(c, false, "closed");
+        }
+    }
+
+    Rpc(const Rpc &) = delete;
+    Rpc &operator=(const Rpc &) = delete;
+
+    void call(const std::string &cmd, std::chrono::milliseconds timeout, Callback done) {
+        Call c;
+        c.cmd = cmd;
+        c.start = Clock::now();
+        c.deadline = c.start + timeout;
+        c.done = std::move(done);
+        std::lock_guard<std::mutex> l(mu_);
+        c.reply.id = next_id_++;
+        st_.calls++;
+        queue_.push_back(std::move(c));
+        pump();
+    }
+
+    std::future<Reply> call(const std::string &cmd,
+                            std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
+        auto p = std::make_shared<std::promise<Reply>>();
+        std::future<Reply> f = p->get_future();
+        call(cmd, timeout, [p](const Reply &r) { p->set_value(r); });
+        return f;
+    }
+
+    void on_log(std::function<void(const std::string &)> fn) {
+        std::lock_guard<std::mutex> l(mu_);
+        log_ = std::move(fn);
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> l(mu_);
+        return st_;
+    }
+
+private:
+    struct Call {
+        std::string cmd;
+        Clock::time_point start;
+        Clock::time_point deadline;
+        Callback done;
+        Reply reply;
+    };
+
+    // Send queued calls while the window has room (mu_ held)
+    void pump() {
+        while (!queue_.empty() && inflight_.size() < window_) {
+            Call c = std::move(queue_.front());
+            queue_.pop_front();
+            std::string line = "#" + std::to_string(c.reply.id) + " " + c.cmd + "\r\n";
+            uint32_t id = c.reply.id;
+            inflight_.emplace(id, std::move(c));
+            if (write(fd_, line.data(), line.size()) != (ssize_t)line.size()) {
+                ready_.push_back(take(id, false, "write"));
+            }
+        }
+    }
+
+    // Remove a call and fill in its result (mu_ held)
+    Call take(uint32_t id, bool ok, const std::string &error) {
+        Call c = std::move(inflight_.at(id));
+        inflight_.erase(id);
+        c.reply.ok = ok;
+        c.reply.error = error;
+        c.reply.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - c.start);
+        if (ok) {
+            st_.ok++;
+        } else if (error == "timeout") {
+            st_.timeouts++;
+        } else {
+            st_.errors++;
+        }
+        return c;
+    }
+
+    static void finish(Call &c, bool ok, const char *error) {
+        c.reply.ok = ok;
+        c.reply.error = error;
+        if (c.done) {
+            c.done(c.reply);
+        }
+    }
+
+    // One line from the device (mu_ held)
+    void line(const std::string &s) {
+        if (s.empty()) {
+            return;
+        }
+        if (s[0] != '#') {
+            if (log_) {
+                logs_.push_back(s);
+            }
+            return;
+        }
+        size_t sp = s.find(' ');
+        if (sp == std::string::npos) {
+            return;
+        }
+        uint32_t id = (uint32_t)std::strtoul(s.c_str() + 1, nullptr, 10);
+        std::string rest = s.substr(sp + 1);
+        auto it = inflight_.find(id);
+        bool final = rest == "ok" || rest.compare(0, 4, "err ") == 0;
+        if (it == inflight_.end()) {
+            if (final) {
+                st_.late++;
+            }
+        } else if (rest == "ok") {
+            ready_.push_back(take(id, true, ""));
+        } else if (final) {
+            ready_.push_back(take(id, false, rest.substr(4)));
+        } else if (rest.compare(0, 2, "| ") == 0) {
+            it->second.reply.lines.push_back(rest.substr(2));
+        }
+    }
+
+    // Calls past their deadline, sent or not (mu_ held)
+    void expire(Clock::time_point now) {
+        for (auto it = inflight_.begin(); it != inflight_.end();) {
+            uint32_t id = it->first;
+            bool late = it->second.deadline <= now;
+            ++it;
+            if (late) {
+                ready_.push_back(take(id, false, "timeout"));
+            }
+        }
+        for (auto it = queue_.begin(); it != queue_.end();) {
+            if (it->deadline <= now) {
+                it->reply.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - it->start);
+                it->reply.error = "timeout";
+                st_.timeouts++;
+                ready_.push_back(std::move(*it));
+                it = queue_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    int next_wait_ms(Clock::time_point now) const {
+        auto next = now + std::chrono::milliseconds(50);    // also bounds shutdown
+        for (const auto &c : inflight_) {
+            next = std::min(next, c.second.deadline);
+        }
+        for (const auto &c : queue_) {
+            next = std::min(next, c.deadline);
+        }
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+        return ms > 0 ? (int)ms + 1 : 0;
+    }
+
+    void run() {
+        std::string in;
+        while (!stop_) {
+            int wait;
+            {
+                std::lock_guard<std::mutex> l(mu_);
+                wait = next_wait_ms(Clock::now());
+            }
+            struct pollfd p = { fd_, POLLIN, 0 };
+            int n = poll(&p, 1, wait);
+            if (n > 0 && (p.revents & POLLIN)) {
+                char buf[512];
+                ssize_t r = read(fd_, buf, sizeof(buf));
+                if (r > 0) {
+                    in.append(buf, (size_t)r);
+                }
+            } else if (n > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(wait));  // hung up
+            }
+
+            std::vector<Call> done;
+            std::vector<std::string> logs;
+            std::function<void(const std::string &)> log;
+            {
+                std::lock_guard<std::mutex> l(mu_);
+                size_t i;
+                while ((i = in.find_first_of("\r\n")) != std::string::npos) {
+                    line(in.substr(0, i));
+                    in.erase(0, i + 1);
+                }
+                expire(Clock::now());
+                pump();
+                done.swap(ready_);
+                logs.swap(logs_);
+                log = log_;
+            }
+            for (auto &s : logs) {
+                log(s);
+            }
+            for (auto &c : done) {
+                if (c.done) {
+                    c.done(c.reply);
+                }
+            }
+        }
+    }
+
+    int fd_;
+    size_t window_;
+    mutable std::mutex mu_;
+    std::map<uint32_t, Call> inflight_;
+    std::deque<Call> queue_;
+    std::vector<Call> ready_;           // completed, callbacks not yet run
+    std::vector<std::string> logs_;
+    std::function<void(const std::string &)> log_;
+    uint32_t next_id_ = 1;
+    Stats st_;
+    std::atomic<bool> stop_{false};
+    std::thread reader_;
+};
+
+}  // namespace pdt
@@ -0,0 +1,296 @@
+// rtosbench - PD event latency and RAM, cooperative scheduler versus
+// FreeRTOS tasks, on the host.
+//
+// A PD INTR "interrupt" fires every 2..20 ms at a random phase, and the
+// time until its handler, a sched.c task subscribed to the event, runs is
+// recorded. Meanwhile a report of REPORT_BYTES goes out every 500 ms to a
+// simulated 115200 baud UART.
+//
+// Default build: the firmware's sched.c, run as the bare-metal build runs
+// it. The interrupt is a thread calling SCHED_PostEvent. The report is a
+// task that is busy for each byte's time, as a blocking transmit is, so
+// an event that lands in it waits for the rest of the dump, or of the
+// chunk with -c. RAM is the main loop's stack high-water mark.
+//
+// -DPDT_RTOS build: the firmware's app_rtos.c on FreeRTOS's POSIX port,
+// with its driver, telemetry and ui tasks and its log queue. The report
+// is a telemetry job writing lines through APP_RTOS_Log; the ui task
+// drains them into uarttx.c's simulated UART. The interrupt is a task
+// above the driver that posts the event and calls APP_RTOS_Wake. RAM is
+// what APP_RTOS_Dump reports: heap and per-task stack headroom.
+//
+// Build (from firmware/, with F=pdtrigger_firmware/Core):
+//         gcc -O2 -DPDT_HOST -iquote $F/Inc -o rtosbench tools/rtosbench.c
+//             $F/Src/sched.c -lpthread
+//         (-iquote: Core/Inc's sched.h would hide the system one), and
+//         with K=<FreeRTOS-Kernel>, P=$K/portable/ThirdParty/GCC/Posix:
+//         gcc -O2 -DPDT_HOST -DPDT_RTOS -iquote $F/Inc -Itools/rtosbench
+//             -I$K/include -I$P -I$P/utils -o rtosbench_rtos tools/rtosbench.c
+//             $F/Src/app_rtos.c $F/Src/sched.c $F/Src/defer.c $F/Src/evq.c
+//             $F/Src/supervisor.c $F/Src/uarttx.c $F/Src/crit.c
+//             $F/Src/timebase.c $K/tasks.c $K/queue.c $K/list.c $K/timers.c
+//             $K/event_groups.c $P/port.c $P/utils/wait_for_event.c
+//             $K/portable/MemMang/heap_4.c -lpthread
+// Usage:  rtosbench [-s seconds] [-c chunk]
+//
+//   -s seconds  length of the run (default 10)
+//   -c chunk    bytes of the report per scheduler pass (default: all of it;
+//               bare-metal build only)
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sched.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#ifdef PDT_RTOS
+#include "app_rtos.h"
+#include "uarttx.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdarg.h>
+#endif
+
+#define REPORT_BYTES    2048
+#define REPORT_MS       500
+#define BAUD            115200
+#define BYTE_NS         (10 * 1000000000LL / BAUD)      // 8N1
+#define IRQ_MIN_MS      2
+#define IRQ_MAX_MS      20
+#define SAMPLES_MAX     20000
+#define EVT_PD_INTR     0x1
+
+static long seconds = 10;
+static int64_t latency[SAMPLES_MAX];
+static int n_latency;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latency(const char *build) {
+    int64_t sum = 0;
+
+    qsort(latency, (size_t)n_latency, sizeof(latency[0]), cmp);
+    for (int i = 0; i < n_latency; i++) {
+        sum += latency[i];
+    }
+    if (n_latency == 0) {
+        printf("%s: no events\n", build);
+        return;
+    }
+    printf("%s: %d events, latency avg %.1f us, p99 %.1f us, max %.1f us\n", build,
+           n_latency, (double)sum / n_latency / 1000.0,
+           (double)latency[(n_latency * 99) / 100] / 1000.0,
+           (double)latency[n_latency - 1] / 1000.0);
+}
+
+static uint32_t irq_gap_ms(void) {
+    return IRQ_MIN_MS + (uint32_t)rand() % (IRQ_MAX_MS - IRQ_MIN_MS + 1);
+}
+
+static _Atomic int64_t raised_at;       // 0 = no event in flight
+
+static uint32_t clock_ms(void) {
+    return (uint32_t)(now_ns() / 1000000);
+}
+
+/*Raise PD INTR; one in flight at a time, as a level interrupt that is handled*/
+static bool irq_raise(void) {
+    int64_t expected = 0;
+    if (atomic_compare_exchange_strong(&raised_at, &expected, now_ns())) {
+        SCHED_PostEvent(EVT_PD_INTR);
+        return true;
+    }
+    return false;
+}
+
+/*The handler: record how long the event waited*/
+static void pd_int_task(void *arg) {
+    int64_t t0 = atomic_exchange(&raised_at, 0);
+    if (t0 != 0 && n_latency < SAMPLES_MAX) {
+        latency[n_latency++] = now_ns() - t0;
+    }
+}
+
+
+#ifndef PDT_RTOS
+
+#define STACK_BYTES     (64 * 1024)
+#define STACK_PAINT     0xA5
+
+static atomic_bool stop;
+static long chunk = REPORT_BYTES;
+static long report_left;
+
+/*Busy for the time 'bytes' take on the wire*/
+static void uart_send(long bytes) {
+    int64_t end = now_ns() + bytes * BYTE_NS;
+    while (now_ns() < end) {
+    }
+}
+
+/*One chunk of the dump per run, as many runs as the report takes*/
+static void report_task(void *arg) {
+    sched_id_t self = SCHED_Current();
+
+    if (report_left == 0) {
+        report_left = REPORT_BYTES;
+    }
+    long n = (report_left < chunk) ? report_left : chunk;
+    uart_send(n);
+    report_left -= n;
+    if (report_left) {
+        SCHED_Start(self, 0);
+    }
+}
+
+static void *irq_thread(void *arg) {
+    while (!atomic_load(&stop)) {
+        usleep(irq_gap_ms() * 1000);
+        irq_raise();
+    }
+    return NULL;
+}
+
+static void *main_loop(void *arg) {
+    SCHED_Init(clock_ms);
+    sched_id_t pd = SCHED_AddOneShot("pd_int", pd_int_task, NULL);
+    SCHED_Subscribe(pd, EVT_PD_INTR);
+    SCHED_AddPeriodic("report", report_task, NULL, REPORT_MS, 0);
+
+    int64_t end = now_ns() + seconds * 1000000000LL;
+    while (now_ns() < end) {
+        while (SCHED_RunOnce()) {
+        }
+    }
+    atomic_store(&stop, true);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:")) != -1) {
+        switch (opt) {
+        case 's': seconds = strtol(optarg, NULL, 10); break;
+        case 'c': chunk = strtol(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "usage: %s [-s seconds] [-c chunk]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (chunk <= 0 || chunk > REPORT_BYTES) {
+        chunk = REPORT_BYTES;
+    }
+
+    // The main loop runs on a painted stack, so its depth can be read back
+    static uint8_t stack[STACK_BYTES] __attribute__((aligned(64)));
+    memset(stack, STACK_PAINT, sizeof(stack));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, sizeof(stack));
+    pthread_t loop, irq;
+    pthread_create(&loop, &attr, main_loop, NULL);
+    pthread_create(&irq, NULL, irq_thread, NULL);
+    pthread_join(loop, NULL);
+    pthread_join(irq, NULL);
+
+    size_t untouched = 0;
+    while (untouched < sizeof(stack) && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    char name[48];
+    snprintf(name, sizeof(name), "bare-metal, %ld-byte chunks", chunk);
+    print_latency(name);
+    printf("RAM: one stack, %zu bytes used (host ABI; includes libc)\n",
+           sizeof(stack) - untouched);
+    return 0;
+}
+
+#else   // PDT_RTOS
+
+#define IRQ_PRIO        (tskIDLE_PRIORITY + 4)      // above app_rtos.c's driver task
+#define REPORT_LINE     80                          // two log queue items each
+
+/*The report, as a telemetry job: one dump of lines through the log queue*/
+static void report_job(void *arg) {
+    char line[REPORT_LINE];
+
+    memset(line, 'r', sizeof(line));
+    line[REPORT_LINE - 2] = '\r';
+    line[REPORT_LINE - 1] = '\n';
+    for (int i = 0; i < REPORT_BYTES / REPORT_LINE; i++) {
+        APP_RTOS_Log(line, sizeof(line));
+    }
+}
+
+static void print(const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+static void irq_task(void *arg) {
+    TickType_t end = xTaskGetTickCount() + pdMS_TO_TICKS(seconds * 1000);
+    while ((int32_t)(xTaskGetTickCount() - end) < 0) {
+        vTaskDelay(pdMS_TO_TICKS(irq_gap_ms()));
+        if (irq_raise()) {
+            APP_RTOS_Wake();
+        }
+    }
+    print_latency("FreeRTOS POSIX port, app_rtos.c");
+    printf("RAM: heap %zu of %zu bytes used (host ABI stacks of %zu bytes)\n",
+           (size_t)configTOTAL_HEAP_SIZE - xPortGetMinimumEverFreeHeapSize(),
+           (size_t)configTOTAL_HEAP_SIZE, (size_t)PTHREAD_STACK_MIN);
+    APP_RTOS_Dump(print);
+    UARTTX_Dump(print);
+    exit(0);
+}
+
+int main(int argc, char **argv) {
+    static const app_rtos_job_t jobs[] = { { report_job, REPORT_MS } };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+        case 's': seconds = strtol(optarg, NULL, 10); break;
+        default:
+            fprintf(stderr, "usage: %s [-s seconds]\n", argv[0]);
+            return 2;
+        }
+    }
+    SCHED_Init(clock_ms);
+    sched_id_t pd = SCHED_AddOneShot("pd_int", pd_int_task, NULL);
+    SCHED_Subscribe(pd, EVT_PD_INTR);
+    UARTTX_SimInit(BAUD, NULL);
+    UARTTX_Init(UARTTX_BLOCK);
+    xTaskCreate(irq_task, "irq", configMINIMAL_STACK_SIZE, NULL, IRQ_PRIO, NULL);
+    APP_RTOS_Start(jobs, 1);
+    return 1;
+}
+
+/*app_rtos.c's way out when the kernel cannot go on*/
+void Error_Handler(void) {
+    fprintf(stderr, "Error_Handler\n");
+    abort();
+}
+
+/*No PD controller on the host: nothing to set up for its I2C transfers*/
+void CYPD3177_RTOS_Init(void) {
+}
+
+#endif
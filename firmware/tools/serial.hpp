@@ -0,0 +1,67 @@
+// serial.hpp - tty and pseudo-terminal helpers shared by the host tools.
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace pdt {
+
+// Raw 8N1 at one of the rates the firmware's USART2 can do
+inline bool set_baud(int fd, long baud) {
+    static const struct { long rate; speed_t code; } rates[] = {
+        {115200, B115200}, {230400, B230400}, {460800, B460800},
+        {921600, B921600}, {1000000, B1000000}, {1500000, B1500000},
+        {2000000, B2000000},
+    };
+    struct termios t;
+    if (tcgetattr(fd, &t) != 0) {
+        return false;
+    }
+    for (const auto &r : rates) {
+        if (r.rate == baud) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, r.code);
+            cfsetospeed(&t, r.code);
+            return tcsetattr(fd, TCSADRAIN, &t) == 0;
+        }
+    }
+    return false;
+}
+
+// Run cmd with its stdin/stdout on the slave side of a new pty, raw at
+// 115200; returns the master side. Line settings made on the master
+// apply to the slave, so the child can see the rate the host picked.
+inline int spawn_on_pty(const char *cmd, pid_t *pid) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    const char *slave = ptsname(master);
+    struct termios t;
+    if (tcgetattr(master, &t) == 0) {
+        cfmakeraw(&t);
+        cfsetispeed(&t, B115200);
+        cfsetospeed(&t, B115200);
+        tcsetattr(master, TCSANOW, &t);
+    }
+    *pid = fork();
+    if (*pid == 0) {
+        setsid();
+        int fd = open(slave, O_RDWR);
+        if (fd < 0) {
+            _exit(127);
+        }
+        dup2(fd, STDIN_FILENO);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        close(master);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)nullptr);
+        _exit(127);
+    }
+    return (*pid < 0) ? -1 : master;
+}
+
+}  // namespace pdt
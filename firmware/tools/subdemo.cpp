@@ -0,0 +1,190 @@
+// subdemo - subscribe to telemetry topics and measure what the link carries.
+//
+// First every topic is subscribed at 100 ms, which is what a fixed
+// telemetry loop sends; then only the given subscriptions are. Each phase
+// runs for a few seconds and reports the telemetry bytes per second that
+// arrived and the samples per second the device took (from "sub", each
+// vbus, typec or pd sample is an I2C read). Text telemetry only: with
+// -DPDT_TLM the topics travel in frames, count them with tlmdec -s.
+//
+// Build:  g++ -O2 -std=c++17 -pthread -o subdemo subdemo.cpp
+// Usage:  subdemo [-b baud] [-s seconds] [-v] /dev/ttyACM0 [subscription ...]
+//         subdemo [-s seconds] [-v] -e "./linksim" [subscription ...]
+//
+//   -b baud     configure the port (default 115200)
+//   -s seconds  length of each phase (default 3)
+//   -e cmd      run cmd as the device on a pseudo-terminal (tools/linksim.c)
+//   -v          print the telemetry lines too
+//
+// A subscription is the arguments of the device's "sub" command, e.g.
+// "vbus 1000" or "typec change". The default is "vbus 1000",
+// "contract change" and "typec change".
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "rpc.hpp"
+#include "serial.hpp"
+
+namespace {
+
+using Ms = std::chrono::milliseconds;
+
+constexpr long kBaseline = 100;             // ms, every topic in the first phase
+
+std::atomic<uint64_t> tlm_bytes{0};
+std::atomic<uint64_t> tlm_lines{0};
+bool verbose = false;
+
+bool run(pdt::Rpc &rpc, const std::string &cmd, std::vector<std::string> *lines = nullptr) {
+    pdt::Reply r = rpc.call(cmd, Ms(1000)).get();
+    if (!r.ok) {
+        std::fprintf(stderr, "%s: %s\n", cmd.c_str(), r.error.c_str());
+        return false;
+    }
+    if (lines != nullptr) {
+        *lines = r.lines;
+    }
+    return true;
+}
+
+// Samples taken so far, all topics
+bool samples(pdt::Rpc &rpc, uint64_t *n) {
+    std::vector<std::string> lines;
+    if (!run(rpc, "sub", &lines)) {
+        return false;
+    }
+    *n = 0;
+    for (const auto &l : lines) {
+        const char *p = std::strstr(l.c_str(), "ms: ");
+        if (p != nullptr) {
+            *n += std::strtoull(p + 4, nullptr, 10);
+        }
+    }
+    return true;
+}
+
+struct Rates {
+    double bytes = 0;       // per second
+    double lines = 0;
+    double samples = 0;
+};
+
+bool phase(pdt::Rpc &rpc, const char *name, const std::vector<std::string> &subs,
+           long seconds, Rates *out) {
+    if (!run(rpc, "sub all off")) {
+        return false;
+    }
+    for (const auto &s : subs) {
+        if (!run(rpc, "sub " + s)) {
+            return false;
+        }
+    }
+    uint64_t s0, s1;
+    std::this_thread::sleep_for(Ms(200));           // first samples, replies out of the way
+    if (!samples(rpc, &s0)) {
+        return false;
+    }
+    uint64_t b0 = tlm_bytes, l0 = tlm_lines;
+    auto t0 = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    uint64_t b1 = tlm_bytes, l1 = tlm_lines;
+    if (!samples(rpc, &s1)) {
+        return false;
+    }
+    out->bytes = (double)(b1 - b0) / t;
+    out->lines = (double)(l1 - l0) / t;
+    out->samples = (double)(s1 - s0) / t;
+    std::printf("%-12s %8.0f B/s %6.1f lines/s %6.1f samples/s\n", name, out->bytes,
+                out->lines, out->samples);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long baud = 115200, seconds = 3;
+    const char *sim = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:s:e:v")) != -1) {
+        switch (opt) {
+        case 'b': baud = std::strtol(optarg, nullptr, 10); break;
+        case 's': seconds = std::strtol(optarg, nullptr, 10); break;
+        case 'e': sim = optarg; break;
+        case 'v': verbose = true; break;
+        default:
+            std::fprintf(stderr, "usage: %s [-b baud] [-s seconds] [-v] tty|-e cmd [subscription ...]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    int fd;
+    pid_t pid = -1;
+    if (sim != nullptr) {
+        fd = pdt::spawn_on_pty(sim, &pid);
+    } else if (optind < argc) {
+        fd = open(argv[optind++], O_RDWR | O_NOCTTY);
+        if (fd >= 0 && !pdt::set_baud(fd, baud)) {
+            std::fprintf(stderr, "cannot set %ld baud\n", baud);
+            return 1;
+        }
+    } else {
+        std::fprintf(stderr, "no port\n");
+        return 2;
+    }
+    if (fd < 0) {
+        std::fprintf(stderr, "%s\n", std::strerror(errno));
+        return 1;
+    }
+
+    std::vector<std::string> subs(argv + optind, argv + argc);
+    if (subs.empty()) {
+        subs = { "vbus 1000", "contract change", "typec change" };
+    }
+
+    int rc = 1;
+    {
+        pdt::Rpc rpc(fd);
+        rpc.on_log([](const std::string &s) {
+            tlm_bytes += s.size() + 2;      // CR LF
+            tlm_lines++;
+            if (verbose) {
+                std::printf("  | %s\n", s.c_str());
+            }
+        });
+        Rates all, some;
+        std::string every = "all " + std::to_string(kBaseline);
+        if (phase(rpc, "all @100ms", { every }, seconds, &all) &&
+            phase(rpc, "subscribed", subs, seconds, &some)) {
+            std::printf("%.0f%% fewer bytes, %.0f%% fewer samples\n",
+                        all.bytes > 0 ? 100.0 * (1.0 - some.bytes / all.bytes) : 0.0,
+                        all.samples > 0 ? 100.0 * (1.0 - some.samples / all.samples) : 0.0);
+            std::vector<std::string> lines;
+            if (run(rpc, "sub", &lines)) {
+                for (const auto &l : lines) {
+                    std::printf("  %s\n", l.c_str());
+                }
+                rc = 0;
+            }
+        }
+    }
+    close(fd);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return rc;
+}
@@ -0,0 +1,499 @@
+// tlmdec - decode the PDT_TLM framed telemetry stream.
+//
+// Frames are COBS-encoded and 0x00-delimited, each carrying type, seq,
+// payload and a CRC-16/CCITT-FALSE (see Core/Inc/tlm.h for the layout).
+// The decoder can start anywhere in a stream: bytes up to the first
+// delimiter are skipped, and a damaged frame costs only itself. STATE
+// deltas are applied to a copy of the device's fields, printed whole;
+// it is marked stale from a seq gap until the next keyframe.
+//
+// Build:  g++ -O2 -std=c++17 -o tlmdec tlmdec.cpp
+// Usage:  tlmdec [-b baud] [-q] [-s] [-r n] [capture|-|/dev/ttyACM0]
+//
+//   -b baud   configure a serial device as raw 8N1 at this rate
+//   -q        decode and check only, print nothing but the stats
+//   -s        print frame counts, errors and decode throughput at the end,
+//             the wire bytes STATE took against full snapshots, and TEXT
+//             against the whole session
+//   -r n      benchmark: load the capture into memory and decode it n times
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr unsigned kSchema = 1;             // TLM_SCHEMA this tool knows
+constexpr size_t kWireMax = 256;            // anything longer is not a frame
+
+enum MsgType : uint8_t { HELLO = 1, STATUS, EVENT, VBUS, TEXT, STATE };
+
+// STATE fields in bit order (tlm_field_t)
+constexpr struct { uint8_t size; const char *fmt; } kFields[] = {
+    {1, " flags=0x%02X"}, {1, " pdo=%u"}, {1, " target=%u"}, {2, " vbus=%u"},
+    {1, " typec=0x%02X"}, {4, " pd=0x%08X"}, {4, " pd_events=%u"}, {4, " cmd=%u"},
+    {4, " tx_drop=%u"}, {4, " rx_err=%u"},
+};
+constexpr size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+constexpr uint16_t kStateKey = 1u << 15;
+
+const char *const kEvents[] = {
+    "?", "pd_intr", "offline", "pdo_request", "pdo_done",
+    "pdo_failed", "pdo_timeout", "pdo_cancel", "adopted",
+};
+
+// CRC-16/CCITT-FALSE, slicing by 8: t[k][b] is the CRC of byte b followed
+// by k zero bytes, so eight bytes cost eight independent lookups
+struct Crc16 {
+    uint16_t t[8][256];
+    Crc16() {
+        for (unsigned i = 0; i < 256; i++) {
+            uint16_t c = (uint16_t)(i << 8);
+            for (int b = 0; b < 8; b++) {
+                c = (uint16_t)((c & 0x8000) ? (c << 1) ^ 0x1021 : c << 1);
+            }
+            t[0][i] = c;
+        }
+        for (unsigned k = 1; k < 8; k++) {
+            for (unsigned i = 0; i < 256; i++) {
+                t[k][i] = (uint16_t)(t[k - 1][i] << 8) ^ t[0][t[k - 1][i] >> 8];
+            }
+        }
+    }
+    uint16_t operator()(const uint8_t *p, size_t n) const {
+        uint16_t crc = 0xFFFF;
+        for (; n >= 8; n -= 8, p += 8) {
+            crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xFF)] ^
+                  t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        }
+        while (n--) {
+            crc = (uint16_t)(crc << 8) ^ t[0][(crc >> 8) ^ *p++];
+        }
+        return crc;
+    }
+};
+
+// A checked frame; 'payload' points into the decoder's buffer
+struct Frame {
+    uint8_t type;
+    uint8_t seq;
+    const uint8_t *payload;
+    size_t len;
+
+    uint16_t u16(size_t off) const {
+        return off + 2 <= len ? (uint16_t)(payload[off] | payload[off + 1] << 8) : 0;
+    }
+    uint32_t u32(size_t off) const {
+        return (uint32_t)u16(off) | (uint32_t)u16(off + 2) << 16;
+    }
+    uint8_t u8(size_t off) const { return off < len ? payload[off] : 0; }
+};
+
+struct Stats {
+    uint64_t bytes = 0;
+    uint64_t frames = 0;
+    uint64_t skipped = 0;       // partial frames before the first delimiter
+    uint64_t crc_errors = 0;
+    uint64_t cobs_errors = 0;   // bad code bytes, runts, oversize
+    uint64_t lost = 0;          // frames missing according to seq
+    uint64_t by_type[16] = {};
+};
+
+// Streaming decoder. Frames wholly inside one feed() are decoded straight
+// from the input; only a frame split across reads is copied.
+template <typename Sink>
+class Decoder {
+public:
+    explicit Decoder(Sink &sink) : sink_(sink) { partial_.reserve(kWireMax); }
+
+    void feed(const uint8_t *p, size_t n) {
+        st.bytes += n;
+        const uint8_t *end = p + n;
+        while (p < end) {
+            auto *z = static_cast<const uint8_t *>(std::memchr(p, 0, (size_t)(end - p)));
+            if (z == nullptr) {
+                keep(p, (size_t)(end - p));
+                return;
+            }
+            if (partial_.empty() && !overflow_) {
+                frame(p, (size_t)(z - p));
+            } else {
+                keep(p, (size_t)(z - p));
+                if (!overflow_) {
+                    frame(partial_.data(), partial_.size());
+                }
+            }
+            partial_.clear();
+            overflow_ = false;
+            synced_ = true;
+            p = z + 1;
+        }
+    }
+
+    // Forget the stream position, as if the port had just been opened
+    void restart() {
+        partial_.clear();
+        overflow_ = synced_ = have_seq_ = false;
+    }
+
+    Stats st;
+
+private:
+    void keep(const uint8_t *p, size_t n) {
+        if (overflow_) {
+            return;
+        }
+        if (partial_.size() + n > kWireMax) {
+            overflow_ = true;       // counted once
+            error(st.cobs_errors);
+            return;
+        }
+        partial_.insert(partial_.end(), p, p + n);
+    }
+
+    // Whatever precedes the first delimiter is most likely the tail of a
+    // frame sent before we started listening: not an error
+    void error(uint64_t &counter) {
+        if (synced_) {
+            counter++;
+        } else {
+            st.skipped++;
+        }
+    }
+
+    void frame(const uint8_t *w, size_t n) {
+        if (n == 0) {
+            return;     // back-to-back delimiters are idle fill, not frames
+        }
+        if (n > kWireMax) {
+            error(st.cobs_errors);
+            return;
+        }
+        size_t len = 0;
+        size_t i = 0;
+        while (i < n) {
+            uint8_t code = w[i++];
+            size_t run = (size_t)code - 1;
+            if (code == 0 || i + run > n) {
+                error(st.cobs_errors);
+                return;
+            }
+            std::memcpy(buf_ + len, w + i, run);
+            len += run;
+            i += run;
+            if (code != 0xFF && i < n) {
+                buf_[len++] = 0;
+            }
+        }
+        if (len < 4) {
+            error(st.cobs_errors);
+            return;
+        }
+        uint16_t crc = (uint16_t)(buf_[len - 2] | buf_[len - 1] << 8);
+        if (crc_(buf_, len - 2) != crc) {
+            error(st.crc_errors);
+            return;
+        }
+        Frame f{buf_[0], buf_[1], buf_ + 2, len - 4};
+        if (have_seq_) {
+            st.lost += (uint8_t)(f.seq - last_seq_ - 1);
+        }
+        have_seq_ = true;
+        last_seq_ = f.seq;
+        st.frames++;
+        st.by_type[f.type & 15]++;
+        sink_(f);
+    }
+
+    Sink &sink_;
+    Crc16 crc_;
+    std::vector<uint8_t> partial_;
+    uint8_t buf_[kWireMax];
+    bool synced_ = false;       // seen a delimiter
+    bool overflow_ = false;
+    bool have_seq_ = false;
+    uint8_t last_seq_ = 0;
+};
+
+// Wire bytes of a frame with this payload: type, seq, CRC, COBS, delimiter
+size_t wire_size(size_t payload) {
+    size_t n = 2 + payload + 2;
+    return n + 1 + n / 254 + 1;
+}
+
+// The device's STATE fields, rebuilt from keyframes and deltas
+struct State {
+    uint32_t v[kFieldCount] = {};
+    uint16_t known = 0;
+    bool stale = true;          // no keyframe yet, or frames lost since
+    uint64_t frames = 0;
+    uint64_t keyframes = 0;
+    uint64_t wire = 0;          // as sent
+    uint64_t full = 0;          // had every frame carried every known field
+
+    // Apply one STATE payload; false if it is malformed
+    bool apply(const Frame &f) {
+        uint16_t mask = f.u16(4);
+        size_t off = 6;
+        if (mask & kStateKey) {
+            known = 0;          // fields a keyframe lacks are no longer subscribed
+            stale = false;
+        }
+        for (size_t i = 0; i < kFieldCount; i++) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            uint8_t size = kFields[i].size;
+            if (off + size > f.len) {
+                return false;
+            }
+            v[i] = size == 1 ? f.u8(off) : size == 2 ? f.u16(off) : f.u32(off);
+            known |= (uint16_t)(1u << i);
+            off += size;
+        }
+        size_t all = 6;
+        for (size_t i = 0; i < kFieldCount; i++) {
+            if (known & (1u << i)) {
+                all += kFields[i].size;
+            }
+        }
+        frames++;
+        keyframes += (mask & kStateKey) ? 1 : 0;
+        wire += wire_size(f.len);
+        full += wire_size(all);
+        return true;
+    }
+
+    int print(char *line, size_t size, uint32_t ms, bool key) const {
+        int n = std::snprintf(line, size, "%10u state%s", ms, key ? " key" : "");
+        for (size_t i = 0; i < kFieldCount && n > 0 && (size_t)n < size; i++) {
+            if (known & (1u << i)) {
+                n += std::snprintf(line + n, size - (size_t)n, kFields[i].fmt, v[i]);
+            }
+        }
+        if (n > 0 && (size_t)n < size) {
+            n += std::snprintf(line + n, size - (size_t)n, "%s\n", stale ? " (stale)" : "");
+        }
+        return n;
+    }
+};
+
+// Prints one line per message; log text is passed through as is
+struct Printer {
+    std::string out;
+    bool schema_warned = false;
+    State state;
+    bool have_seq = false;
+    uint8_t last_seq = 0;
+    uint64_t text_wire = 0;     // wire bytes of TEXT frames
+
+    void operator()(const Frame &f) {
+        if (have_seq && f.seq != (uint8_t)(last_seq + 1)) {
+            state.stale = true;     // a delta may be among the missing
+        }
+        have_seq = true;
+        last_seq = f.seq;
+        char line[256];
+        int n = 0;
+        switch (f.type) {
+        case HELLO: {
+            uint8_t build = f.u8(1);
+            n = std::snprintf(line, sizeof(line), "%10u hello schema=%u build=%s%s%s\n",
+                              f.u32(2), f.u8(0), (build & 1) ? "rtos," : "",
+                              (build & 2) ? "isr_only," : "", (build & 4) ? "debug" : "");
+            if (f.u8(0) != kSchema && !schema_warned) {
+                std::fprintf(stderr, "device schema %u, decoder knows %u\n", f.u8(0), kSchema);
+                schema_warned = true;
+            }
+            break;
+        }
+        case STATUS: {
+            uint8_t fl = f.u8(4);
+            n = std::snprintf(line, sizeof(line), "%10u status pdo=%u/%u vbus=%u%s%s%s%s\n",
+                              f.u32(0), f.u8(5), f.u8(6), f.u16(7),
+                              (fl & 1) ? " online" : " offline", (fl & 2) ? " contract" : "",
+                              (fl & 4) ? " vbus_ok" : "", (fl & 8) ? " changing" : "");
+            break;
+        }
+        case EVENT: {
+            uint8_t ev = f.u8(4);
+            n = std::snprintf(line, sizeof(line), "%10u event %s arg=%u mv=%u\n", f.u32(0),
+                              ev < sizeof(kEvents) / sizeof(kEvents[0]) ? kEvents[ev] : "?",
+                              f.u8(5), f.u16(6));
+            break;
+        }
+        case VBUS:
+            n = std::snprintf(line, sizeof(line), "%10u vbus %u\n", f.u32(0), f.u16(4));
+            break;
+        case STATE:
+            if (!state.apply(f)) {
+                n = std::snprintf(line, sizeof(line), "%10u state: short frame\n", f.u32(0));
+                break;
+            }
+            n = state.print(line, sizeof(line), f.u32(0), (f.u16(4) & kStateKey) != 0);
+            break;
+        case TEXT:
+            text_wire += wire_size(f.len);
+            out.append(reinterpret_cast<const char *>(f.payload), f.len);
+            return;
+        default:
+            n = std::snprintf(line, sizeof(line), "type %u (%zu bytes)\n", f.type, f.len);
+            break;
+        }
+        if (n > 0) {
+            out.append(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+        }
+    }
+};
+
+volatile uint64_t g_sink;
+
+// Touches every field so the benchmark measures a full decode
+struct Checker {
+    uint64_t sum = 0;
+    void operator()(const Frame &f) {
+        for (size_t i = 0; i + 2 <= f.len; i += 2) {
+            sum += f.u16(i);
+        }
+    }
+};
+
+bool set_baud(int fd, long baud) {
+    static const struct { long rate; speed_t code; } rates[] = {
+        {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+        {115200, B115200}, {230400, B230400}, {460800, B460800},
+        {921600, B921600}, {1000000, B1000000}, {2000000, B2000000},
+    };
+    struct termios t;
+    if (tcgetattr(fd, &t) != 0) {
+        return false;
+    }
+    for (const auto &r : rates) {
+        if (r.rate == baud) {
+            cfmakeraw(&t);
+            cfsetispeed(&t, r.code);
+            cfsetospeed(&t, r.code);
+            return tcsetattr(fd, TCSANOW, &t) == 0;
+        }
+    }
+    return false;
+}
+
+void print_stats(const Stats &st, double s) {
+    std::fprintf(stderr, "%llu bytes, %llu frames (hello %llu status %llu event %llu "
+                 "vbus %llu text %llu state %llu), %llu lost, %llu crc errors, %llu framing errors, "
+                 "%llu skipped, %.1f MB/s\n",
+                 (unsigned long long)st.bytes, (unsigned long long)st.frames,
+                 (unsigned long long)st.by_type[HELLO], (unsigned long long)st.by_type[STATUS],
+                 (unsigned long long)st.by_type[EVENT], (unsigned long long)st.by_type[VBUS],
+                 (unsigned long long)st.by_type[TEXT], (unsigned long long)st.by_type[STATE],
+                 (unsigned long long)st.lost,
+                 (unsigned long long)st.crc_errors, (unsigned long long)st.cobs_errors,
+                 (unsigned long long)st.skipped, s > 0 ? (double)st.bytes / s / 1e6 : 0.0);
+}
+
+// What the delta encoding saved over sending full snapshots, and how much
+// of the session log text took: STATE alone is not what the link carries
+void print_state_stats(const State &s, uint64_t text, uint64_t session) {
+    if (s.frames == 0) {
+        return;
+    }
+    std::fprintf(stderr, "state: %llu frames (%llu key), %llu wire bytes, %llu as full "
+                 "snapshots, %.1f%% saved; text %llu of %llu session bytes\n",
+                 (unsigned long long)s.frames, (unsigned long long)s.keyframes,
+                 (unsigned long long)s.wire, (unsigned long long)s.full,
+                 s.full ? 100.0 * (1.0 - (double)s.wire / (double)s.full) : 0.0,
+                 (unsigned long long)text, (unsigned long long)session);
+}
+
+int bench(int fd, long reps) {
+    std::vector<uint8_t> cap;
+    std::vector<uint8_t> buf(1 << 16);
+    ssize_t n;
+    while ((n = read(fd, buf.data(), buf.size())) > 0) {
+        cap.insert(cap.end(), buf.begin(), buf.begin() + n);
+    }
+    Checker chk;
+    Decoder<Checker> dec(chk);
+    auto t0 = std::chrono::steady_clock::now();
+    for (long r = 0; r < reps; r++) {
+        dec.restart();
+        // Feed in UART-read sized pieces so split frames are exercised
+        for (size_t off = 0; off < cap.size(); off += 4096) {
+            dec.feed(cap.data() + off, std::min<size_t>(4096, cap.size() - off));
+        }
+    }
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    print_stats(dec.st, s);
+    g_sink = chk.sum;
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    long baud = 0, reps = 0;
+    bool quiet = false, stats = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:qsr:")) != -1) {
+        switch (opt) {
+        case 'b': baud = std::strtol(optarg, nullptr, 10); break;
+        case 'q': quiet = true; break;
+        case 's': stats = true; break;
+        case 'r': reps = std::strtol(optarg, nullptr, 10); break;
+        default:
+            std::fprintf(stderr, "usage: %s [-b baud] [-q] [-s] [-r n] [capture|-|tty]\n", argv[0]);
+            return 2;
+        }
+    }
+    int fd = 0;
+    if (optind < argc && std::strcmp(argv[optind], "-") != 0) {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            std::fprintf(stderr, "%s: %s\n", argv[optind], std::strerror(errno));
+            return 1;
+        }
+    }
+    if (baud && !set_baud(fd, baud)) {
+        std::fprintf(stderr, "cannot set %ld baud on the input\n", baud);
+        return 1;
+    }
+    if (reps > 0) {
+        return bench(fd, reps);
+    }
+
+    Printer pr;
+    Decoder<Printer> dec(pr);
+    std::vector<uint8_t> buf(1 << 16);
+    auto t0 = std::chrono::steady_clock::now();
+    for (;;) {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        dec.feed(buf.data(), (size_t)n);
+        if (!quiet) {
+            std::fwrite(pr.out.data(), 1, pr.out.size(), stdout);
+            std::fflush(stdout);    // live output from a serial port
+        }
+        pr.out.clear();
+    }
+    if (stats || quiet) {
+        print_stats(dec.st, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+        print_state_stats(pr.state, pr.text_wire, dec.st.bytes);
+    }
+    return 0;
+}